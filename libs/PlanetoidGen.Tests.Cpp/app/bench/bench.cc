@@ -0,0 +1,171 @@
+#include "bench.h"
+#include "executive.h"
+#include "map.h"
+#include "params.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+typedef struct
+{
+	std::string name;
+	Bench::Body body;
+} Entry;
+
+volatile uint64_t bench_sink;
+
+// in a function, so registrations from any file find it constructed
+static std::vector<Entry>& registry ()
+{
+	static std::vector<Entry> entries;
+	return entries;
+}
+
+Bench::Register::Register (const char *name, Body body)
+{
+	registry().push_back ({name, body});
+}
+
+Bench::Bench (const std::string& n, double s)
+{
+	name = n;
+	seconds = s;
+	ran = false;
+}
+
+Bench::~Bench ()
+{
+	scope.reset ();
+	context.reset ();
+}
+
+// ===================================================================
+// Context -- a fresh map generation of size x size cells to work in
+// ===================================================================
+GenerationContext& Bench::Context (int size, bool mask)
+{
+	Params params = Params::Instance();
+
+	params.x_size = size;
+	params.y_size = size;
+	params.page_size = size;
+	params.num_x_pages = 1;
+	params.num_y_pages = 1;
+	params.name = "bench";
+
+	scope.reset ();
+	context.reset (new GenerationContext (params));
+	scope.reset (new ContextScope (context.get()));
+
+	if (mask)
+	{
+		Map& m = context->createMask ();
+
+		m.SetMode (rgba_8);
+		m.Set_Coverage (params.coverage);
+		m.generate_mask ();
+
+		Executive::Instance().setMask (&m);
+		Executive::Instance().Setup ();
+	}
+
+	return *context;
+}
+
+// ===================================================================
+// Run -- time op, doubling the count until a round is long enough
+// ===================================================================
+void Bench::Run (double cells, Operation op)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	long n = 1;
+	double elapsed = 0;
+
+	for (;;)
+	{
+		Clock::time_point start = Clock::now();
+		op (n);
+		elapsed = std::chrono::duration<double> (Clock::now() - start).count();
+
+		if ((elapsed >= seconds) || (n >= (1L << 40)))
+		{
+			break;
+		}
+
+		// aim a little past the target rather than doubling blindly
+		double scale = (elapsed > 0) ? 1.2 * seconds / elapsed : 100;
+		n = (long) (n * std::min (std::max (scale, 2.0), 100.0));
+	}
+
+	double ns = elapsed * 1e9 / n;
+	double rate = cells * n / elapsed;
+
+	printf ("%-36s %12ld %14.1f %14.3e\n", name.c_str(), n, ns, rate);
+	fflush (stdout);
+	ran = true;
+}
+
+int Bench::RunAll (const std::string& filter, double seconds)
+{
+	int count = 0;
+
+	printf ("%-36s %12s %14s %14s\n", "benchmark", "ops", "ns/op", "cells/s");
+
+	for (Entry& e : registry())
+	{
+		if (e.name.find (filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		Bench b (e.name, seconds);
+		e.body (b);
+
+		if (! b.ran)
+		{
+			printf ("%-36s did not run\n", e.name.c_str());
+		}
+		count++;
+	}
+
+	return count;
+}
+
+static void usage (const char *exe)
+{
+	fprintf (stderr, "Usage:  %s [-time seconds] [name-filter]\n", exe);
+	exit (1);
+}
+
+int main (int argc, char **argv)
+{
+	std::string filter;
+	double seconds = 0.5;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp (argv[i], "-time") == 0) && (i + 1 < argc))
+		{
+			seconds = atof (argv[++i]);
+		}
+		else if (argv[i][0] == '-')
+		{
+			usage (argv[0]);
+		}
+		else
+		{
+			filter = argv[i];
+		}
+	}
+
+	if (Bench::RunAll (filter, seconds) == 0)
+	{
+		fprintf (stderr, "no benchmark matches '%s'\n", filter.c_str());
+		return 1;
+	}
+
+	return 0;
+}
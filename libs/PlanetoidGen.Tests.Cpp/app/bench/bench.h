@@ -0,0 +1,66 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include "generationcontext.h"
+
+/**
+ * \brief One microbenchmark, and the registry the bench program runs.
+ *
+ * A benchmark's body does its setup, then hands Run the operation to
+ * time.  Run calls it with growing counts until a round takes at least
+ * the minimum time, and reports that round as ns per operation and cells
+ * per second.
+ *
+ *     static Bench::Register r ("pointset/insert", [] (Bench& b)
+ *     {
+ *         PointSet set (1024, 1024);
+ *         b.Run (1, [&] (long n) { ... n inserts ... });
+ *     });
+ */
+class Bench
+{
+public:
+	typedef std::function<void (Bench&)> Body;
+	typedef std::function<void (long n)> Operation;
+
+	struct Register
+	{
+		Register (const char *name, Body body);
+	};
+
+	// run the benchmarks whose names contain filter, each round lasting at
+	// least seconds; returns the number run
+	static int RunAll (const std::string& filter, double seconds);
+
+	// time n calls of op, each of which touches cells cells
+	void Run (double cells, Operation op);
+
+	// a context for a square map of size cells a side, bound while the
+	// benchmark runs; with mask set, the mask is generated and the
+	// Executive set up on it as generate() would
+	GenerationContext& Context (int size, bool mask = false);
+
+private:
+	std::string name;
+	double seconds;
+	bool ran;
+	std::unique_ptr<GenerationContext> context;
+	std::unique_ptr<ContextScope> scope;
+
+	Bench (const std::string& n, double s);
+	~Bench ();
+};
+
+// keeps the compiler from discarding a result
+extern volatile uint64_t bench_sink;
+
+inline void KeepValue (uint64_t value)
+{
+	bench_sink = value;
+}
+
+#endif
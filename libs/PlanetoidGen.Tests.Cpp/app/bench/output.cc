@@ -0,0 +1,87 @@
+#include "bench.h"
+#include "image.h"
+#include "random.h"
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static const int OUTPUT_SIZE = 1024;
+static const int OUTPUT_PAGE = 256;
+
+// ===================================================================
+// OutputDir -- a scratch directory, removed with everything in it
+// ===================================================================
+class OutputDir
+{
+private:
+	fs::path path;
+
+public:
+	OutputDir ()
+	{
+		path = fs::temp_directory_path() / "mapgen_bench";
+		fs::create_directories (path);
+	}
+	~OutputDir ()
+	{
+		std::error_code ignored;
+		fs::remove_all (path, ignored);
+	}
+
+	std::string file (const char *name)		{return (path / name).string();}
+};
+
+// a heightmap-like image: smooth slopes with a little noise, so the
+// encoder sees neither a constant nor pure noise
+static void fillTerrain (Image& image)
+{
+	Random rng (13);
+
+	for (int y = 0; y < OUTPUT_SIZE; y++)
+	{
+		for (int x = 0; x < OUTPUT_SIZE; x++)
+		{
+			image.Set (x, y, (x * 37 + y * 23) + rng.nextInt (16));
+		}
+	}
+}
+
+static Bench::Register write_png ("output/write_png", [] (Bench& b)
+{
+	b.Context (OUTPUT_SIZE);
+	OutputDir dir;
+	Image image (OUTPUT_SIZE, OUTPUT_SIZE);
+	std::string filename = dir.file ("whole.png");
+
+	fillTerrain (image);
+
+	b.Run ((double) OUTPUT_SIZE * OUTPUT_SIZE, [&] (long n)
+	{
+		for (long i = 0; i < n; i++)
+		{
+			image.Write (filename.c_str());
+		}
+	});
+});
+
+static void splitBench (Bench& b, RawFormat raw)
+{
+	b.Context (OUTPUT_SIZE);
+	OutputDir dir;
+	Image image (OUTPUT_SIZE, OUTPUT_SIZE);
+
+	fillTerrain (image);
+	image.SetName (dir.file ("page."));
+
+	b.Run ((double) OUTPUT_SIZE * OUTPUT_SIZE, [&] (long n)
+	{
+		for (long i = 0; i < n; i++)
+		{
+			image.SplitImage (OUTPUT_PAGE, raw);
+		}
+	});
+}
+
+static Bench::Register split_png ("output/split_png", [] (Bench& b)		{ splitBench (b, RAW_NONE); });
+static Bench::Register split_r16 ("output/split_r16", [] (Bench& b)		{ splitBench (b, RAW_R16); });
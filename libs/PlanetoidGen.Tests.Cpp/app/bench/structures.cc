@@ -0,0 +1,202 @@
+#include "bench.h"
+#include "image.h"
+#include "pointset.h"
+#include "random.h"
+#include <algorithm>
+#include <vector>
+
+// ===================================================================
+// PointSet -- the coastline and boundary sets agents draw from
+// ===================================================================
+
+static const int SET_SIZE = 1024;
+
+// every cell of the grid once, in a random order
+static std::vector<Point> shuffledCells (int size)
+{
+	std::vector<Point> cells;
+	Random rng (7);
+
+	cells.reserve ((size_t) size * size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			cells.push_back (Point (x, y));
+		}
+	}
+
+	for (size_t i = cells.size() - 1; i > 0; i--)
+	{
+		std::swap (cells[i], cells[rng.nextInt ((int) i + 1)]);
+	}
+
+	return cells;
+}
+
+static Bench::Register pointset_insert ("pointset/insert", [] (Bench& b)
+{
+	std::vector<Point> cells = shuffledCells (SET_SIZE);
+	PointSet set (SET_SIZE, SET_SIZE);
+	size_t next = 0;
+
+	b.Run (1, [&] (long n)
+	{
+		for (long i = 0; i < n; i++)
+		{
+			if (next == cells.size())
+			{
+				set.clear ();
+				next = 0;
+			}
+			set.insert (cells[next++]);
+		}
+	});
+});
+
+static Bench::Register pointset_lookup ("pointset/lookup", [] (Bench& b)
+{
+	std::vector<Point> cells = shuffledCells (SET_SIZE);
+	PointSet set (SET_SIZE, SET_SIZE);
+
+	// half the grid in the set, probed in another order
+	for (size_t i = 0; i < cells.size() / 2; i++)
+	{
+		set.insert (cells[i]);
+	}
+	std::reverse (cells.begin(), cells.end());
+
+	b.Run (1, [&] (long n)
+	{
+		long found = 0;
+
+		for (long i = 0; i < n; i++)
+		{
+			found += set.in_set (cells[i & (cells.size() - 1)]);
+		}
+		KeepValue (found);
+	});
+});
+
+static Bench::Register pointset_random ("pointset/random_member", [] (Bench& b)
+{
+	std::vector<Point> cells = shuffledCells (SET_SIZE);
+	PointSet set (SET_SIZE, SET_SIZE);
+	Random rng (11);
+	RandomScope scope (rng);
+
+	for (size_t i = 0; i < cells.size() / 4; i++)
+	{
+		set.insert (cells[i]);
+	}
+
+	b.Run (1, [&] (long n)
+	{
+		Point p;
+		long sum = 0;
+
+		for (long i = 0; i < n; i++)
+		{
+			set.random_member (p);
+			sum += p.x;
+		}
+		KeepValue (sum);
+	});
+});
+
+// ===================================================================
+// Image -- cell access in row and column order
+// ===================================================================
+
+static const int IMAGE_SIZE = 2048;
+static const double IMAGE_CELLS = (double) IMAGE_SIZE * IMAGE_SIZE;
+
+static Bench::Register image_set_rows ("image/set_row_sweep", [] (Bench& b)
+{
+	b.Context (IMAGE_SIZE);
+	Image image (IMAGE_SIZE, IMAGE_SIZE);
+
+	b.Run (IMAGE_CELLS, [&] (long n)
+	{
+		for (long k = 0; k < n; k++)
+		{
+			for (int y = 0; y < IMAGE_SIZE; y++)
+				for (int x = 0; x < IMAGE_SIZE; x++)
+					image.Set (x, y, x + y + k);
+		}
+	});
+});
+
+static Bench::Register image_get_rows ("image/get_row_sweep", [] (Bench& b)
+{
+	b.Context (IMAGE_SIZE);
+	Image image (IMAGE_SIZE, IMAGE_SIZE);
+
+	b.Run (IMAGE_CELLS, [&] (long n)
+	{
+		unsigned long sum = 0;
+
+		for (long k = 0; k < n; k++)
+		{
+			for (int y = 0; y < IMAGE_SIZE; y++)
+				for (int x = 0; x < IMAGE_SIZE; x++)
+					sum += image.Get (x, y);
+		}
+		KeepValue (sum);
+	});
+});
+
+static Bench::Register image_set_columns ("image/set_column_sweep", [] (Bench& b)
+{
+	b.Context (IMAGE_SIZE);
+	Image image (IMAGE_SIZE, IMAGE_SIZE);
+
+	b.Run (IMAGE_CELLS, [&] (long n)
+	{
+		for (long k = 0; k < n; k++)
+		{
+			for (int x = 0; x < IMAGE_SIZE; x++)
+				for (int y = 0; y < IMAGE_SIZE; y++)
+					image.Set (x, y, x + y + k);
+		}
+	});
+});
+
+static Bench::Register image_get_columns ("image/get_column_sweep", [] (Bench& b)
+{
+	b.Context (IMAGE_SIZE);
+	Image image (IMAGE_SIZE, IMAGE_SIZE);
+
+	b.Run (IMAGE_CELLS, [&] (long n)
+	{
+		unsigned long sum = 0;
+
+		for (long k = 0; k < n; k++)
+		{
+			for (int x = 0; x < IMAGE_SIZE; x++)
+				for (int y = 0; y < IMAGE_SIZE; y++)
+					sum += image.Get (x, y);
+		}
+		KeepValue (sum);
+	});
+});
+
+static Bench::Register image_row_copy ("image/get_set_row", [] (Bench& b)
+{
+	b.Context (IMAGE_SIZE);
+	Image image (IMAGE_SIZE, IMAGE_SIZE);
+	std::vector<uint32_t> row (IMAGE_SIZE);
+
+	b.Run (IMAGE_CELLS, [&] (long n)
+	{
+		for (long k = 0; k < n; k++)
+		{
+			for (int y = 0; y < IMAGE_SIZE; y++)
+			{
+				image.GetRow (y, 0, IMAGE_SIZE, row.data());
+				row[y] += 1;
+				image.SetRow (y, 0, IMAGE_SIZE, row.data());
+			}
+		}
+	});
+});
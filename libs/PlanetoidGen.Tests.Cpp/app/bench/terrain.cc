@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "executive.h"
+#include "map.h"
+#include "params.h"
+#include "random.h"
+#include "TerrainOp.h"
+#include "Widener.h"
+#include <vector>
+
+// ===================================================================
+// landPoints -- a random sample of the mask's land cells
+// ===================================================================
+static std::vector<Point> landPoints (int size, size_t count)
+{
+	std::vector<Point> points;
+	Random rng (3);
+
+	while (points.size() < count)
+	{
+		Point p (rng.nextInt (size), rng.nextInt (size));
+
+		if (Executive::Instance().on_land (p))
+		{
+			points.push_back (p);
+		}
+	}
+
+	return points;
+}
+
+static const int TERRAIN_SIZE = 1024;
+
+// the weighted average is private to the Executive; smoothPoint is that
+// plus the fixed and ocean checks and the store, as the smooth agents see it
+static Bench::Register smooth_point ("terrain/smooth_point", [] (Bench& b)
+{
+	b.Context (TERRAIN_SIZE, true);
+	std::vector<Point> points = landPoints (TERRAIN_SIZE, 4096);
+
+	b.Run (1, [&] (long n)
+	{
+		for (long i = 0; i < n; i++)
+		{
+			Executive::Instance().smoothPoint (points[i & (points.size() - 1)]);
+		}
+	});
+});
+
+// a river's cross section, plowed step by step along a row
+static Bench::Register widener ("terrain/widener_w3", [] (Bench& b)
+{
+	const int width = 3;
+	const int dir = DIR_RIGHT;
+
+	b.Context (TERRAIN_SIZE, true);
+	Random rng (5);
+	RandomScope scope (rng);
+
+	SetHeightOp height (1000);
+	height.setOverride (true);
+
+	// a straight run plows one slice of width cells a step
+	b.Run (width, [&] (long n)
+	{
+		Point previous (width, TERRAIN_SIZE / 2);
+		int prev_dir = -1;
+
+		for (long i = 0; i < n; i++)
+		{
+			Point location (previous.x + 1, previous.y);
+
+			if (location.x >= (CoordType) (TERRAIN_SIZE - width))
+			{
+				location.x = width;
+				prev_dir = -1;
+			}
+
+			WidenerOp op (height, width, dir, false);
+			op.setPrevious (previous, prev_dir);
+			Executive::Instance().operatePoint (location, op);
+
+			previous = location;
+			prev_dir = dir;
+		}
+	});
+});
+
+// ===================================================================
+// Mask growth -- a whole mask at each size, as generate() starts with
+// ===================================================================
+static void maskBench (Bench& b, int size)
+{
+	b.Context (size);
+	Params& params = Params::Instance();
+
+	b.Run ((double) size * size, [&] (long n)
+	{
+		for (long i = 0; i < n; i++)
+		{
+			Map m (size, size);
+
+			m.SetMode (rgba_8);
+			m.Set_Coverage (params.coverage);
+			m.generate_mask ();
+		}
+	});
+}
+
+static Bench::Register mask_256 ("mask/generate_256", [] (Bench& b)		{ maskBench (b, 256); });
+static Bench::Register mask_512 ("mask/generate_512", [] (Bench& b)		{ maskBench (b, 512); });
+static Bench::Register mask_1024 ("mask/generate_1024", [] (Bench& b)	{ maskBench (b, 1024); });
@@ -4,6 +4,7 @@
 #include "point.h"
 #include "heightmap.h"
 #include <vector>
+#include <atomic>
 
 typedef struct
 {
@@ -17,6 +18,7 @@ public:
 	MountainAgent (int _tokens);
 
 	bool Execute ();
+	bool footprint (int steps, Rect& area);
 
 	bool randomPoint (Point& p, int minAltitude = 0);
 	bool randomBase (Point& base, Point& center);
@@ -31,7 +33,7 @@ private:
 	void elevateSlice (Point& p, int altitude, int width);
 
 	Point location;
-	static int count;
+	static std::atomic<int> count;		// foothills are created on worker threads
 
 	// the previous step's position and orientation, so we can pick up where they left off
 	Point previous;
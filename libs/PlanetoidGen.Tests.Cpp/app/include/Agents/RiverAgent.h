@@ -5,6 +5,7 @@
 #include "point.h"
 #include "pointset.h"
 #include <vector>
+#include <atomic>
 
 typedef std::vector<Point> PointList;
 
@@ -16,7 +17,7 @@ public:
 
 private:
 	Point location;
-	static int count;
+	static std::atomic<int> count;
 	bool initializing;
 	int width;
 	int prev_height;
@@ -3,6 +3,7 @@
 
 #include "agent.h"
 #include "point.h"
+#include <atomic>
 
 class ShoreLineAgent : public Agent
 {
@@ -12,7 +13,7 @@ public:
 
 private:
 	Point location;
-	static int count;
+	static std::atomic<int> count;
 
 	bool adjacentShore (Point& p);
 	void miniWalk (Point& location);
@@ -4,12 +4,14 @@
 #include "agent.h"
 #include "point.h"
 #include "TerrainOp.h"
+#include <atomic>
 
 class SmoothAgent : public Agent
 {
 public:
 		SmoothAgent (int _tokens);
 		bool Execute ();
+		bool footprint (int steps, Rect& area);
 
 		void moveTo (Point& next);
 		void setSmoother (bool allowOverride);
@@ -18,7 +20,7 @@ private:
 
 		Point location;
 		Point initial_location;
-		static int count;
+		static std::atomic<int> count;
 		int reset_tokens;
 		unsigned long weightedAverageHeight ();
 
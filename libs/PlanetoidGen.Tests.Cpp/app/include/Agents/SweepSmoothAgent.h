@@ -0,0 +1,28 @@
+#ifndef SWEEP_SMOOTH_AGENT_H
+#define SWEEP_SMOOTH_AGENT_H
+
+#include "agent.h"
+#include <atomic>
+
+/**
+ * \brief Smooths the whole map in row sweeps, one band of rows per step.
+ *
+ * Replaces the one-SmoothAgent-per-row sweep.  The rows are worked by
+ * SmoothKernel, which spreads each band across the thread pool itself, so
+ * this agent reports no footprint and is always run alone.
+ */
+class SweepSmoothAgent : public Agent
+{
+public:
+	static const int BAND = 16;			// rows per step
+
+	SweepSmoothAgent (int passes);
+	bool Execute ();
+
+private:
+	int bands;							// steps per pass
+	int row;							// first row of the next band
+	static std::atomic<int> count;
+};
+
+#endif
@@ -2,17 +2,31 @@
 #define AGENT_H
 
 #include <string>
+#include "random.h"
+#include "point.h"
 
-typedef enum {SHORELINE_AGENT, MOUNTAIN_AGENT, SMOOTH_AGENT, RIVER_AGENT, EROSION_AGENT, HILL_AGENT} AgentType;
+typedef enum {SHORELINE_AGENT, MOUNTAIN_AGENT, SMOOTH_AGENT, RIVER_AGENT, EROSION_AGENT, HILL_AGENT, NUM_AGENT_TYPES} AgentType;
 
 class Agent
 {
 public:
+	Agent () : rng (Random::Current().split())	{}
+	virtual ~Agent ()					{}
+
 	virtual bool Execute () = 0;
+
+	// The cells the next 'steps' calls to Execute may read or write.  Agents
+	// which cannot bound this return false, and are only ever run alone.
+	virtual bool footprint (int /* steps */, Rect& /* area */)	{return false;}
+
 	inline AgentType getType()			{return type;}
 	inline bool isRunnable()			{return runnable;}
 	inline void setRunnable (bool b)	{runnable = b;}
 	inline std::string getName()		{return name;}
+	inline unsigned int getTokens()		{return tokens;}
+	inline Random& stream()				{return rng;}
+	inline int getSlot()				{return slot;}
+	inline void setSlot (int s)		{slot = s;}
 
 protected:
 	AgentType type;
@@ -20,6 +34,10 @@ protected:
 	bool runnable;
 	int id;
 	std::string name;
+	Random rng;							// split from the creator's stream
+
+private:
+	int slot = -1;						// position in the scheduler's pool, -1 if not runnable
 };
 
 #endif
\ No newline at end of file
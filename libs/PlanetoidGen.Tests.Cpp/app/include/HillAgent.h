@@ -4,6 +4,7 @@
 #include "agent.h"
 #include "point.h"
 #include "heightmap.h"
+#include <atomic>
 
 class HillAgent : public Agent
 {
@@ -12,7 +13,7 @@ public:
 	bool Execute ();
 
 private:
-	static int count;
+	static std::atomic<int> count;
 	int initialized;
 	Point location;
 };
@@ -3,6 +3,7 @@
 
 #include "point.h"
 #include "pointset.h"
+#include "random.h"
 
 class TerrainOp
 {
@@ -14,6 +15,8 @@ public:
 	virtual bool mayOverride();
 	inline void setDelta (int d)								{delta = d; }
 	inline int getDelta ()										{return delta;}
+protected:
+	Random *rng;					// the stream current when the op was made
 private:
 	bool overrideFixed;
 	int delta;
@@ -34,6 +34,7 @@ private:
 	void checkLakesForPoint (Point& p);
 protected:
 	WaterModel ();
+	friend class GenerationContext;
 
 public:
 	static WaterModel& Instance();
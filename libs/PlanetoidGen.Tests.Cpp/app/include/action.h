@@ -5,6 +5,8 @@
 #include "point.h"
 #include "pointset.h"
 #include "heightmap.h"
+#include "random.h"
+#include <atomic>
 
 #if 0
 // directional constants
@@ -37,8 +39,9 @@ private:
 	Map *mask;
 
 	long value;
+	Random rng;						// split from the parent action's stream
 
-	static int count;
+	static std::atomic<int> count;
 	int id;
 	int parent;
 
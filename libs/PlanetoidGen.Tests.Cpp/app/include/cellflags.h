@@ -0,0 +1,73 @@
+#ifndef CELLFLAGS_H
+#define CELLFLAGS_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// per-cell state bits kept by the Executive
+
+const uint8_t CELL_FIXED = 0x01;			// altitude/texture may not be changed
+const uint8_t CELL_WATCHED = 0x02;			// log any change to this cell
+const uint8_t CELL_OCEAN = 0x04;			// open water connected to the map edge
+const uint8_t CELL_COASTLINE = 0x08;		// land adjacent to open water
+
+/**
+ * \brief One byte of state flags per map cell.
+ *
+ * Replaces point sets which were only used for membership tests, so a lookup
+ * is an index rather than a tree search.  Rows are contiguous bytes, which
+ * keeps the bulk queries simple loops the compiler can vectorize.
+ *
+ * Cells off the map carry no flags.
+ */
+class CellFlags
+{
+private:
+	int x_dim;
+	int y_dim;
+	std::vector<uint8_t> cells;
+
+public:
+	CellFlags ();
+	CellFlags (int x_size, int y_size);
+
+	void allocate (int x_size, int y_size);
+
+	inline bool onGrid (int x, int y)
+	{
+		return (x >= 0) && (y >= 0) && (x < x_dim) && (y < y_dim);
+	}
+
+	inline bool test (int x, int y, uint8_t flag)
+	{
+		if (! onGrid (x, y))
+			return false;
+
+		return (cells[(size_t) y * x_dim + x] & flag) != 0;
+	}
+
+	inline void set (int x, int y, uint8_t flag)
+	{
+		if (onGrid (x, y))
+			cells[(size_t) y * x_dim + x] |= flag;
+	}
+
+	inline void clear (int x, int y, uint8_t flag)
+	{
+		if (onGrid (x, y))
+			cells[(size_t) y * x_dim + x] &= ~flag;
+	}
+
+	inline uint8_t *row (int y)				{return &cells[(size_t) y * x_dim];}
+	inline int GetXSize ()					{return x_dim;}
+	inline int GetYSize ()					{return y_dim;}
+
+	// bulk queries
+	long count (uint8_t flag);
+	long countRect (int x1, int y1, int x2, int y2, uint8_t flag);
+	bool anyInRect (int x1, int y1, int x2, int y2, uint8_t flag);
+	void clearAll (uint8_t flag);
+};
+
+#endif
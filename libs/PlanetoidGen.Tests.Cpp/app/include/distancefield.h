@@ -0,0 +1,40 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include "image.h"
+#include "cellflags.h"
+#include <vector>
+
+/**
+ * \brief Squared Euclidean distance from every cell to the nearest cell
+ *        carrying a given flag.
+ *
+ * Computed with the separable, linear-time transform of Felzenszwalb and
+ * Huttenlocher ("Distance Transforms of Sampled Functions"), one pass over
+ * the columns and one over the rows.  Distances are exact and stored as
+ * 32-bit squared values, so lookups are a single read; the few too far
+ * for 32 bits, on maps past 46k cells a side, are kept as UNBOUNDED.
+ */
+class DistanceField : public Image
+{
+private:
+	bool empty;						// no source cells, every distance is unbounded
+
+	static constexpr int BLOCK = 64;	// columns transformed together in the column pass
+
+	static void transform1D (const double *f, int n, double *d, int *v, double *z);
+
+public:
+	static constexpr uint32_t UNBOUNDED = 0xffffffff;
+
+	DistanceField (uint x, uint y);
+
+	void compute (CellFlags& flags, uint8_t source);
+
+	inline bool hasSources ()			{return ! empty;}
+	int distanceSq (int x, int y);		// clamped to INT_MAX
+
+	bool Export (const char *filename);
+};
+
+#endif
@@ -8,13 +8,20 @@
 #include "point.h"
 #include "pointset.h"
 #include "index.h"
+#include "cellflags.h"
+#include "distancefield.h"
+#include "scheduler.h"
+#include "tilelease.h"
+#include "metrics.h"
+#include "trace.h"
+#include <mutex>
+#include <condition_variable>
 #include <string>
 #include "TerrainOp.h"
 
 class Agent;
 class MountainAgent;
 
-typedef std::set<Agent *> AgentSet;
 enum {TEXTURE_DIRT1, TEXTURE_DIRT2, TEXTURE_DIRT3, TEXTURE_GRASS1, TEXTURE_GRASS2,
 			TEXTURE_ROCK1, TEXTURE_ROCK2, TEXTURE_ROCK3, TEXTURE_ROCK4, TEXTURE_ROCK5,
 			TEXTURE_SAND, TEXTURE_ICEROCK1, TEXTURE_ICEROCK2, TEXTURE_ICE, TEXTURE_LAVA, TEXTURE_SNOW};
@@ -29,16 +36,34 @@ private:
 	Heightmap *map;
 	Index *texture;
 
-	PointSet fixed_points;
-	PointSet coastline;
-	PointSet watched;
-	PointSet ocean;
+	CellFlags flags;				// fixed/watched/ocean/coastline state per cell
+	PointSet coastline;				// coastline cells, for random selection
+	DistanceField *coastDistance;	// squared distance from each cell to the coastline
+	std::once_flag coastDistanceBuilt;	// the field is built when first asked for
 
 	int atlas_size;					// number of textures stored in the atlas
 
-	AgentSet runnable;
-	AgentSet mountainAgents;
-	AgentSet riverAgents;
+	Metrics *metrics;				// the context's, counted in on the hot paths
+	Trace *trace;					// the context's timeline, NULL unless tracing
+
+	Scheduler runnable;				// runnable agents, and the deferred river phase
+	AgentList mountainAgents;
+	AgentList agents;				// every agent added, deleted with the executive
+	Random schedule;				// picks which agent runs next, and for how long
+
+	// parallel execution
+	TileLeases leases;				// tiles claimed by agents running on workers
+	std::mutex scheduleLock;		// guards the runnable pool, leases and inFlight
+	std::condition_variable agentDone;
+	int inFlight;					// agents currently running on workers
+
+	bool executeAgent (Agent *a, int steps);
+	void traceAgent (const char *event, Agent *a);
+	void prefetch (Rect& area);
+	void finishAgent (Agent *a, bool result);
+	void runSequential ();
+	void runParallel ();
+	void runBatched ();
 
 	int numMountainAgents;
 
@@ -56,9 +81,11 @@ private:
 
 protected:
 	Executive ();
+	friend class GenerationContext;
 
 public:
 	static Executive& Instance();
+	~Executive ();
 	std::string currentTime();
 	bool random_neighbor (Point& src, Point& neighbor);
 	bool random_land (Point& point);
@@ -69,7 +96,7 @@ public:
 	bool neighbor (Point& seed, Point& neighbor, int direction);
 	bool on_land (Point& point);
 	bool on_shore (Point& point);
-	inline bool inOcean (Point& point)		{ return ocean.in_set(point);}
+	inline bool inOcean (Point& point)		{ return flags.test(point.x, point.y, CELL_OCEAN);}
 
 	bool StepDir (Point& src, Point& dst, int direction, int delta = 1);
 	int  directionFrom (Point& src, Point& target);
@@ -77,6 +104,8 @@ public:
 	bool findInterior (Point& point, int distance);
 	int distanceSq (Point& p1, Point& p2);
 	int distanceToCoastline (Point& p);
+	DistanceField& coastDistanceField();
+	inline Heightmap& heightmap()			{return *map;}
 
 	unsigned long maxAltitude ();
 	unsigned long minAltitude ();
@@ -89,29 +118,35 @@ public:
 	inline void setMask (Map *map)			{mask = map;}
 	void addAgent (Agent *a);
 	void agentCompleted (Agent *a);
-	bool anyRunnable (AgentSet& agents);
-	void makeRunnable (AgentSet& agents);
+	bool anyRunnable (AgentList& agents);
+	void makeRunnable (AgentList& agents);
+	inline Scheduler& scheduler()			{return runnable;}
 
 	inline bool onMap(Point& p)				{return mask->in_range(p.x, p.y);}
-	inline void fixPoint(Point& p)			{fixed_points.insert(p);}
+	inline void fixPoint(Point& p)			{flags.set(p.x, p.y, CELL_FIXED);}
 	bool onMaskBoundary (Point& p);
 
 	void fixArea (Point& p);
-	inline bool isFixed(Point& p)			{return fixed_points.in_set(p); }
-	inline void unfix(Point& p)				{fixed_points.remove(p.x, p.y);}
+	inline bool isFixed(Point& p)
+	{
+		metrics->count(COUNT_FIXED_LOOKUPS);
+		return flags.test(p.x, p.y, CELL_FIXED);
+	}
+	inline void unfix(Point& p)				{flags.clear(p.x, p.y, CELL_FIXED);}
 	void operatePoint (Point& p, TerrainOp& op);
 	void operateArea (Point& p, TerrainOp& op);
 	// void randomWalk (Point& p, TerrainOp& op);			// a possibility for the future
 	void findGradient (GradientType, Point& center, Point& p, int& slope);
 
-	inline void watchPoint(Point& p)		{watched.insert(p);}
-	inline bool isWatched(Point& p)			{return watched.in_set(p); }
+	inline void watchPoint(Point& p)		{flags.set(p.x, p.y, CELL_WATCHED);}
+	inline bool isWatched(Point& p)			{return flags.test(p.x, p.y, CELL_WATCHED); }
+	inline CellFlags& cellFlags()			{return flags;}
 
 	void texturePoint (Point& p, int texture_id);
 	void textureArea (Point& point, int texture_id);
 	void printArea (Point& p);
 
-	void writeHeightmap ();
+	bool writeHeightmap ();
 	void Setup ();
 	void PostRun ();
 	void Run();
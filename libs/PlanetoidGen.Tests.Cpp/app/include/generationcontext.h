@@ -0,0 +1,85 @@
+#ifndef GENERATIONCONTEXT_H
+#define GENERATIONCONTEXT_H
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include "params.h"
+#include "random.h"
+#include "metrics.h"
+#include "trace.h"
+
+class Map;
+class Executive;
+class WaterModel;
+class Logger;
+
+/**
+ * \brief Everything one map generation owns.
+ *
+ * A context holds its own copy of the parameters, the root random stream,
+ * the mask, and the Executive with its heightmap, index and agents, so
+ * several maps can be generated at once in one process.
+ *
+ * A context is bound to a thread with ContextScope.  While it is bound,
+ * Params::Instance(), Executive::Instance(), WaterModel::Instance(),
+ * Logger::Instance(), Metrics::Instance(), Trace::Current() and
+ * Random::Root() resolve to the context's objects, which lets agents keep reaching the map through
+ * the usual accessors.
+ * Tasks handed to the ThreadPool are bound to the context they were
+ * submitted from.
+ */
+class GenerationContext
+{
+private:
+	Params params;
+	Random root;
+
+	FILE *logfile;						// the context's own log, if it has one
+	std::unique_ptr<Logger> logger;
+	Metrics metrics;
+	std::unique_ptr<Trace> trace;		// only when params.trace is set
+
+	// destroyed in reverse, so the executive goes before the mask it uses
+	std::unique_ptr<Map> mask;
+	std::unique_ptr<Executive> executive;
+	std::unique_ptr<WaterModel> water;
+
+	GenerationContext (const GenerationContext&);
+	GenerationContext& operator= (const GenerationContext&);
+
+public:
+	GenerationContext (const Params& p);
+	~GenerationContext ();
+
+	// the context bound to the calling thread, or NULL
+	static GenerationContext *Current ();
+	static GenerationContext *Bind (GenerationContext *context);
+
+	inline Params& getParams ()				{return params;}
+	inline Random& getRoot ()				{return root;}
+	inline Logger *getLogger ()				{return logger.get();}
+	inline Metrics& getMetrics ()			{return metrics;}
+	inline Trace *getTrace ()				{return trace.get();}
+
+	Executive& getExecutive ();
+	WaterModel& getWaterModel ();
+
+	Map& createMask ();
+	bool openLog (const std::string& filename);
+};
+
+/**
+ * \brief Bind a context to the calling thread for the lifetime of a scope.
+ */
+class ContextScope
+{
+private:
+	GenerationContext *previous;
+
+public:
+	ContextScope (GenerationContext *context)	{previous = GenerationContext::Bind (context);}
+	~ContextScope ()							{GenerationContext::Bind (previous);}
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef HEAPTRACK_H
+#define HEAPTRACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// the replacement operator new and delete are left out when this is 0
+#ifndef MAPGEN_HEAP_TRACK
+#define MAPGEN_HEAP_TRACK 1
+#endif
+
+typedef enum
+{
+	HEAP_OTHER,
+	HEAP_POINTSET,
+	HEAP_IMAGE,							// image and heightmap cells, tiles
+	HEAP_AGENTS,
+	HEAP_WATER,
+	HEAP_WRITER,						// PNG and raw output
+	HEAP_SUBSYSTEMS
+} HeapSubsystem;
+
+/**
+ * \brief Byte and allocation counts for a subsystem or a phase.
+ *
+ * Subsystems keep live bytes, which go down as their blocks are freed.
+ * Phases only see allocations: their peak is the most the whole process
+ * had live at any allocation made during the phase.
+ */
+struct alignas(64) HeapCounters
+{
+	std::atomic<uint64_t> allocated;	// bytes, since the last reset
+	std::atomic<uint64_t> allocations;
+	std::atomic<int64_t> live;
+	std::atomic<int64_t> peak;
+
+	HeapCounters () : allocated (0), allocations (0), live (0), peak (0)	{}
+
+	void raisePeak (int64_t value)
+	{
+		int64_t seen = peak.load (std::memory_order_relaxed);
+		while ((value > seen) && ! peak.compare_exchange_weak (seen, value, std::memory_order_relaxed))
+			;
+	}
+};
+
+/**
+ * \brief Heap usage by subsystem and by generation phase.
+ *
+ * Global operator new and delete are replaced to put a small header in
+ * front of each block, naming the subsystem it was charged to.  Nothing is
+ * counted until tracking is enabled, which is a single relaxed load per
+ * allocation when it is off, and can be switched at any time: blocks from
+ * before it was on are not taken off the counts when freed.
+ *
+ * Allocations are charged to the innermost HeapScope on the thread and to
+ * the phase bound there, which PhaseTimer does for its phase.  ThreadPool
+ * tasks carry the submitter's subsystem and phase, as they carry its
+ * context.  The subsystem counts are for the whole process, so with -jobs
+ * they cover every map being generated.
+ */
+class HeapTrack
+{
+public:
+	static void Enable (bool on);
+	static bool Enabled ();
+
+	static HeapCounters& Total ();
+	static HeapCounters& Subsystem (HeapSubsystem s);
+	static const char *SubsystemName (HeapSubsystem s);
+
+	// zero the allocated counts and bring the peaks down to what is live
+	static void Reset ();
+
+	// make s or phase current on this thread, returning what was
+	static HeapSubsystem Bind (HeapSubsystem s);
+	static HeapSubsystem Current ();
+	static HeapCounters *BindPhase (HeapCounters *phase);
+	static HeapCounters *CurrentPhase ();
+
+	// for operator new and delete
+	static void *Allocate (size_t bytes);
+	static void Release (void *block);
+};
+
+/**
+ * \brief Charge the allocations in a scope to a subsystem.
+ */
+class HeapScope
+{
+private:
+	HeapSubsystem previous;
+
+public:
+	HeapScope (HeapSubsystem s)			{previous = HeapTrack::Bind (s);}
+	~HeapScope ()						{HeapTrack::Bind (previous);}
+};
+
+/**
+ * \brief Charge the allocations in a scope to a phase as well.
+ */
+class HeapPhaseScope
+{
+private:
+	HeapCounters *previous;
+
+public:
+	HeapPhaseScope (HeapCounters *phase)	{previous = HeapTrack::BindPhase (phase);}
+	~HeapPhaseScope ()						{HeapTrack::BindPhase (previous);}
+};
+
+#endif
@@ -6,6 +6,8 @@
 #include "pointset.h"
 #include "index.h"
 #include "map.h"
+#include "heightstats.h"
+#include <vector>
 
 /**
  * \brief A Heightmap is a rectangular set of elevation points
@@ -20,6 +22,9 @@
 
 typedef enum {DIR_UP, DIR_UR, DIR_RIGHT, DIR_LR, DIR_DOWN, DIR_LL, DIR_LEFT, DIR_UL} Direction;
 
+const int NOISE_TILE = 64;				// edge of the squares randomize() seeds independently
+const int HEIGHT_HALO = 2;				// ghost cells around the map, as far as the smoothing stencil reaches
+
 class Heightmap : public Image
 {
 private:
@@ -50,6 +55,10 @@ private:
 	void smooth_plus (int x, int y);
 	unsigned long CellValue (int x, int y);
 
+	// the last Stats, and each tile's part of them
+	HeightStats stats;
+	std::vector<HeightStats::Partial> partials;
+
 	/**
 	 * Write one page of height data to disk
 	 */
@@ -64,6 +73,12 @@ public:
 	Heightmap (int x, int y);
 	~Heightmap ();
 
+	/**
+	 * Range, mean, land area and histogram of the heights, kept until the
+	 * map is next written.  Not to be called while it is being written.
+	 */
+	const HeightStats& Stats ();
+
 	unsigned long Max ();
 	unsigned long Min ();
 	bool random_neighbor (Point& src, Point& neighbor);
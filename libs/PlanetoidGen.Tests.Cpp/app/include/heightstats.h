@@ -0,0 +1,71 @@
+#ifndef HEIGHTSTATS_H
+#define HEIGHTSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * \brief The range, mean, land area and histogram of a set of heights.
+ *
+ * The row kernels which gather them, and the one Heightmap::Scale uses,
+ * come in AVX2 and NEON versions picked at compile time, with a plain
+ * loop for everything else.  The histogram bins are HISTOGRAM_STEP
+ * heights wide starting at 0; the last bin also takes everything above.
+ *
+ * A Partial covers the cells of one image tile; Heightmap keeps one per
+ * tile so that only tiles written since the last pass need reading again.
+ */
+class HeightStats
+{
+public:
+	static const int HISTOGRAM_SHIFT = 8;
+	static const int HISTOGRAM_STEP = 1 << HISTOGRAM_SHIFT;
+	static const int HISTOGRAM_BINS = 256;
+	static const int HISTOGRAM_WAYS = 4;
+
+	typedef struct
+	{
+		uint32_t lowest;
+		uint32_t highest;
+		uint64_t sum;
+		uint32_t land;
+		uint32_t cells;
+		uint32_t histogram[HISTOGRAM_WAYS][HISTOGRAM_BINS];	// summed by merge()
+	} Partial;
+
+	unsigned long lowest;
+	unsigned long highest;
+	uint64_t sum;
+	double mean;
+	long land;								// cells above 0
+	long cells;
+	std::vector<long> histogram;
+
+	HeightStats ();
+
+	void reset ();
+	void merge (const Partial& p);
+
+	static void clear (Partial& p);
+
+	// fold n cells into a Partial, or n cells all of one value
+	static void addRow (Partial& p, const uint32_t *row, size_t n);
+	static void addValue (Partial& p, uint32_t value, size_t n);
+
+	// row[i] = factor * row[i], truncated and held to 0..UINT32_MAX
+	static void scaleRow (uint32_t *row, size_t n, float factor);
+
+	static inline uint32_t scaleValue (uint32_t value, float factor)
+	{
+		float f = factor * (float) value;
+
+		if (! (f > 0))
+			return 0;
+		return (f < 4294967296.0f) ? (uint32_t) f : UINT32_MAX;
+	}
+
+	static const char *kernelName ();		// "avx2", "neon" or "scalar"
+};
+
+#endif
@@ -5,9 +5,17 @@
 
 #include <stdio.h>
 #include <string>
+#include "imagebuffer.h"
+
+class PageQueue;
 
 typedef enum {FORMAT_TGA, FORMAT_PNG, FORMAT_JPG} ImageFormat;
 
+// headerless little-endian samples, as terrain engines import them
+typedef enum {RAW_NONE, RAW_R16, RAW_R32F} RawFormat;
+
+const size_t RAW_HEADER_BYTES = 32;			// optional header in front of raw samples
+
 typedef unsigned int uint;
 typedef unsigned char uchar;
 typedef unsigned long ulong;
@@ -26,27 +34,33 @@ private:
 	uint size_x;
 	uint size_y;
 
-	unsigned long **map;
+	ImageBuffer map;
+	StorageType storage;
+	StorageLayout layout;
+	uint halo;
+	HaloPadding padding;
 	unsigned char origin;
 	unsigned char mode;
 	ImageFormat format;
 	std::string name;
 	int page_size;
+	int page_level;						// pages are those of an image 2^page_level times larger
 
 	unsigned long max, min;
 
 	void allocate (uint x, uint y);
 	void release ();
 
-	unsigned char *BuildByteSeq (uint x1, uint y1, uint x2, uint y2,
-		float scale=1);
-	unsigned short *BuildShortSeq (uint x1, uint y1, uint x2, uint y2,
-		float scale=1);
-	void write_page (int page_x, int page_y);
+	void BuildRow (uint y, uint x1, uint x2, int channels, float scale, uint8_t *row);
+	void convertRawRow (uint y, uint x, uint n, RawFormat raw, uint8_t *out);
+	void BuildRawRow (uint y, uint x, uint n, RawFormat raw, uint8_t *out);
+	bool write_page (int page_x, int page_y, RawFormat raw, bool header);
+	void queuePages (int num_x_pages, int num_y_pages, PageQueue& pages, RawFormat raw, bool header);
 	std::string getExtension ();
 
 public:
-	Image (uint x, uint y);
+	Image (uint x, uint y, StorageType t = STORAGE_U32, StorageLayout l = LAYOUT_DENSE,
+		uint haloCells = 0, HaloPadding haloPadding = PAD_ZERO);
 	Image ();
 	Image (const char *filename);
 	virtual ~Image ();
@@ -63,19 +77,74 @@ public:
 
 	inline uint GetXSize () {return size_x;}
 	inline uint GetYSize () {return size_y;}
+	inline StorageType GetStorage () {return storage;}
+	inline StorageLayout GetLayout () {return layout;}
+	inline TileCache *GetTileCache () {return map.getCache();}
 
-	void Write (const char *filename, float scale=1);
-	void Write (const char *filename, uint x1, uint y1, uint x2, uint y2, 
+	bool Write (const char *filename, float scale=1);
+	bool Write (const char *filename, uint x1, uint y1, uint x2, uint y2, 
 		float scale = 1);
-	void SplitImage (int page_size);
+	bool SplitImage (int page_size, RawFormat raw = RAW_NONE, bool header = false);
+	void SplitImage (int page_size, PageQueue& pages, RawFormat raw = RAW_NONE, bool header = false);
+
+	// queue the pages of a level of detail reduced by 2^level from an image
+	// split into num_x_pages x num_y_pages of page_size; page numbers and the
+	// ground each page covers are the full image's
+	void SplitLevel (int page_size, int level, int num_x_pages, int num_y_pages, PageQueue& pages);
+
+	// cells [lo, hi) along one axis of page 'page', at the given level
+	static void PageBounds (int page, int page_size, int level, uint& lo, uint& hi);
+
+	bool WriteRaw (const char *filename, RawFormat raw, bool header = false);
+	bool WriteRaw (const char *filename, uint x1, uint y1, uint x2, uint y2,
+		RawFormat raw, bool header = false);
+	static const char *RawExtension (RawFormat raw);
 
 	void Load (const char *filename);
 
 	virtual void Set (uint x, uint y, unsigned long value);
 	void fSet (float x, float y, unsigned long value);
 	unsigned long Get (int x, int y);
+
+	// ghost cells around a dense image, 0 if it has none; Get reads them
+	// too, and returns 0 further out
+	inline uint Halo ()						{return map.getHalo();}
+	inline HaloPadding Padding ()			{return map.getPadding();}
+
+	// no range checks: reads may be up to Halo() cells off the image, writes
+	// must be on it
+	inline unsigned long GetUnchecked (int x, int y)					{return map.getUnchecked (x, y);}
+	inline void SetUnchecked (uint x, uint y, unsigned long value)		{map.setUnchecked (x, y, value);}
+
+	// bulk access to part of a row, which must lie on the image
+	inline void GetRow (uint y, uint x, uint n, int32_t *dst)			{map.getRow (y, x, n, dst);}
+	inline void SetRow (uint y, uint x, uint n, const int32_t *src)		{map.setRow (y, x, n, src);}
+	inline void GetRow (uint y, uint x, uint n, uint32_t *dst)			{map.getRow (y, x, n, dst);}
+	inline void SetRow (uint y, uint x, uint n, const uint32_t *src)		{map.setRow (y, x, n, src);}
+
+	// every cell, without a store per cell where the layout allows
+	inline void Fill (unsigned long value)				{map.fill (value);}
+
+	// the cells in a box, inclusive, are about to be used
+	inline void Prefetch (int x1, int y1, int x2, int y2)				{map.prefetch (x1, y1, x2, y2);}
+
+	// sparse images: tiles of ImageBuffer::TILE cells which have never been written
+	inline bool ConstantTile (uint tx, uint ty, unsigned long& value)	{return map.constantTile (tx, ty, value);}
+	inline void FillTile (uint tx, uint ty, unsigned long value)		{map.fillTile (tx, ty, value);}
+	inline bool Uniform (int x1, int y1, int x2, int y2, unsigned long& value)	{return map.uniform (x1, y1, x2, y2, value);}
+	inline long MaterializedTiles ()		{return map.materializedTiles();}
+
+	// flag the ImageBuffer::TILE square tiles as they are written
+	inline void TrackWrites ()				{map.trackWrites();}
+	inline long DirtyTiles ()				{return map.getDirtyTiles();}
+	inline bool TakeDirty (size_t tile)		{return map.takeDirty (tile);}
 	unsigned long fGet (float x, float y);
 
+	inline int GetOrigin ()					{return origin;}
+	inline int GetMode ()					{return mode;}
+	inline ImageFormat GetFormat ()			{return format;}
+	inline const std::string& GetName ()		{return name;}
+
 	inline void SetOrigin (const int o) {origin = o;}
 	inline void SetMode (const int m) { mode = m;}
 	inline void SetFormat (ImageFormat f)	{format = f;}
@@ -0,0 +1,347 @@
+#ifndef IMAGEBUFFER_H
+#define IMAGEBUFFER_H
+
+// contiguous storage backend for Image
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include "tilecache.h"
+
+typedef enum {STORAGE_U16, STORAGE_U32, STORAGE_F32} StorageType;
+typedef enum {LAYOUT_DENSE, LAYOUT_TILED, LAYOUT_SPARSE} StorageLayout;
+typedef enum {PAD_ZERO, PAD_CLAMP, PAD_MIRROR} HaloPadding;
+
+/**
+ * \brief A single, aligned, row-major block of cells.
+ *
+ * Every row starts on an ALIGNMENT byte boundary, so the row stride may be
+ * slightly larger than the image width.  The element type is chosen when the
+ * buffer is allocated:
+ *
+ *	STORAGE_U16		heights/masks which fit in 16 bits, values saturate at 65535
+ *	STORAGE_U32		packed data (Index) and the default heightmap format
+ *	STORAGE_F32		floating point heights
+ *
+ * Values are exchanged as unsigned long, so callers do not need to know
+ * which element type is in use.
+ *
+ * With LAYOUT_TILED the cells are kept as TILE x TILE tiles, each one
+ * row-major, in a scratch file which is paged in and out through a
+ * TileCache.  Only the tiles in use need to be in memory, so images
+ * larger than RAM can be built.  Rows then are only contiguous within a
+ * tile; the row functions handle that, row() is for dense images only.
+ *
+ * Only images are tiled: the mask, heightmap, index, coast distance field
+ * and pyramid levels.  The Executive's CellFlags stay in memory at a byte
+ * per cell, and so do the PointSet pages a set touches: up to a bit per
+ * cell, and 4 bytes per cell more once the set removes points, which the
+ * mask's growing boundary does.  At 65536 x 65536 that is 4 GB of flags,
+ * and the boundary can add up to 16 GB, whatever -resident_mb allows.
+ *
+ * With LAYOUT_SPARSE the tiles are in memory but each one is only
+ * allocated when a cell in it is first set to something other than the
+ * tile's constant (0 to begin with).  Until then every read of the tile
+ * gives the constant, so large areas which are never changed, such as
+ * open ocean, cost nothing and full-map passes can treat them as a single
+ * value through constantTile() and uniform().
+ *
+ * A dense buffer may also carry a halo of ghost cells around the image,
+ * so stencils can read a few cells past the edge with getUnchecked()
+ * rather than testing every access.  The halo holds 0 (PAD_ZERO), repeats
+ * the edge cell (PAD_CLAMP) or reflects the cells inside the edge
+ * (PAD_MIRROR), and writes near the edge update it as they happen.  Each
+ * row still starts on an ALIGNMENT boundary; the left halo is padded out
+ * to one.
+ *
+ * trackWrites() keeps a flag per tile (TILE x TILE cells, whatever the
+ * layout) which any write to the tile sets, and a count of the flagged
+ * tiles, so results computed from the image can be kept until it changes.
+ */
+class ImageBuffer
+{
+private:
+	unsigned int size_x;
+	unsigned int size_y;
+	StorageType type;
+	StorageLayout layout;
+	size_t stride;						// elements per row, including padding
+
+	unsigned char *block;				// allocation as returned by new []
+	unsigned char *base;				// aligned start of the first row, halo included
+	unsigned char *data;				// aligned start of row 0, or of tile 0
+
+	unsigned int halo;					// ghost cells beyond each edge, dense layout only
+	HaloPadding padding;
+	size_t lead;						// elements before column 0, the left halo and its padding
+
+	TileCache *cache;					// tiled layout only
+	size_t tiles_x;
+	size_t tiles_y;
+
+	// sparse layout only: NULL until a tile is written, and what it reads as until then
+	std::unique_ptr<std::atomic<unsigned char *>[]> sparse;
+	std::unique_ptr<uint32_t[]> fills;
+	std::atomic<long> materialized;
+
+	// tiles written since they were last taken, if writes are tracked
+	std::unique_ptr<std::atomic<uint8_t>[]> dirty;
+	std::atomic<long> dirtyTiles;
+
+	unsigned char *materialize (size_t tile);
+	void fillCells (unsigned char *dst, size_t n, unsigned long value);
+	void freeTiles ();
+
+	inline size_t tileOf (unsigned int x, unsigned int y)
+	{
+		return (size_t) (y >> TILE_SHIFT) * tiles_x + (x >> TILE_SHIFT);
+	}
+
+	inline size_t within (unsigned int x, unsigned int y)
+	{
+		return ((y & TILE_MASK) << TILE_SHIFT) + (x & TILE_MASK);
+	}
+
+	// address of a cell, NULL if it is in a sparse tile which has not been written
+	inline unsigned char *locate (unsigned int x, unsigned int y)
+	{
+		if (layout != LAYOUT_SPARSE)
+			return data + index (x, y) * elementSize();
+
+		unsigned char *tile = sparse[tileOf (x, y)].load (std::memory_order_acquire);
+		return (tile == NULL) ? NULL : tile + within (x, y) * elementSize();
+	}
+
+	static inline unsigned long fromFloat (float f)
+	{
+		if (f <= 0)
+			return 0;
+		return (f < 4294967295.0f) ? (unsigned long) f : 4294967295UL;
+	}
+
+	inline unsigned long load (const unsigned char *p)
+	{
+		switch (type)
+		{
+		case STORAGE_U16:
+			return *(const uint16_t *) p;
+		case STORAGE_U32:
+			return *(const uint32_t *) p;
+		default:
+			return fromFloat (*(const float *) p);
+		}
+	}
+
+	inline void store (unsigned char *p, unsigned long value)
+	{
+		switch (type)
+		{
+		case STORAGE_U16:
+			*(uint16_t *) p = (value > 0xffff) ? 0xffff : (uint16_t) value;
+			break;
+		case STORAGE_U32:
+			// truncate rather than saturate, this matches a 32-bit unsigned long
+			*(uint32_t *) p = (uint32_t) value;
+			break;
+		default:
+			*(float *) p = (float) value;
+			break;
+		}
+	}
+
+	// is a cell close enough to the edge to be copied into the halo?
+	inline bool nearEdge (unsigned int x, unsigned int y)
+	{
+		return (x <= halo) || (y <= halo) || (x + halo + 1 >= size_x) || (y + halo + 1 >= size_y);
+	}
+
+	// only the first write to a clean tile stores to the flag
+	inline void markDirty (unsigned int x, unsigned int y)
+	{
+		if (dirty == NULL)
+			return;
+
+		size_t tile = tileOf (x, y);
+		if (! dirty[tile].load (std::memory_order_relaxed) && ! dirty[tile].exchange (1, std::memory_order_relaxed))
+			dirtyTiles++;
+	}
+
+	void markRow (unsigned int y, unsigned int x, unsigned int n);
+
+	int ghosts (int c, int size, int *out);
+	void refreshHalo (unsigned int x, unsigned int y);
+	void refreshRow (unsigned int y, unsigned int x, unsigned int n);
+
+	// what get() returns after set() is given value
+	inline unsigned long stored (unsigned long value)
+	{
+		switch (type)
+		{
+		case STORAGE_U16:
+			return (value > 0xffff) ? 0xffff : value;
+		case STORAGE_U32:
+			return (uint32_t) value;
+		default:
+			return fromFloat ((float) value);
+		}
+	}
+
+	// cells from x to the end of its row, or of its tile's row
+	inline unsigned int span (unsigned int x, unsigned int n)
+	{
+		if (layout == LAYOUT_DENSE)
+			return n;
+
+		unsigned int left = TILE - (x & TILE_MASK);
+		return (n < left) ? n : left;
+	}
+
+	ImageBuffer (const ImageBuffer&);
+	ImageBuffer& operator= (const ImageBuffer&);
+
+public:
+	static const size_t ALIGNMENT = 64;
+
+	static const unsigned int TILE_SHIFT = 8;
+	static const unsigned int TILE = 1 << TILE_SHIFT;		// cells on the edge of a tile
+	static const unsigned int TILE_MASK = TILE - 1;
+
+	static const unsigned int MAX_HALO = 8;
+
+	ImageBuffer ();
+	~ImageBuffer ();
+
+	// tiled buffers page through a scratch file in directory, keeping up to
+	// residentBytes of tiles in memory (0 for no limit); dense ones may have
+	// a halo of up to MAX_HALO cells
+	void allocate (unsigned int x, unsigned int y, StorageType t, StorageLayout l = LAYOUT_DENSE,
+		const char *directory = ".", size_t residentBytes = 0,
+		unsigned int haloCells = 0, HaloPadding haloPadding = PAD_ZERO);
+	void release ();
+	void clear ();
+
+	// set every cell to value: a store per cell when dense, none when sparse
+	void fill (unsigned long value);
+
+	inline bool is_allocated ()					{return (data != NULL) || (sparse != NULL);}
+	inline StorageType getType ()				{return type;}
+	inline StorageLayout getLayout ()			{return layout;}
+	inline TileCache *getCache ()				{return cache;}
+	inline size_t getStride ()					{return stride;}
+	inline size_t elementSize ()
+	{
+		return (type == STORAGE_U16) ? sizeof (uint16_t) : sizeof (uint32_t);
+	}
+	inline size_t bytes ()						{return stride * (size_y + 2 * halo) * elementSize();}
+	inline unsigned int getHalo ()				{return halo;}
+	inline HaloPadding getPadding ()			{return padding;}
+
+	inline bool inHalo (int x, int y)
+	{
+		int h = (int) halo;
+		return (x >= -h) && (y >= -h) && (x < (int) size_x + h) && (y < (int) size_y + h);
+	}
+
+	// raw access to one row, for bulk operations on dense images
+	inline void *row (unsigned int y)			{return data + (size_t) y * stride * elementSize();}
+
+	// element offset of a cell from data, not for the sparse layout
+	inline size_t index (unsigned int x, unsigned int y)
+	{
+		if (layout == LAYOUT_DENSE)
+			return (size_t) y * stride + x;
+
+		size_t tile = tileOf (x, y);
+		cache->touch (tile);
+
+		return (tile << (2 * TILE_SHIFT)) + within (x, y);
+	}
+
+	// the cells in a box, inclusive, are about to be used
+	void prefetch (int x1, int y1, int x2, int y2);
+
+	// tiles of TILE x TILE cells, as the tiled and sparse layouts store them
+	inline size_t tilesAcross ()				{return tiles_x;}
+	inline size_t tilesDown ()					{return tiles_y;}
+	inline long materializedTiles ()			{return materialized;}
+
+	// true, with its value, if a tile has never been written
+	bool constantTile (unsigned int tx, unsigned int ty, unsigned long& value);
+
+	// true, with the value, if the cells of a box (inclusive) which are on the
+	// image all lie in unwritten tiles of the same value
+	bool uniform (int x1, int y1, int x2, int y2, unsigned long& value);
+
+	// set every cell of a tile to value and free its memory; nothing else
+	// may be using the tile at the time
+	void fillTile (unsigned int tx, unsigned int ty, unsigned long value);
+
+	// flag tiles as they are written, all of them to begin with
+	void trackWrites ();
+	inline long getDirtyTiles ()				{return dirtyTiles;}
+
+	// was a tile written since the last call?  Clears its flag.
+	bool takeDirty (size_t tile);
+
+	// copy part of a row to or from int32 values, with the type switch hoisted out
+	void getRow (unsigned int y, unsigned int x, unsigned int n, int32_t *dst);
+	void setRow (unsigned int y, unsigned int x, unsigned int n, const int32_t *src);
+
+	// the same values get() returns and set() takes, for n cells starting at (x,y)
+	void getRow (unsigned int y, unsigned int x, unsigned int n, uint32_t *dst);
+	void setRow (unsigned int y, unsigned int x, unsigned int n, const uint32_t *src);
+
+	// n cells as they are stored, elementSize() bytes each
+	void copyRow (unsigned int y, unsigned int x, unsigned int n, void *dst);
+
+	inline unsigned long get (unsigned int x, unsigned int y)
+	{
+		const unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+			return fills[tileOf (x, y)];
+
+		return load (p);
+	}
+
+	inline void set (unsigned int x, unsigned int y, unsigned long value)
+	{
+		unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+		{
+			size_t tile = tileOf (x, y);
+
+			// writing the constant back changes nothing
+			if (stored (value) == fills[tile])
+				return;
+
+			p = materialize (tile) + within (x, y) * elementSize();
+		}
+
+		store (p, value);
+		markDirty (x, y);
+
+		if ((padding != PAD_ZERO) && nearEdge (x, y))
+			refreshHalo (x, y);
+	}
+
+	// dense buffers only, and nothing is checked: x and y may be up to the
+	// halo off the image when reading, and must be on it when writing
+	inline unsigned long getUnchecked (int x, int y)
+	{
+		return load (data + ((ptrdiff_t) y * (ptrdiff_t) stride + x) * (ptrdiff_t) elementSize());
+	}
+
+	inline void setUnchecked (unsigned int x, unsigned int y, unsigned long value)
+	{
+		store (data + ((size_t) y * stride + x) * elementSize(), value);
+		markDirty (x, y);
+
+		if ((padding != PAD_ZERO) && nearEdge (x, y))
+			refreshHalo (x, y);
+	}
+};
+
+#endif
@@ -11,6 +11,18 @@ public:
 
 	void SetPrimary (uint x, uint y, uchar texture_id, uchar alpha);
 	void SetSecondary (uint x, uint y, uchar texture_id, uchar alpha);
+
+	// primary and secondary both, in one store
+	void SetTexture (uint x, uint y, uchar texture_id, uchar alpha);
+
+	// every cell, primary and secondary both
+	void FillTexture (uchar texture_id, uchar alpha);
+
+	static inline ulong Pack (uchar primary, uchar primary_alpha, uchar secondary, uchar secondary_alpha)
+	{
+		return ((ulong) primary << 24) | ((ulong) primary_alpha << 16) |
+			((ulong) secondary << 8) | secondary_alpha;
+	}
 	uchar PrimaryAlpha (uint x, uint y);
 	uchar PrimaryTexture (uint x, uint y);
 	uchar SecondaryAlpha (uint x, uint y);
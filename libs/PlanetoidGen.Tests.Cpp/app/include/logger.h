@@ -1,22 +1,158 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <stdio.h>
+#include <stdint.h>
 #include <cstdarg>
 #include <memory>			// for unique_ptr
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
+// severities, least severe first; MAPGEN_LOG_LEVEL takes the same numbers
+typedef enum
+{
+	LOG_LEVEL_TRACE = 0,			// inside loops over points
+	LOG_LEVEL_DEBUG = 1,			// what a single agent or operation did
+	LOG_LEVEL_INFO = 2,				// parameters and the phases of a run
+	LOG_LEVEL_WARN = 3,				// something was skipped or given up on
+	LOG_LEVEL_ERROR = 4,			// a run cannot go on as asked
+	LOG_LEVEL_OFF = 5
+} LogLevel;
+
+typedef enum
+{
+	LOG_GENERAL = 0,				// the run as a whole and the scheduler
+	LOG_MASK,						// the land mask
+	LOG_AGENTS,						// mountain, hill, shoreline, smooth and river agents
+	LOG_TERRAIN,					// operations on the heightmap
+	LOG_WATER,						// lakes, water flow and erosion
+	LOG_STORAGE,					// images, tiles and the files behind them
+	LOG_CATEGORIES
+} LogCategory;
+
+// messages below this level are not compiled in at all
+#ifndef MAPGEN_LOG_LEVEL
+#define MAPGEN_LOG_LEVEL 1
+#endif
+
+/**
+ * \brief printf style logging to a file, written out by a thread of its own.
+ *
+ * Log formats a message on the calling thread and copies it into a ring of
+ * fixed size slots, claiming them with a single atomic add; the writer
+ * thread takes them in order and writes them out in batches.  Logging
+ * makes no system call and takes no lock, and only waits when the ring is
+ * full.  A message is never split by another thread's.
+ *
+ * Messages have a level and a category, and only those at or above the
+ * level set and in the categories set reach the file.  The LOG_* macros
+ * test both before they evaluate any arguments.
+ */
 class Logger
 {
 	private:
+		static const unsigned int SLOTS = 4096;			// a power of 2
+		static const unsigned int SLOT_TEXT = 116;		// 128 byte slots
+		static const unsigned int MAX_SLOTS = 64;		// longer messages are cut short
+
+		typedef struct
+		{
+			std::atomic<uint64_t> sequence;		// ticket + 1 once filled, ticket + SLOTS once written
+			uint32_t length;
+			char text[SLOT_TEXT];
+		} Slot;
+
 		static std::unique_ptr<Logger> _instance;
 		FILE *logfile;
+		LogLevel level;
+		unsigned int categories;				// a bit per LogCategory
+
+		std::unique_ptr<Slot[]> ring;
+		std::atomic<uint64_t> tail;				// the next ticket to hand out
+		uint64_t head;							// the next slot to write, the writer's own
+		std::atomic<uint64_t> written;
+		std::atomic<bool> sleeping;
+		bool stopping;
+		std::mutex lock;						// the writer sleeps and stops under this
+		std::condition_variable wake;
+		std::condition_variable drained;
+		std::thread writer;
+
+		void push (const char *text, size_t length);
+		void wakeWriter ();
+		void drain ();
+		void stop ();
 	protected:
 		Logger ();
+		friend class GenerationContext;
 	public:
+		~Logger ();
+
 		static Logger& Instance();
+
+		// log to l, or nowhere if it is NULL; what was logged to the
+		// previous file is written out first
 		void SetLog (FILE *l);
-		void Log (const char *fmt, ...);
-		void Log (std::string msg);
+		void SetLevel (LogLevel l);
+		void SetCategories (unsigned int mask);
+
+		inline bool Enabled (LogLevel l, LogCategory c)
+		{
+			return (logfile != NULL) && (l >= level) && ((categories >> c) & 1);
+		}
+
+		void Log (LogLevel l, LogCategory c, const char *fmt, ...);
+		void Log (LogLevel l, LogCategory c, const std::string& msg);
+
+		// wait until everything logged so far is in the file
+		void Flush ();
+
+		// "trace" ... "off"; a comma separated list of category names, or "all"
+		static bool ParseLevel (const std::string& name, LogLevel& l);
+		static bool ParseCategories (const std::string& names, unsigned int& mask);
 };
 
+#define LOG_AT(l, c, ...) \
+	do \
+	{ \
+		Logger& _logger = Logger::Instance(); \
+		if (_logger.Enabled (l, c)) \
+			_logger.Log (l, c, __VA_ARGS__); \
+	} while (0)
+
+#define LOG_NOTHING(c, ...)		do {} while (0)
+
+#if MAPGEN_LOG_LEVEL <= 0
+#define LOG_TRACE(c, ...)		LOG_AT (LOG_LEVEL_TRACE, c, __VA_ARGS__)
+#else
+#define LOG_TRACE(c, ...)		LOG_NOTHING (c, __VA_ARGS__)
+#endif
+
+#if MAPGEN_LOG_LEVEL <= 1
+#define LOG_DEBUG(c, ...)		LOG_AT (LOG_LEVEL_DEBUG, c, __VA_ARGS__)
+#else
+#define LOG_DEBUG(c, ...)		LOG_NOTHING (c, __VA_ARGS__)
+#endif
+
+#if MAPGEN_LOG_LEVEL <= 2
+#define LOG_INFO(c, ...)		LOG_AT (LOG_LEVEL_INFO, c, __VA_ARGS__)
+#else
+#define LOG_INFO(c, ...)		LOG_NOTHING (c, __VA_ARGS__)
+#endif
+
+#if MAPGEN_LOG_LEVEL <= 3
+#define LOG_WARN(c, ...)		LOG_AT (LOG_LEVEL_WARN, c, __VA_ARGS__)
+#else
+#define LOG_WARN(c, ...)		LOG_NOTHING (c, __VA_ARGS__)
+#endif
+
+#if MAPGEN_LOG_LEVEL <= 4
+#define LOG_ERROR(c, ...)		LOG_AT (LOG_LEVEL_ERROR, c, __VA_ARGS__)
+#else
+#define LOG_ERROR(c, ...)		LOG_NOTHING (c, __VA_ARGS__)
+#endif
+
 #endif
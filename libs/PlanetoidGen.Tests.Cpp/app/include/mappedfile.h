@@ -0,0 +1,51 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * \brief A new file of fixed length, written through a memory mapping.
+ *
+ * create() sizes the file and maps it; callers fill bytes() in place and
+ * the kernel writes the pages back.  The file starts out zeroed.  Where
+ * mmap is not available the bytes are held in memory and written out by
+ * close().
+ *
+ * createScratch() makes an unnamed file instead, which disappears when it
+ * is closed; it is used to page large images out of memory.
+ */
+class MappedFile
+{
+private:
+	std::string filename;
+	uint8_t *base;
+	size_t length;
+	int fd;
+	bool scratch;						// no name, nothing to keep
+
+	bool map ();
+
+	MappedFile (const MappedFile&);
+	MappedFile& operator= (const MappedFile&);
+
+public:
+	MappedFile ();
+	~MappedFile ();
+
+	bool create (const char *name, size_t bytes);
+	bool createScratch (const char *directory, size_t bytes);
+	bool close ();
+
+	// hints for a page aligned range of the mapping
+	void willNeed (size_t offset, size_t bytes);
+	void release (size_t offset, size_t bytes);		// drop from memory, contents are kept
+
+	bool zero ();
+
+	inline uint8_t *bytes ()				{return base;}
+	inline size_t size ()					{return length;}
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>			// for unique_ptr
+#include <mutex>
+#include <string>
+#include "heaptrack.h"
+#include "trace.h"
+
+class GenerationContext;
+
+typedef enum
+{
+	COUNT_CELLS_WRITTEN,				// heightmap and index cells stored
+	COUNT_FIXED_LOOKUPS,				// Executive::isFixed calls
+	COUNT_AGENT_STEPS,					// Agent::Execute calls
+	COUNT_BYTES_WRITTEN,				// image files
+	COUNT_FILES_WRITTEN,
+	NUM_COUNTERS
+} Counter;
+
+/**
+ * \brief Phase timings and event counts for one map generation.
+ *
+ * Each GenerationContext has its own, which Metrics::Instance() resolves
+ * to while the context is bound, the way Logger::Instance() does; outside
+ * a context there is one for the process.
+ *
+ * Counters are spread over cache line sized shards picked by thread, so
+ * agents on several threads do not fight over one line.  Phase times are
+ * added under a lock, as phases are seldom shorter than an agent's turn.
+ */
+class Metrics
+{
+private:
+	static const unsigned int SHARDS = 16;
+
+	typedef struct alignas(64)
+	{
+		std::atomic<uint64_t> counts[NUM_COUNTERS];
+	} Shard;
+
+	struct Phase
+	{
+		std::string name;
+		uint64_t nanoseconds;
+		long calls;
+		HeapCounters heap;
+
+		Phase (const char *n) : name (n), nanoseconds (0), calls (0)	{}
+	};
+
+	static std::unique_ptr<Metrics> _instance;
+
+	Shard shards[SHARDS];
+	std::mutex lock;
+	std::deque<Phase> phases;				// in the order they first ran; never moved
+	std::chrono::steady_clock::time_point started;
+
+	static unsigned int nextShard ();
+	Phase& find (const char *phase);
+
+public:
+	Metrics ();
+
+	static Metrics& Instance ();
+
+	inline void count (Counter c, uint64_t n = 1)
+	{
+		static thread_local unsigned int shard = nextShard ();
+		shards[shard].counts[c].fetch_add (n, std::memory_order_relaxed);
+	}
+
+	uint64_t total (Counter c);
+	void addTime (const char *phase, uint64_t nanoseconds);
+
+	// the heap counts for a phase, for as long as the Metrics lives
+	HeapCounters& heapPhase (const char *phase);
+
+	// clear everything and restart the run clock
+	void reset ();
+	double elapsed ();
+
+	// the current context's parameters, phases and counters as JSON
+	bool WriteReport (const std::string& filename);
+
+	static const char *CounterName (Counter c);
+};
+
+/**
+ * \brief Adds the time from its construction to its destruction to a phase,
+ * and charges the heap allocations on its thread to it meanwhile.  When
+ * the context is tracing, the phase is a span on the timeline too, unless
+ * traced is false because the caller records something finer.
+ */
+class PhaseTimer
+{
+private:
+	Metrics& metrics;
+	const char *phase;
+	HeapPhaseScope heap;
+	Trace *trace;
+	uint64_t traceStart;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	PhaseTimer (const char *name, bool traced = true)
+		: metrics (Metrics::Instance()), phase (name), heap (&metrics.heapPhase (name)),
+		  trace (traced ? Trace::Current() : NULL), traceStart ((trace != NULL) ? trace->now() : 0),
+		  start (std::chrono::steady_clock::now())	{}
+	~PhaseTimer ()
+	{
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - start);
+		metrics.addTime (phase, (uint64_t) ns.count());
+
+		if (trace != NULL)
+		{
+			trace->span ("phase", phase, traceStart, trace->now());
+		}
+	}
+};
+
+#endif
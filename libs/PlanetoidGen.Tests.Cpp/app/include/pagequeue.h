@@ -0,0 +1,44 @@
+#ifndef PAGEQUEUE_H
+#define PAGEQUEUE_H
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * \brief Runs page writes on the thread pool, a bounded number at a time.
+ *
+ * add() blocks while limit pages are queued or being written, so however
+ * many pages a map splits into only that many are ever in memory at once.
+ * Several images may share a queue, which lets their pages be written
+ * side by side.  finish() (or the destructor) waits for every page.
+ *
+ * A page returns false if it could not be written; the workers only
+ * count the failures, and finish() reports them to the thread that
+ * queued the pages, which decides what to do.
+ */
+class PageQueue
+{
+private:
+	std::mutex lock;
+	std::condition_variable slot;			// a page finished
+	int inFlight;
+	int limit;
+	int failed;								// pages which returned false since the last finish()
+
+	PageQueue (const PageQueue&);
+	PageQueue& operator= (const PageQueue&);
+
+public:
+	static const int PAGES_PER_THREAD = 2;
+
+	PageQueue (int _limit = 0);				// 0 picks PAGES_PER_THREAD per pool thread
+	~PageQueue ();
+
+	void add (std::function<bool()> page);
+
+	// false, logged, if any page since the last finish() failed
+	bool finish ();
+};
+
+#endif
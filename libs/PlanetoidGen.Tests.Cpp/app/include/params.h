@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>		// for unique_ptr
 #include "image.h"
+#include "logger.h"
 
 class Params
 {
@@ -21,6 +22,18 @@ public:
 	int scale_y;
 	int scale_z;
 	ImageFormat format;
+	StorageType height_storage;			// element type of the heightmap cells
+	StorageLayout storage_layout;		// dense in memory, tiles paged through a scratch file, or sparse tiles
+	std::string scratch_dir;			// where tiled images keep their scratch files
+	int resident_mb;					// memory each tiled image may keep paged in, 0 for no limit;
+										// cell flags and point sets are not tiled, see ImageBuffer
+	HaloPadding halo_padding;			// what the heightmap's ghost cells hold beyond the edge
+	bool write_coast_distance;			// export the distance-to-coast field
+	RawFormat raw_format;				// also export heights as raw samples
+	bool raw_header;					// put a self-describing header on raw files
+	int lod_levels;						// reduced levels of detail to write pages for
+	LogLevel log_level;					// least severe message written to the log
+	unsigned int log_categories;		// a bit per LogCategory to write
 	int page_size;						// num pixels on edge of a page
 	int noise_size;						// random noise about midpoint
 	int height_limit;
@@ -81,6 +94,26 @@ public:
 	int smooth_tokens;
 	int hill_tokens;
 
+	// relative scheduling weights per agent type, 1 is an even share
+	int mountain_weight;
+	int beach_weight;
+	int smooth_weight;
+	int hill_weight;
+	int river_weight;
+
+	// agent execution
+	int threads;						// worker threads running agents, 1 runs them in turn
+	bool deterministic;					// run agents in fixed batches, same map for any thread count
+	int lease_tile;						// edge of the tiles agents lease while running
+
+	// batch generation
+	int jobs;							// maps generated at once
+	int num_seeds;						// consecutive seeds from 'seed' to generate
+	std::string output_prefix;			// prepended to every output file name
+	std::string report;					// JSON timings and counters for each map, if set
+	bool heap_track;					// count heap use by phase and subsystem
+	std::string trace;					// Chrome trace of phases and agent slices, if set
+
 	// derived values
 	int num_x_pages;
 	int num_y_pages;
@@ -0,0 +1,60 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+typedef enum {PNG_GREY8, PNG_GREY16, PNG_RGBA8} PngFormat;
+
+/**
+ * \brief Streams an image to a PNG file a band of rows at a time.
+ *
+ * Rows are pulled from a callback, so no full-size copy of the image is
+ * ever made.  The image is cut into bands of at least BAND_BYTES of
+ * scanline data; each band is filtered and deflated on its own, with a
+ * sync flush between bands so the pieces concatenate into one zlib
+ * stream, and a window of bands is compressed across the thread pool
+ * before being written out in order.  Memory use is therefore bounded by
+ * the window, not the image.
+ *
+ * Bands do not share a deflate dictionary, which costs a little ratio at
+ * band boundaries but makes the file independent of the thread count.
+ */
+class PngWriter
+{
+public:
+	// fills one scanline, in the output format, for image row y
+	typedef std::function<void(unsigned int y, uint8_t *row)> RowSource;
+
+	static const size_t BAND_BYTES = 256 * 1024;
+	static const int LEVEL = 6;					// zlib compression level
+
+	PngWriter (PngFormat f, unsigned int width, unsigned int height);
+
+	// false, logged, if the file cannot be opened, encoded or written
+	bool write (const char *filename, RowSource source);
+
+private:
+	typedef struct
+	{
+		std::vector<uint8_t> data;				// compressed, ready for an IDAT chunk
+		uint32_t adler;							// of the uncompressed, filtered band
+		size_t length;							// uncompressed length
+	} Band;
+
+	PngFormat format;
+	unsigned int width;
+	unsigned int height;
+	int bpp;									// bytes per pixel
+	size_t rowBytes;							// scanline without the filter byte
+	unsigned int bandRows;
+
+	bool compressBand (RowSource& source, unsigned int band, bool last, Band& out);
+	void filterRow (const uint8_t *row, const uint8_t *prior, uint8_t *trial, uint8_t *out);
+
+	static void writeChunk (FILE *f, const char *type, const uint8_t *data, size_t length);
+};
+
+#endif
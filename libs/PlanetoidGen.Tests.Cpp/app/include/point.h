@@ -21,6 +21,15 @@ public:
 	Point (int x, int y);
 };
 
+// an inclusive box of cells, which may hang off the edges of the map
+typedef struct
+{
+	int x1;
+	int y1;
+	int x2;
+	int y2;
+} Rect;
+
 #if 0
 // ==========================================================
 // STL Point Containers
@@ -2,26 +2,61 @@
 #define POINTSET_H
 
 #include "point.h"
-#include <set>
-
-typedef std::set<int> IntegerSet;
+#include <vector>
+#include <stdint.h>
 
+/**
+ * \brief A set of map cells with O(1) membership, insert, remove and
+ *        random selection.
+ *
+ * Membership is kept in a per-cell bitmap, and the members themselves in a
+ * dense vector so a random member is a single index.  Removal swaps the last
+ * member into the hole, which means iteration follows insertion order rather
+ * than coordinate order.  Callers which need coordinate order can turn on
+ * ordered iteration with setOrdered().
+ *
+ * Bitmap and slot storage is allocated one page at a time, so small sets on
+ * large maps stay small.  The slot index (position of each member in the
+ * dense vector) is only built once a set first removes a point.
+ */
 class PointSet
 {
 private:
-	IntegerSet points;
-	IntegerSet::iterator impl_iter;
+	static const int PAGE_SHIFT = 12;					// 4096 cells per page
+	static const int PAGE_CELLS = 1 << PAGE_SHIFT;
+	static const int PAGE_WORDS = PAGE_CELLS / 64;
+
+	std::vector<int> dense;								// members, swap-removed
+	std::vector<std::vector<uint64_t> > bits;			// membership bitmap pages
+	std::vector<std::vector<int> > slots;				// position in dense, per cell
+	bool have_slots;
+
+	bool ordered;										// iterate in coordinate order
+	bool order_valid;
+	std::vector<int> order;								// sorted copy of dense
+
+	unsigned int impl_iter;
 
 	int x_dim;
 	int y_dim;
-	void pointOf(int id, Point& p);
+
+	void pointOf (int id, Point& p);
+	int coordOf (int x, int y);
+	bool test (int coord);
+	void mark (int coord, bool value);
+	void buildSlots ();
+	void setSlot (int coord, int pos);
+	int getSlot (int coord);
+	std::vector<int>& sequence ();
+	void reset ();
 
 public:
 	PointSet ();
 	PointSet (int x_dim, int y_dim);
 	virtual ~PointSet();
 
-	inline void setSize (int x_size, int y_size)	{x_dim = x_size; y_dim = y_size; }
+	void setSize (int x_size, int y_size);
+	void setOrdered (bool b);
 
 	bool in_set (int x, int y);
 	bool in_set (Point& p);
@@ -35,7 +70,8 @@ public:
 	void insert (Point& p);
 	void remove (int x, int y);
 	inline void remove (Point& p)				{ remove(p.x, p.y); }
-	inline int size () {return points.size();}
+	inline int size () {return (int) dense.size();}
+	void clear ();
 	void printSet ();
 	void Reset_Iterator ();
 	bool Iterate_Next (Point& next);
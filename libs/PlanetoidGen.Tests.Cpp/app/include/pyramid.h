@@ -0,0 +1,78 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "image.h"
+#include "index.h"
+#include <vector>
+
+class PageQueue;
+
+/**
+ * \brief Reduced levels of detail for the heightmap and texture index.
+ *
+ * Level n is the map shrunk by 2^n on each axis, rounding up.  Every
+ * height level holds the average, lowest and highest of the cells it
+ * covers; the index level holds the most common of its four children
+ * (the earliest, in row order, on a tie) so texture ids are never
+ * blended into ones that do not exist.
+ *
+ * build() makes all of the levels in a single pass over the map: each
+ * TILE x TILE block of cells is reduced level by level in a small
+ * per-thread buffer before moving on, and blocks are spread over the
+ * thread pool.  A block ends as one cell at level TILE_LEVELS; any levels
+ * above that are reduced from those cells, which are few.
+ */
+class Pyramid
+{
+private:
+	typedef struct
+	{
+		uint64_t sum;
+		uint32_t count;
+		uint32_t lowest;
+		uint32_t highest;
+	} Summary;
+
+	Image& heights;
+	Image& index;
+	int levels;
+	int tiles_x;
+	int tiles_y;
+
+	// one cell per block, at level TILE_LEVELS
+	std::vector<Summary> top;
+	std::vector<uint32_t> topModes;
+
+	// element n - 1 holds level n
+	std::vector<Image *> average;
+	std::vector<Image *> minimum;
+	std::vector<Image *> maximum;
+	std::vector<Index *> modal;
+
+	void buildTile (int tx, int ty);
+	void store (int level, uint gx, uint gy, uint w, uint h, const Summary *cells, const uint32_t *modes);
+	static void reduce (const std::vector<Summary>& cells, const std::vector<uint32_t>& modes, uint w, uint h,
+		std::vector<Summary>& out, std::vector<uint32_t>& outModes);
+
+public:
+	static const int TILE_LEVELS = 7;
+	static const int TILE = 1 << TILE_LEVELS;		// map cells on the edge of a block
+	static const int MAX_LEVELS = 24;
+
+	Pyramid (Image& _heights, Image& _index, int _levels);
+	~Pyramid ();
+
+	void build ();
+
+	// queue the pages of every level, named after the map's pages: "<name>L<n>.", "<name>L<n>.Min." ...;
+	// each level has the map's page numbers, and each page the ground of the map page with its number
+	void split (int page_size, PageQueue& pages);
+
+	inline int getLevels ()						{return levels;}
+	inline Image& getAverage (int level)		{return *average[level - 1];}
+	inline Image& getMinimum (int level)		{return *minimum[level - 1];}
+	inline Image& getMaximum (int level)		{return *maximum[level - 1];}
+	inline Index& getIndex (int level)			{return *modal[level - 1];}
+};
+
+#endif
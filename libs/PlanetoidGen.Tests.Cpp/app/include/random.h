@@ -0,0 +1,71 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// well known sub-streams of the root stream
+enum {STREAM_MASK = 1, STREAM_NOISE, STREAM_SCHEDULE};
+
+/**
+ * \brief A splittable, counter-based random number stream.
+ *
+ * Each value is a SplitMix64 hash of the stream key and a counter, so a stream
+ * is just two integers and the n-th value depends on nothing but (key, n).
+ * New streams are derived either by split(), which draws a key from this
+ * stream, or by stream(id), which hashes a fixed id into this stream's key
+ * without advancing it.
+ *
+ * The root stream belongs to the bound GenerationContext and is seeded from
+ * Params::seed.  Every agent and Action owns a stream split from whoever
+ * created it, and whichever stream is installed as current on a thread
+ * serves the shared helpers (random points, neighbours, point set members),
+ * so results no longer depend on the C library or on the order unrelated
+ * code happens to draw numbers in.
+ */
+class Random
+{
+private:
+	uint64_t key;
+	uint64_t counter;
+
+public:
+	Random (uint64_t seed = 0);
+
+	static uint64_t mix (uint64_t z);
+
+	uint64_t next64 ();
+	inline uint32_t next ()					{return (uint32_t) (next64() >> 32);}
+
+	/// a value in [0, n), or 0 if n is not positive
+	inline int nextInt (int n)
+	{
+		if (n <= 0)
+			return 0;
+
+		return (int) (((uint64_t) next() * (uint32_t) n) >> 32);
+	}
+
+	Random split ();
+	Random stream (uint64_t id) const;
+
+	// the root stream, and the stream installed on the calling thread
+	static void Seed (uint64_t seed);
+	static Random& Root ();
+	static Random& Current ();
+	static Random *Install (Random *r);
+};
+
+/**
+ * \brief Install a stream as current for the lifetime of a scope.
+ */
+class RandomScope
+{
+private:
+	Random *previous;
+
+public:
+	RandomScope (Random& r)				{previous = Random::Install (&r);}
+	~RandomScope ()						{Random::Install (previous);}
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <vector>
+#include "agent.h"
+#include "random.h"
+
+typedef std::vector<Agent *> AgentList;
+
+/**
+ * \brief The pool of runnable agents, with constant-time random pick and removal.
+ *
+ * Runnable agents are kept in one vector per agent type.  Each agent records
+ * its position in its pool, so removal moves the last agent of the pool into
+ * the vacated slot.  A pick draws one random number over the weighted total of
+ * all pools; with every weight at 1 each runnable agent is equally likely,
+ * exactly as before.
+ *
+ * Deferred agents (rivers, erosion) are held back until release() is called.
+ */
+class Scheduler
+{
+private:
+	AgentList pool[NUM_AGENT_TYPES];
+	int weight[NUM_AGENT_TYPES];
+	long total;							// sum of weight * pool size
+
+	AgentList deferred;
+	bool released;
+
+public:
+	Scheduler ();
+
+	void setWeight (AgentType type, int w);
+	inline int getWeight (AgentType type)		{return weight[type];}
+
+	void add (Agent *a);
+	void defer (Agent *a);
+	void remove (Agent *a);
+	Agent *pick (Random& rng);
+
+	void release ();
+	inline bool isReleased ()					{return released;}
+
+	inline bool empty ()						{return size() == 0;}
+	long size ();
+	inline long size (AgentType type)			{return pool[type].size();}
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SMOOTHKERNEL_H
+#define SMOOTHKERNEL_H
+
+#include <stdint.h>
+#include <mutex>
+#include "image.h"
+#include "cellflags.h"
+
+/**
+ * \brief In-place sweep smoothing with the 12-weight cross stencil.
+ *
+ * Each cell becomes
+ *
+ *	(4 c + w1 + w2 + e1 + e2 + n1 + n2 + s1 + s2) / 12
+ *
+ * exactly as Executive::smoothPoint computes it, sweeping rows top to bottom
+ * and each row left to right, so cells to the west and north have already
+ * been smoothed when a cell is visited.  Cells off the map are read from the
+ * image's halo, with its padding mode, and count as 0 beyond it; fixed and
+ * ocean cells are left alone.
+ *
+ * Rows are worked in chunks.  The part of the stencil which only reads
+ * unsmoothed cells is summed over the whole chunk in one vectorizable loop,
+ * leaving a short scalar recurrence for the two western neighbours.
+ *
+ * The highest and lowest values written are tracked as rows are finished,
+ * so a full sweep also gives the map's range without another pass.
+ */
+class SmoothKernel
+{
+private:
+	Image& map;
+	CellFlags& flags;
+	int x_size;
+	int y_size;
+
+	int32_t highest;
+	int32_t lowest;
+	std::mutex rangeLock;
+
+	int32_t offMap (int x, int y);
+	void sweepChunk (int y, int x1, int x2, int32_t& hi, int32_t& lo);
+	void merge (int32_t hi, int32_t lo);
+
+public:
+	static const int CHUNK = 256;				// columns per chunk
+	static const uint8_t SKIP = CELL_FIXED | CELL_OCEAN;
+
+	SmoothKernel (Image& m, CellFlags& f);
+
+	// smooth rows [y1, y2), single threaded
+	void sweepRows (int y1, int y2);
+
+	// the same result, with chunks on a diagonal wavefront run across the thread pool
+	void sweepRowsParallel (int y1, int y2);
+
+	// range of the rows swept so far, as left after smoothing
+	inline int32_t maxSeen ()				{return highest;}
+	inline int32_t minSeen ()				{return lowest;}
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef TEXTUREKERNEL_H
+#define TEXTUREKERNEL_H
+
+#include <stdint.h>
+#include <vector>
+#include "image.h"
+#include "index.h"
+#include "cellflags.h"
+
+/**
+ * \brief The altitude/slope rule PostRun uses to texture the map.
+ *
+ * Textures are given as packed Index values, with the same texture and
+ * full alpha in both the primary and secondary slots.
+ */
+typedef struct
+{
+	int snowline;				// above this is snow
+	int rock_gradient;			// steeper than this is rock
+	int dirtline;				// below this is dirt, otherwise grass
+
+	uint32_t snow;
+	uint32_t rock;
+	uint32_t dirt;
+	uint32_t grass;
+} TextureRule;
+
+/**
+ * \brief Textures every unfixed cell of the map from its height and slope.
+ *
+ * The slope is the largest height difference to any of the eight
+ * neighbours, with cells off the map read from the heights' halo, and 0
+ * beyond it, as in Executive::maxGradient.  The map is split into tiles of CHUNK columns
+ * of a row; each tile reads a one cell halo around it and writes only its
+ * own cells of the index, so tiles can run in any order.
+ *
+ * On sparse images, an index tile with no fixed cells over an unwritten
+ * tile of heights, whose halo has the same height, is given its single
+ * texture with Image::FillTile rather than being classified cell by cell.
+ */
+class TextureKernel
+{
+private:
+	Image& heights;
+	Index& index;
+	CellFlags& flags;
+	int x_size;
+	int y_size;
+	int tiles_x;
+
+	// index tiles set in one go by fillTiles, the chunks in them are skipped
+	std::vector<bool> filled;
+
+	int32_t offMap (int x, int y);
+	void classifyChunk (int y, int x1, int x2, const TextureRule& rule);
+	bool ringIs (int x1, int y1, int x2, int y2, unsigned long value);
+	void fillTiles (int y1, int y2, const TextureRule& rule);
+	inline bool isFilled (int y, int x)
+	{
+		return ! filled.empty() && filled[(y / ImageBuffer::TILE) * tiles_x + x / ImageBuffer::TILE];
+	}
+
+	// the rule for one cell, lowest priority first so each test is a select
+	static inline uint32_t choose (int32_t h, int32_t slope, const TextureRule& rule)
+	{
+		uint32_t t = rule.grass;
+
+		t = (h < rule.dirtline) ? rule.dirt : t;
+		t = (slope > rule.rock_gradient) ? rule.rock : t;
+		t = (h > rule.snowline) ? rule.snow : t;
+
+		return t;
+	}
+
+public:
+	static const int CHUNK = 256;				// columns per tile
+	static_assert (ImageBuffer::TILE % CHUNK == 0, "a chunk must not cross an image tile");
+
+	TextureKernel (Image& h, Index& i, CellFlags& f);
+
+	static uint32_t pack (int texture);
+
+	void classifyRows (int y1, int y2, const TextureRule& rule);
+	void classifyParallel (const TextureRule& rule);
+};
+
+#endif
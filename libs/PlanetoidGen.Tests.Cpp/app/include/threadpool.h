@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+/**
+ * \brief A fixed set of worker threads running queued tasks.
+ *
+ * Sized from Params::threads the first time it is used.  With one thread
+ * no workers are started and tasks run inline on the caller, so the
+ * single-threaded build behaves exactly as it always has.
+ *
+ * Sized for whichever is larger of -threads and -jobs.  When several maps
+ * are generated at once each runs on a worker, and the parallel kernels
+ * inside it run inline on that worker.
+ */
+class ThreadPool
+{
+private:
+	static std::unique_ptr<ThreadPool> _instance;
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex lock;
+	std::condition_variable wake;			// a task was queued, or we are stopping
+	std::condition_variable idle;			// the last outstanding task finished
+	int outstanding;						// queued plus running
+	bool stopping;
+
+	void workerLoop ();
+
+protected:
+	ThreadPool (int threads);
+
+public:
+	static ThreadPool& Instance ();
+	~ThreadPool ();
+
+	inline int size ()						{return workers.empty() ? 1 : (int) workers.size();}
+
+	// true on the pool's own threads, where anything submitted runs inline
+	static bool onPoolThread ();
+
+	void submit (std::function<void()> task);
+	void wait ();
+
+	// split [0, n) into contiguous chunks, run them across the pool and wait
+	void parallelFor (int n, std::function<void(int, int)> body);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "mappedfile.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+/**
+ * \brief Equal-sized tiles of an image, paged between a scratch file and memory.
+ *
+ * The tiles live in a memory-mapped scratch file, so the kernel pages
+ * them in on first access.  Each tile carries a residency state which
+ * accessors check with touch(); that is one relaxed byte load while the
+ * tile is in recent use.  Once more than the residency limit are in
+ * memory the least recently used (by the clock approximation) are written
+ * back and dropped.  Dropping a tile never loses data, the next access
+ * reads it back from the file, so no locking is needed around the cells
+ * themselves.
+ */
+class TileCache
+{
+private:
+	enum {TILE_ABSENT, TILE_RESIDENT, TILE_REFERENCED};
+
+	MappedFile file;
+	size_t tileBytes;
+	size_t tiles;
+	std::unique_ptr<std::atomic<uint8_t>[]> state;
+
+	std::mutex lock;						// guards the residency count and the clock
+	size_t resident;
+	size_t limit;
+	size_t hand;
+
+	std::atomic<long> faults;
+	std::atomic<long> evictions;
+
+	void fault (size_t tile);
+	void evict ();
+
+	TileCache (const TileCache&);
+	TileCache& operator= (const TileCache&);
+
+public:
+	TileCache ();
+	~TileCache ();
+
+	// limit of 0 keeps every tile that has been used
+	bool create (size_t _tiles, size_t _tileBytes, size_t _limit, const char *directory);
+	void release ();
+	void clear ();
+
+	inline uint8_t *base ()					{return file.bytes();}
+
+	// note an access to a tile
+	inline void touch (size_t tile)
+	{
+		if (state[tile].load (std::memory_order_relaxed) != TILE_REFERENCED)
+		{
+			fault (tile);
+		}
+	}
+
+	// a tile is about to be used, start reading it in
+	void prefetch (size_t tile);
+
+	inline long getFaults ()				{return faults;}
+	inline long getEvictions ()				{return evictions;}
+};
+
+#endif
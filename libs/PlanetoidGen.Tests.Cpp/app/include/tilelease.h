@@ -0,0 +1,36 @@
+#ifndef TILELEASE_H
+#define TILELEASE_H
+
+#include <vector>
+#include <stdint.h>
+#include "point.h"
+
+/**
+ * \brief Exclusive short-term claims on square tiles of the map.
+ *
+ * Before an agent runs in parallel it leases every tile its footprint
+ * touches; two agents holding leases at the same time can therefore not
+ * read or write the same cells.  Callers serialize access themselves (the
+ * executive holds its scheduling lock), so there is no locking in here.
+ */
+class TileLeases
+{
+private:
+	int tile_size;
+	int x_tiles;
+	int y_tiles;
+	std::vector<uint8_t> held;
+
+	bool tileRange (Rect& r, int& tx1, int& ty1, int& tx2, int& ty2);
+
+public:
+	TileLeases ();
+
+	void allocate (int x_size, int y_size, int tile);
+
+	bool acquire (Rect& r);
+	void release (Rect& r);
+	bool anyHeld ();
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * \brief A timeline of one map generation, written as Chrome trace-event
+ * JSON for chrome://tracing or Perfetto.
+ *
+ * A context has one when -trace is given; Trace::Current() is NULL
+ * otherwise, so callers check for it and pay nothing when tracing is off.
+ * Spans (phases, agent slices) and instants (agents added and completed,
+ * the river phase released) are kept in memory under a lock and written
+ * when the map is done.  Threads appear as "thread n", numbered in the
+ * order they first record something.
+ */
+class Trace
+{
+private:
+	typedef struct
+	{
+		char phase;						// 'X' span, 'i' instant
+		const char *category;
+		std::string name;
+		uint64_t start;					// nanoseconds since the trace began
+		uint64_t duration;
+		int thread;
+		std::string args;				// a JSON object's members, or empty
+	} Event;
+
+	std::mutex lock;
+	std::vector<Event> events;
+	std::chrono::steady_clock::time_point started;
+
+	static int threadId ();
+
+public:
+	Trace ();
+
+	// the bound context's trace, or NULL when it is not tracing
+	static Trace *Current ();
+
+	// nanoseconds since the trace began
+	uint64_t now ();
+
+	// args, if given, are JSON members: "\"steps\": 3, \"tokens\": 12"
+	void span (const char *category, const std::string& name, uint64_t start, uint64_t end,
+		const std::string& args = "");
+	void instant (const char *category, const std::string& name, const std::string& args = "");
+
+	bool Write (const std::string& filename);
+
+	// a JSON string literal for s, quotes included
+	static std::string Quote (const std::string& s);
+};
+
+#endif
@@ -5,13 +5,14 @@
 #include "executive.h"
 #include "logger.h"
 #include <sstream>
+#include <algorithm>
 #include "params.h"
 
 #include "heightmap.h"	// for direction enum
 
 using namespace std;
 
-int MountainAgent::count = 0;
+std::atomic<int> MountainAgent::count (0);
 
 // ===================================================================
 // The MountainAgent runs around trying to raise mountain ranges.  These are
@@ -24,8 +25,7 @@ MountainAgent::MountainAgent (int _tokens)
 
 	type = MOUNTAIN_AGENT;
 
-	count++;
-	id = count;
+	id = ++count;
 
 	ostringstream buf;
 	buf << "Mountain Agent #" << id;
@@ -36,7 +36,7 @@ MountainAgent::MountainAgent (int _tokens)
 	initializing = true;
 	width = params.mountain_width;
 
-	base_direction = rand() % 8;
+	base_direction = rng.nextInt(8);
 	current_direction = base_direction;
 
 
@@ -55,18 +55,18 @@ bool MountainAgent::Execute ()
 
 	if ((tokens == 0) && runnable)
 	{
-//		Logger::Instance().Log ("%s finishing\n", name.c_str());
+//		LOG_DEBUG (LOG_AGENTS, "%s finishing\n", name.c_str());
 		int count = 0;
 
 #if SHOW_PEAKS
 		peaks.Reset_Iterator();
 		while (peaks.Iterate_Next(nextLocation))
 		{
-			Logger::Instance().Log (" (%d,%d) ", nextLocation.x, nextLocation.y);
+			LOG_TRACE (LOG_AGENTS, " (%d,%d) ", nextLocation.x, nextLocation.y);
 			if (count++ % 10 == 9)
-				Logger::Instance().Log ("\n");		
+				LOG_TRACE (LOG_AGENTS, "\n");		
 		}
-		Logger::Instance().Log ("\n");
+		LOG_TRACE (LOG_AGENTS, "\n");
 #endif
 		runnable = false;
 		return false;
@@ -84,7 +84,7 @@ bool MountainAgent::Execute ()
 
 			if (!Executive::Instance().random_land(location))
 			{
-				Logger::Instance().Log ("%s cannot be placed on land\n", name.c_str());
+				LOG_WARN (LOG_AGENTS, "%s cannot be placed on land\n", name.c_str());
 				return false;
 			}
 #if DISTANCE_CHECKS
@@ -92,14 +92,14 @@ bool MountainAgent::Execute ()
 		{
 			if (!Executive::Instance().random_land(location))
 			{
-				Logger::Instance().Log ("%s cannot be placed on land\n", name.c_str());
+				LOG_WARN (LOG_AGENTS, "%s cannot be placed on land\n", name.c_str());
 				return false;
 			}
 		} while (Executive::Instance().distanceToCoastline(location) < 3000);
 #endif
 
 		previous = location;
-		Logger::Instance().Log ("%s starting at (%d,%d), direction = %d\n", name.c_str(), location.x, location.y,
+		LOG_DEBUG (LOG_AGENTS, "%s starting at (%d,%d), direction = %d\n", name.c_str(), location.x, location.y,
 			base_direction);
 	}
 
@@ -107,12 +107,12 @@ bool MountainAgent::Execute ()
 
 	tokens--;
 
-	//Logger::Instance().Log ("%s working at %d,%d\n", name.c_str(), location.x, location.y);
+	//LOG_DEBUG (LOG_AGENTS, "%s working at %d,%d\n", name.c_str(), location.x, location.y);
 
 
 
-	int height = altitude + rand() % variance;
-	//Logger::Instance().Log ("%s setting height to %d\n", name.c_str(), height);
+	int height = altitude + rng.nextInt(variance);
+	//LOG_DEBUG (LOG_AGENTS, "%s setting height to %d\n", name.c_str(), height);
 
 
 	// Peaks is the set of mountain centerline points.  Altitude likely slopes away from these.
@@ -129,7 +129,7 @@ bool MountainAgent::Execute ()
 	// smoothing is needed to make the slices blend
 	// replacing this with a new roughener operation
 
-	if (rand() % 100 < params.mountain_smooth_prob)
+	if (rng.nextInt(100) < params.mountain_smooth_prob)
 	{
 		Executive::Instance().smoothArea(location);
 	}
@@ -156,7 +156,7 @@ bool MountainAgent::Execute ()
 
 		if (! Executive::Instance().StepDir(location, nextLocation, current_direction))
 		{
-			Logger::Instance().Log ("%s failed to perform random walk\n", name.c_str());
+			LOG_WARN (LOG_AGENTS, "%s failed to perform random walk\n", name.c_str());
 			misstep = true;
 		}
 		else if (! Executive::Instance().on_land(nextLocation))
@@ -166,7 +166,7 @@ bool MountainAgent::Execute ()
 		
 		if (misstep_count == 10)
 		{
-			Logger::Instance().Log ("%s has hit 10 missteps\n", name.c_str());
+			LOG_WARN (LOG_AGENTS, "%s has hit 10 missteps\n", name.c_str());
 			return false;
 		}
 
@@ -202,19 +202,46 @@ bool MountainAgent::Execute ()
 		changeDirection();	
 	}
 
-	 //Logger::Instance().Log ("%s advancing to %d,%d", name.c_str(), location.x, location.y);
+	 //LOG_DEBUG (LOG_AGENTS, "%s advancing to %d,%d", name.c_str(), location.x, location.y);
 	 //if (Executive::Instance().on_land(location))
 	 //{
-		// Logger::Instance().Log (" on-land\n");
+		// LOG_DEBUG (LOG_AGENTS, " on-land\n");
 	 //}
 	 //else
 	 //{
-		// Logger::Instance().Log (" NOT on land\n");
+		// LOG_DEBUG (LOG_AGENTS, " NOT on land\n");
 	 //}
 
 	return true;
 }
 
+// ===================================================================
+// The cells touched by the next few steps
+//
+// A slice reaches width/2 cells either side of the centerline, and a turn
+// first plows width/2 cells further along the old heading, so nothing
+// beyond width cells of the agent is touched; the smoother reads two more.
+// The agent moves at most one cell per step.  Placement on the first step
+// can land anywhere, so it is not bounded.
+// ===================================================================
+bool MountainAgent::footprint (int steps, Rect& area)
+{
+	if (initializing && (tokens > 0))
+	{
+		return false;
+	}
+
+	int reach = std::max (width, 0) + 4 + steps;
+	int x = location.x;
+	int y = location.y;
+
+	area.x1 = x - reach;
+	area.y1 = y - reach;
+	area.x2 = x + reach;
+	area.y2 = y + reach;
+	return true;
+}
+
 // ===================================================================
 // change the direction the mountain agent is moving
 //
@@ -227,7 +254,7 @@ void MountainAgent::changeDirection()
 {
 	if (current_direction == base_direction)
 	{
-		if (rand() % 2 == 1)
+		if (rng.nextInt(2) == 1)
 		{
 			++current_direction;
 		}
@@ -301,7 +328,7 @@ void MountainAgent::elevateSlice (Point& location, int altitude, int width)
 		// record the mountain base points
 		Point left, right;
 		elevateOp.getTailPoints(left, right);
-		int len = rand() % (params.foothill_max_length - params.foothill_min_length) + params.foothill_min_length;
+		int len = rng.nextInt(params.foothill_max_length - params.foothill_min_length) + params.foothill_min_length;
 
 		int leftDist = Executive::Instance().distanceSq(left, MapCenter);
 		int rightDist = Executive::Instance().distanceSq(right, MapCenter);
@@ -361,10 +388,10 @@ bool MountainAgent::randomPoint(Point& point, int minAltitude)
 		return true;
 	}
 
-	int pos = rand() % peaks.size();
+	int pos = Random::Current().nextInt(peaks.size());
 	if (! peaks.position(pos))
 	{
-		Logger::Instance().Log ("unable to position mountain iterator at %d\n", pos);
+		LOG_WARN (LOG_AGENTS, "unable to position mountain iterator at %d\n", pos);
 		exit (1);
 	}
 
@@ -386,7 +413,7 @@ bool MountainAgent::randomBase (Point& base, Point& center)
 	PointPair p;
 	vector<PointPair>::iterator i = basePoints.begin();
 
-	int pos = rand() % basePoints.size();
+	int pos = Random::Current().nextInt(basePoints.size());
 	std::advance(i, pos);
 
 	base = i->base;
@@ -8,15 +8,14 @@
 
 using namespace std;
 
-int RiverAgent::count = 0;
+std::atomic<int> RiverAgent::count (0);
 
 RiverAgent::RiverAgent(int _tokens)
 {
 	type = RIVER_AGENT;
 	tokens = _tokens;
 
-	count++;
-	id = count;
+	id = ++count;
 
 	ostringstream buf;
 	buf << "River Agent #" << id;
@@ -26,7 +25,7 @@ RiverAgent::RiverAgent(int _tokens)
 	initializing = true;
 
 	width = 5;
-	base_direction = rand() % 8;
+	base_direction = rng.nextInt(8);
 	current_direction = base_direction;
 
 
@@ -52,13 +51,13 @@ bool RiverAgent::Execute ()
 		{
 			if (! findSuitableShorePoint (startPoint))
 			{
-				Logger::Instance().Log ("unable to find shoreline point\n");
+				LOG_WARN (LOG_AGENTS, "unable to find shoreline point\n");
 				exit (1);
 			}
 
 			if (! findSuitableMountainPoint (endPoint))
 			{
-				Logger::Instance().Log ("unable to find mountain point\n");
+				LOG_WARN (LOG_AGENTS, "unable to find mountain point\n");
 				exit(1);
 			}
 
@@ -66,7 +65,7 @@ bool RiverAgent::Execute ()
 			float d = (float) Executive::Instance().distanceSq(startPoint, endPoint);
 
 			dist = (int) sqrt(d);
-			Logger::Instance().Log ("river length = %d, sqr dist %f\n", dist, d);
+			LOG_DEBUG (LOG_AGENTS, "river length = %d, sqr dist %f\n", dist, d);
 			if (dist > params.min_river_length)
 			{
 				break;
@@ -85,7 +84,7 @@ bool RiverAgent::Execute ()
 
 		if (path.size() < (unsigned int) params.min_river_length)
 		{
-			Logger::Instance().Log ("reject candidate river with %d points\n\n", path.size());
+			LOG_DEBUG (LOG_AGENTS, "reject candidate river with %d points\n\n", path.size());
 			continue;
 		}
 
@@ -108,7 +107,7 @@ bool RiverAgent::Execute ()
 
 void RiverAgent::buildLake (Point& p, int height)
 {
-	Logger::Instance().Log ("lake height will be %d\n", height);
+	LOG_DEBUG (LOG_AGENTS, "lake height will be %d\n", height);
 
 	PointSet blob;
 	PointSet border;
@@ -128,7 +127,7 @@ void RiverAgent::buildLake (Point& p, int height)
 				Executive::Instance().StepDir(src, adj, dir);
 				if (blob.in_set(adj))
 					continue;
-				Logger::Instance().Log("add %d,%d to lake blob\n", adj.x, adj.y);
+				LOG_TRACE (LOG_AGENTS, "add %d,%d to lake blob\n", adj.x, adj.y);
 				blob.insert(adj);
 				border.insert (adj);
 
@@ -207,14 +206,14 @@ void RiverAgent::calculatePath (Point& startPoint, Point& endPoint, PointList& p
 	path.push_back (location);
 	Executive::Instance().StepDir(location, location, current_direction);
 
-	//Logger::Instance().Log ("calculate path from %d,%d to %d,%d, base direction is %d\n",
+	//LOG_DEBUG (LOG_AGENTS, "calculate path from %d,%d to %d,%d, base direction is %d\n",
 	//	startPoint.x, startPoint.y, endPoint.x, endPoint.y, current_direction);
 
 	while (location != endPoint)
 	{
 		if (! Executive::Instance().onMap(location))
 		{
-			//Logger::Instance().Log ("path build stopped due to running off the map\n");
+			//LOG_DEBUG (LOG_AGENTS, "path build stopped due to running off the map\n");
 			path.clear();
 			break;
 		}
@@ -223,14 +222,14 @@ void RiverAgent::calculatePath (Point& startPoint, Point& endPoint, PointList& p
 		int height = Executive::Instance().getHeight(location);
 		if (height > params.river_heightlimit)
 		{
-			//Logger::Instance().Log ("path build stopped due to excess height %d\n", height);
+			//LOG_DEBUG (LOG_AGENTS, "path build stopped due to excess height %d\n", height);
 			break;
 		}
 
 		// don't allow coast to coast rivers
 		if (Executive::Instance().inOcean(location))
 		{
-			//Logger::Instance().Log ("path stopped at coastline (%d,%d)\n", location.x, location.y);
+			//LOG_DEBUG (LOG_AGENTS, "path stopped at coastline (%d,%d)\n", location.x, location.y);
 			path.clear();
 			break;
 		}
@@ -241,7 +240,7 @@ void RiverAgent::calculatePath (Point& startPoint, Point& endPoint, PointList& p
 		current_direction = newDir;
 		path.push_back (location);
 
-	//	Logger::Instance().Log ("%s: moving upstream to (%d,%d)\n", name.c_str(), location.x, location.y);
+	//	LOG_DEBUG (LOG_AGENTS, "%s: moving upstream to (%d,%d)\n", name.c_str(), location.x, location.y);
 	}
 }
 
@@ -263,7 +262,7 @@ void RiverAgent::advancePath ()
 	current_direction = newDir;
 	path.push_back (location);
 
-//	Logger::Instance().Log ("%s: moving upstream to (%d,%d)\n", name.c_str(), location.x, location.y);
+//	LOG_DEBUG (LOG_AGENTS, "%s: moving upstream to (%d,%d)\n", name.c_str(), location.x, location.y);
 }
 
 void RiverAgent::buildRiverSegment(PointList& path)
@@ -282,7 +281,7 @@ void RiverAgent::buildRiverSegment(PointList& path)
 		if (path.size() % params.river_widen_freq == (params.river_widen_freq - 1))
 		{
 			width++;
-			//Logger::Instance().Log ("increase width to %d\n", width);
+			//LOG_DEBUG (LOG_AGENTS, "increase width to %d\n", width);
 		}
 
 		buildRiver (p, width);
@@ -292,7 +291,7 @@ void RiverAgent::buildRiverSegment(PointList& path)
 void RiverAgent::buildRiver (Point& location, int width)
 {
 	Params& params = Params::Instance();
-	//Logger::Instance().Log ("building downstream at (%d,%d)\n", location.x, location.y);
+	//LOG_DEBUG (LOG_AGENTS, "building downstream at (%d,%d)\n", location.x, location.y);
 
 	int height = Executive::Instance().getHeight(location);
 	height = min (height, prev_height);
@@ -309,16 +308,16 @@ void RiverAgent::buildRiver (Point& location, int width)
 	//int random_width = width + rand() % 3 - 1;
 	int random_width = width;
 
-	//Logger::Instance().Log ("preparing altitudeOp to set height to %d\n", height);
+	//LOG_DEBUG (LOG_AGENTS, "preparing altitudeOp to set height to %d\n", height);
 
-	//Logger::Instance().Log ("widening riverbed at (%d,%d), previous point (%d,%d), dir = %d, prev_dir = %d\n",
+	//LOG_DEBUG (LOG_AGENTS, "widening riverbed at (%d,%d), previous point (%d,%d), dir = %d, prev_dir = %d\n",
 	//	location.x, location.y, previous.x, previous.y, current_direction, prev_dir);
 
 	WidenerOp widenerOp(altitudeOp, random_width, current_direction, false);
 	widenerOp.setPrevious(previous, prev_dir);
 	Executive::Instance().operatePoint(location, widenerOp);
 
-	//Logger::Instance().Log ("texturing riverbed\n");
+	//LOG_DEBUG (LOG_AGENTS, "texturing riverbed\n");
 
 	WidenerOp textureRiver(textureOp, random_width, current_direction, false);
 	textureRiver.setPrevious(previous, prev_dir);
@@ -343,15 +342,15 @@ void RiverAgent::saveMergePoints(PointList& path)
 	int length = path.size();
 	int tribs = length / 100;
 
-	//Logger::Instance().Log ("%d points in river, %d tributaries\n", length, tribs);
+	//LOG_DEBUG (LOG_AGENTS, "%d points in river, %d tributaries\n", length, tribs);
 
 	mergePoints.clear();
 
 	for (int i = 0; i < tribs; i++)
 	{
-		int index = rand() % length;
+		int index = rng.nextInt(length);
 		mergePoints.push_back(path[index]);
-		Logger::Instance().Log ("merge tributary at %d,%d\n", mergePoints[i].x, mergePoints[i].y);
+		LOG_DEBUG (LOG_AGENTS, "merge tributary at %d,%d\n", mergePoints[i].x, mergePoints[i].y);
 	}
 }
 
@@ -365,7 +364,7 @@ void RiverAgent::changeDirection()
 {
 	if (current_direction == base_direction)
 	{
-		if (rand() % 2 == 1)
+		if (rng.nextInt(2) == 1)
 		{
 			++current_direction;
 		}
@@ -423,7 +422,7 @@ int RiverAgent::bestDirection (Point& current)
 		{
 			highest_ahead = h2;
 			best_dir = dir;
-	//	Logger::Instance().Log ("change direction to %d, base is %d, offset = %d\n", best_dir, base_direction, dir_offset);
+	//	LOG_DEBUG (LOG_AGENTS, "change direction to %d, base is %d, offset = %d\n", best_dir, base_direction, dir_offset);
 		}
 	}
 #endif
@@ -474,7 +473,7 @@ bool RiverAgent::findSuitableMountainPoint(Point& p)
 			{
 				p = mountain;
 				int height = Executive::Instance().getHeight(mountain);
-				//Logger::Instance().Log ("returning mountain point (%d,%d) at elevation %d\n",
+				//LOG_DEBUG (LOG_AGENTS, "returning mountain point (%d,%d) at elevation %d\n",
 				//	mountain.x, mountain.y, height);
 				return true;
 			}
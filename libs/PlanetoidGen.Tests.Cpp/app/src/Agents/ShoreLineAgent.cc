@@ -7,7 +7,7 @@
 
 using namespace std;
 
-int ShoreLineAgent::count = 0;
+std::atomic<int> ShoreLineAgent::count (0);
 
 ShoreLineAgent::ShoreLineAgent(int _tokens)
 {
@@ -15,8 +15,7 @@ ShoreLineAgent::ShoreLineAgent(int _tokens)
 	tokens = _tokens;
 	runnable = true;
 
-	count++;
-	id = count;
+	id = ++count;
 
 	ostringstream buf;
 	buf << "ShoreLine Agent #" << id;
@@ -24,11 +23,11 @@ ShoreLineAgent::ShoreLineAgent(int _tokens)
 
 	if (!Executive::Instance().random_boundary(location))
 	{
-		Logger::Instance().Log ("%s cannot be placed on the shore\n", name.c_str());
+		LOG_WARN (LOG_AGENTS, "%s cannot be placed on the shore\n", name.c_str());
 		tokens = 0;		// stop agent from running
 	}
 
-	Logger::Instance().Log ("creating %s\n", name.c_str());
+	LOG_DEBUG (LOG_AGENTS, "creating %s\n", name.c_str());
 }
 
 // ===================================================================
@@ -51,12 +50,12 @@ bool ShoreLineAgent::Execute ()
 	{
 		if (!Executive::Instance().random_boundary(location))
 		{
-			Logger::Instance().Log ("%s cannot be placed on the shore\n", name.c_str());
+			LOG_WARN (LOG_AGENTS, "%s cannot be placed on the shore\n", name.c_str());
 			tokens = 0;		// stop agent from running
 		}
 		//else
 		//{
-		//	Logger::Instance().Log ("%s trying to avoid running through mountain\n", name.c_str());
+		//	LOG_DEBUG (LOG_AGENTS, "%s trying to avoid running through mountain\n", name.c_str());
 
 		//}
 	}
@@ -88,16 +87,16 @@ bool ShoreLineAgent::Execute ()
 	{
 		if (!Executive::Instance().random_boundary(location))
 		{
-			Logger::Instance().Log ("%s cannot be placed on the shore\n", name.c_str());
+			LOG_WARN (LOG_AGENTS, "%s cannot be placed on the shore\n", name.c_str());
 			tokens = 0;		// stop agent from running
 		}
 		else
 		{
-			//Logger::Instance().Log ("%s jumping to new area %d,%d\n", name.c_str(), location.x, location.y);
+			//LOG_DEBUG (LOG_AGENTS, "%s jumping to new area %d,%d\n", name.c_str(), location.x, location.y);
 		}
 	}
 
-//	Logger::Instance().Log ("%s moving to %d,%d\n", name.c_str(), location.x, location.y);
+//	LOG_DEBUG (LOG_AGENTS, "%s moving to %d,%d\n", name.c_str(), location.x, location.y);
 	return true;
 }
 
@@ -105,7 +104,7 @@ bool ShoreLineAgent::adjacentShore(Point &p)
 {
 	Point neighbor;
 
-	int dir = rand() % 8;
+	int dir = rng.nextInt(8);
 
 	for (int i = 0; i < 8; i++)
 	{
@@ -128,7 +127,7 @@ void ShoreLineAgent::miniWalk (Point& location)
 {
 	Params& params = Params::Instance();
 	Point current(location);
-	int walk_size = rand() % params.beach_walk_variance + params.beach_walk_min;
+	int walk_size = rng.nextInt(params.beach_walk_variance) + params.beach_walk_min;
 
 	TextureOp textureOp(TEXTURE_SAND);
 	SetHeightOp altitudeOp (params.beach_min_alt, params.beach_max_alt);
@@ -153,11 +152,11 @@ void ShoreLineAgent::miniWalk (Point& location)
 			}
 			else
 			{
-	//			Logger::Instance().Log ("%s: could not find interior point\n", name.c_str());
+	//			LOG_DEBUG (LOG_AGENTS, "%s: could not find interior point\n", name.c_str());
 			}
 		}
 
-		int dir = rand() % 8;
+		int dir = rng.nextInt(8);
 		Executive::Instance().StepDir (current, current, dir, params.beach_interior_distance);
 	}
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
 
 using namespace std;
 
-int SmoothAgent::count = 0;
+std::atomic<int> SmoothAgent::count (0);
 
 SmoothAgent::SmoothAgent(int _tokens)
 {
@@ -25,8 +25,7 @@ SmoothAgent::SmoothAgent(int _tokens)
 	use_smoother = false;
 	randomWalk = true;
 
-	count++;
-	id = count;
+	id = ++count;
 
 	ostringstream buf;
 	buf << "Smooth Agent #" << id;
@@ -34,7 +33,7 @@ SmoothAgent::SmoothAgent(int _tokens)
 
 	if (!Executive::Instance().random_land(location))
 	{
-		Logger::Instance().Log ("%s cannot be placed on land\n", name.c_str());
+		LOG_WARN (LOG_AGENTS, "%s cannot be placed on land\n", name.c_str());
 		location.x = 0;
 		location.y = 0;
 	}
@@ -42,7 +41,7 @@ SmoothAgent::SmoothAgent(int _tokens)
 	{
 		unsigned long height = Executive::Instance().getHeight(location);
 
-	//	Logger::Instance().Log ("%s starting at (%d,%d), altitude %d\n", name.c_str(), location.x, location.y, height);
+	//	LOG_DEBUG (LOG_AGENTS, "%s starting at (%d,%d), altitude %d\n", name.c_str(), location.x, location.y, height);
 	}
 
 	smoother.setOverride(false);
@@ -65,7 +64,7 @@ bool SmoothAgent::Execute ()
 
 	if (tokens == 0)
 	{
-	//	Logger::Instance().Log ("%s stopping\n", name.c_str());
+	//	LOG_DEBUG (LOG_AGENTS, "%s stopping\n", name.c_str());
 		return false;
 	}
 
@@ -75,7 +74,7 @@ bool SmoothAgent::Execute ()
 	{
 		if (Executive::Instance().isWatched(location))
 		{
-			Logger::Instance().Log ("%s operating on a watch point\n", name.c_str(), location.x, location.y);
+			LOG_DEBUG (LOG_AGENTS, "%s operating on a watch point\n", name.c_str(), location.x, location.y);
 		}
 
 		if (use_smoother)
@@ -102,6 +101,51 @@ bool SmoothAgent::Execute ()
 	return true;
 }
 
+// ===================================================================
+// The cells touched by the next few steps
+//
+// Smoothing a point reads two cells either side of it.  Sweeps move one
+// cell to the right per step and wrap to the start of the row; random
+// walks move at most one cell in any direction, unless they are about to
+// return to their starting point.
+// ===================================================================
+bool SmoothAgent::footprint (int steps, Rect& area)
+{
+	Params& params = Params::Instance();
+	const int reach = 2;
+	int x = location.x;
+	int y = location.y;
+
+	if (randomWalk)
+	{
+		int remaining = tokens;
+
+		if ((remaining >= reset_tokens) && (remaining - steps < reset_tokens))
+		{
+			return false;
+		}
+
+		area.x1 = x - steps - reach;
+		area.y1 = y - steps - reach;
+		area.x2 = x + steps + reach;
+		area.y2 = y + steps + reach;
+		return true;
+	}
+
+	area.x1 = x - reach;
+	area.x2 = x + steps + reach;
+	area.y1 = y - reach;
+	area.y2 = y + reach;
+
+	if (area.x2 - reach >= params.x_size)
+	{
+		area.x1 = 0;
+		area.x2 = params.x_size - 1;
+	}
+
+	return true;
+}
+
 // ===================================================================
 // calculate a weighted average of nearby points
 // ===================================================================
@@ -0,0 +1,53 @@
+#include "SweepSmoothAgent.h"
+#include "executive.h"
+#include "smoothkernel.h"
+#include "logger.h"
+#include "params.h"
+#include <sstream>
+
+using namespace std;
+
+std::atomic<int> SweepSmoothAgent::count (0);
+
+SweepSmoothAgent::SweepSmoothAgent (int passes)
+{
+	Params& params = Params::Instance();
+
+	type = SMOOTH_AGENT;
+	bands = (params.y_size + BAND - 1) / BAND;
+	tokens = passes * bands;
+	row = 0;
+	runnable = true;
+
+	id = ++count;
+
+	ostringstream buf;
+	buf << "Sweep Smooth Agent #" << id;
+	name = buf.str();
+}
+
+// ===================================================================
+// Execute one timestep -- smooth the next band of rows
+// ===================================================================
+bool SweepSmoothAgent::Execute ()
+{
+	Executive& exec = Executive::Instance();
+
+	if (tokens == 0)
+	{
+		return false;
+	}
+
+	tokens--;
+
+	SmoothKernel kernel (exec.heightmap(), exec.cellFlags());
+	kernel.sweepRowsParallel (row, row + BAND);
+
+	row += BAND;
+	if (row >= Params::Instance().y_size)
+	{
+		row = 0;
+	}
+
+	return true;
+}
@@ -50,7 +50,7 @@ void ErosionAgent::addNode(Point &p, TreeNode &node)
 {
 	int index = indexOf(p);
 
-	Logger::Instance().Log ("point %d,%d has index %d\n", p.x, p.y, index);
+	LOG_TRACE (LOG_WATER, "point %d,%d has index %d\n", p.x, p.y, index);
 }
 
 int ErosionAgent::indexOf(int x, int y)
@@ -83,12 +83,12 @@ void ErosionAgent::pointOf(int id, Point& p)
 
 bool ErosionAgent::Execute()
 {
-	Logger::Instance().Log ("starting spanning forests at %s\n", Executive::Instance().currentTime().c_str());
+	LOG_INFO (LOG_WATER, "starting spanning forests at %s\n", Executive::Instance().currentTime().c_str());
 	buildSpanningForests ();
-	Logger::Instance().Log ("starting flowing water at %s\n", Executive::Instance().currentTime().c_str());
+	LOG_INFO (LOG_WATER, "starting flowing water at %s\n", Executive::Instance().currentTime().c_str());
 
 	flowWater ();
-	Logger::Instance().Log ("ending at %s\n", Executive::Instance().currentTime().c_str());
+	LOG_INFO (LOG_WATER, "ending at %s\n", Executive::Instance().currentTime().c_str());
 
 	return false;
 #if 0
@@ -122,8 +122,8 @@ bool ErosionAgent::Execute()
 
 			Point current;
 			pointOf(flowPosition, current);
-			Logger::Instance().Log ("\n\n");
-			Logger::Instance().Log ("water flow starting at %d (%d,%d)\n", flowPosition, current.x, current.y);
+			LOG_DEBUG (LOG_WATER, "\n\n");
+			LOG_DEBUG (LOG_WATER, "water flow starting at %d (%d,%d)\n", flowPosition, current.x, current.y);
 
 
 			currentRoot = flowPosition;						// identify the spanning tree by its root
@@ -155,7 +155,7 @@ void ErosionAgent::buildSpanningForests()
 	std::sort (sortedForest.begin(), sortedForest.end());
 	std::vector<TreeNode>::iterator iter;
 	
-	Logger::Instance().Log ("===========================================================\n");
+	LOG_DEBUG (LOG_WATER, "===========================================================\n");
 
 	for (iter = sortedForest.begin(); iter != sortedForest.end(); ++iter)
 	{
@@ -171,27 +171,27 @@ void ErosionAgent::buildSpanningForests()
 			break;
 
 		flow = forest[index].getOutflow();
-	//	Logger::Instance().Log ("finding gradient from (%d,%d) altitude %d, flow in %d\n", location.x, location.y, height, flow);
+	//	LOG_DEBUG (LOG_WATER, "finding gradient from (%d,%d) altitude %d, flow in %d\n", location.x, location.y, height, flow);
 
 		visited.insert(location.x, location.y);
 		Point next;
 		if (! findLowestNotInPath (location, next))
 		{
-			Logger::Instance().Log ("start lake at (%d,%d)\n", location.x, location.y);
+			LOG_DEBUG (LOG_WATER, "start lake at (%d,%d)\n", location.x, location.y);
 			int id = startLake(location, next);
-			Logger::Instance().Log ("lake %d is fed from (%d,%d)\n", id, next.x, next.y);
+			LOG_DEBUG (LOG_WATER, "lake %d is fed from (%d,%d)\n", id, next.x, next.y);
 			lakes[id].displayLake();
 			printHeightmap ();
 			if (! Executive::Instance().onMap(next))
 			{
-				Logger::Instance().Log ("lake flows off of the map\n");
+				LOG_DEBUG (LOG_WATER, "lake flows off of the map\n");
 				continue;
 			}
 		}
 
 		if (! Executive::Instance().onMap(next))
 		{
-			Logger::Instance().Log ("river flows off of the map\n");
+			LOG_DEBUG (LOG_WATER, "river flows off of the map\n");
 			continue;
 		}
 
@@ -211,7 +211,7 @@ void ErosionAgent::buildSpanningForests()
 		}
 
 		forest[nextIndex].addInflow(flow);
-//		Logger::Instance().Log ("adding %d to flow into (%d,%d)\n", flow, next.x, next.y);
+//		LOG_DEBUG (LOG_WATER, "adding %d to flow into (%d,%d)\n", flow, next.x, next.y);
 
 		forest[index].downstream = next;
 
@@ -228,7 +228,7 @@ void ErosionAgent::buildSpanningForests()
 			if (!Executive::Instance().on_land(location))
 			{
 				ocean++;
-			//	Logger::Instance().Log ("(%d,%d) not on land\n", i, j);
+			//	LOG_DEBUG (LOG_WATER, "(%d,%d) not on land\n", i, j);
 				continue;
 			}
 
@@ -236,22 +236,21 @@ void ErosionAgent::buildSpanningForests()
 			flow = forest[index].getOutflow();
 			Point downstream = forest[index].downstream;
 
-			int nextFlow = flowAt(downstream);
-			Logger::Instance().Log ("(%d,%d) sending %d water to (%d,%d), which has %d\n", i, j, flow, 
-				downstream.x, downstream.y, nextFlow);
+			LOG_TRACE (LOG_WATER, "(%d,%d) sending %d water to (%d,%d), which has %d\n", i, j, flow, 
+				downstream.x, downstream.y, flowAt(downstream));
 			total += flow;
 		}
 	}
 
 	// total can be larger than the number of vertices, since a single unit of water counts in each point downstream
-	Logger::Instance().Log ("moved a total of %d water, %d water areas did not contribute \n", total, ocean);
+	LOG_DEBUG (LOG_WATER, "moved a total of %d water, %d water areas did not contribute \n", total, ocean);
 
 #if 0
 	Point location(current_x, current_y);
 	int currentIndex = indexOf (current_x, current_y);
 
 	int height = Executive::Instance().getHeight(location);
-	Logger::Instance().Log ("point %d,%d has height %d\n", current_x, current_y, height);
+	LOG_TRACE (LOG_WATER, "point %d,%d has height %d\n", current_x, current_y, height);
 
 	int slope;
 	Point p;
@@ -260,7 +259,7 @@ void ErosionAgent::buildSpanningForests()
 	Executive::Instance().findGradient(GRAD_MINIMUM,location, p, slope);
 
 	int h2 = Executive::Instance().getHeight(p);
-	Logger::Instance().Log ("  lowest neighbor is (%d,%d), height = %d, slope %d\n", p.x, p.y, h2, slope);
+	LOG_TRACE (LOG_WATER, "  lowest neighbor is (%d,%d), height = %d, slope %d\n", p.x, p.y, h2, slope);
 
 	// the amount of water flowing out of this point, minimum = 1 (at mountain peaks)
 	int outflow = forest[currentIndex].getOutflow();
@@ -297,7 +296,7 @@ bool ErosionAgent::downstreamPoint (Point& src, Point& downstream)
 		return true;
 	}
 
-	Logger::Instance().Log ("point (%d,%d) directs flow to (%d,%d) which is off the map\n",
+	LOG_DEBUG (LOG_WATER, "point (%d,%d) directs flow to (%d,%d) which is off the map\n",
 		src.x, src.y, p.x, p.y);
 	return false;
 }
@@ -347,11 +346,11 @@ int ErosionAgent::startLake (Point& p, Point& inflow)
 	int height = Executive::Instance().getHeight(p);
 
 	int id = lakes.size();
-	Logger::Instance().Log ("starting lake %d at (%d,%d) height %d\n", id, p.x, p.y, height);
+	LOG_DEBUG (LOG_WATER, "starting lake %d at (%d,%d) height %d\n", id, p.x, p.y, height);
 
 	Lake newLake(id);
 	lakes.push_back(newLake);
-	Logger::Instance().Log ("%d lakes defined\n", lakes.size());
+	LOG_DEBUG (LOG_WATER, "%d lakes defined\n", lakes.size());
 
 	//printHeightmap ();
 
@@ -360,7 +359,7 @@ int ErosionAgent::startLake (Point& p, Point& inflow)
 	lowest = p;
 	while (1)
 	{
-		Logger::Instance().Log ("add point %d,%d to lake set\n", lowest.x, lowest.y);
+		LOG_TRACE (LOG_WATER, "add point %d,%d to lake set\n", lowest.x, lowest.y);
 
 		// pass along the flow into p
 		Point p;
@@ -368,13 +367,13 @@ int ErosionAgent::startLake (Point& p, Point& inflow)
 
 		if (highestInflowNeighbor(id, lowest, p))
 		{
-			int flow = flowAt(p);
-			Logger::Instance().Log ("highest inflow into (%d,%d) is %d through %d,%d\n",
+			flow = flowAt(p);
+			LOG_TRACE (LOG_WATER, "highest inflow into (%d,%d) is %d through %d,%d\n",
 				lowest.x, lowest.y, flow, p.x, p.y);
 		}
 		else
 		{
-			Logger::Instance().Log ("unable to find the inflow into point (%d,%d)\n", lowest.x, lowest.y);
+			LOG_WARN (LOG_WATER, "unable to find the inflow into point (%d,%d)\n", lowest.x, lowest.y);
 			flow = 0;
 		}
 
@@ -387,31 +386,31 @@ int ErosionAgent::startLake (Point& p, Point& inflow)
 		{
 			if (! Executive::Instance().onMap(downstream))
 			{
-				Logger::Instance().Log ("lake %d empties off the map\n", id);
+				LOG_DEBUG (LOG_WATER, "lake %d empties off the map\n", id);
 				inflow = downstream;
 				return id;
 			}
 
-			Logger::Instance().Log ("possible overflow point at (%d,%d)\n", downstream.x, downstream.y);
+			LOG_DEBUG (LOG_WATER, "possible overflow point at (%d,%d)\n", downstream.x, downstream.y);
 			// by definition the point "downstream" is not currently in the lake.  However we need to
 			// check if it is currently flowing into a lake point (and therefore needs to be added)
 
 			Point nextPoint;		// where the downstream point is flowing
 			if (downstreamPoint(downstream, nextPoint))
 			{
-				Logger::Instance().Log ("lake %d considers overflowing towards(%d,%d)\n", id, nextPoint.x,
+				LOG_DEBUG (LOG_WATER, "lake %d considers overflowing towards(%d,%d)\n", id, nextPoint.x,
 					nextPoint.y);
 				int height = Executive::Instance().getHeight(downstream);
 
 				// a point was found
 				if (! lakes[id].inLake(nextPoint))
 				{
-					Logger::Instance().Log ("lake %d empties out of %d,%d to %d,%d\n",
+					LOG_DEBUG (LOG_WATER, "lake %d empties out of %d,%d to %d,%d\n",
 						id, downstream.x, downstream.y, nextPoint.x, nextPoint.y);
 					lakes[id].setOutflowPoint(nextPoint);
 					if (! lakes[id].getInflowPoint(inflow))
 					{
-						Logger::Instance().Log ("unknown inflow point for this lake\n");
+						LOG_WARN (LOG_WATER, "unknown inflow point for this lake\n");
 					}
 					
 					lakes[id].raiseLake(height);
@@ -423,12 +422,12 @@ int ErosionAgent::startLake (Point& p, Point& inflow)
 				}
 				else
 				{
-					Logger::Instance().Log ("this point appears to be inside the lake\n");
+					LOG_DEBUG (LOG_WATER, "this point appears to be inside the lake\n");
 				}
 
 				// the downstream point also empties into the lake
 				lowest = downstream;
-				Logger::Instance().Log ("point %d,%d empties into the lake\n", lowest.x, lowest.y);
+				LOG_TRACE (LOG_WATER, "point %d,%d empties into the lake\n", lowest.x, lowest.y);
 			//	printHeightmap ();
 			}
 			else
@@ -437,22 +436,22 @@ int ErosionAgent::startLake (Point& p, Point& inflow)
 				lakes[id].raiseLake(height);
 				if (! lakes[id].getInflowPoint(inflow))
 				{
-					Logger::Instance().Log ("unknown inflow point for this lake\n");
+					LOG_WARN (LOG_WATER, "unknown inflow point for this lake\n");
 				}
 				setLakeDownstream (id, downstream);
 				setLakeUpstream (id, inflow);
-				Logger::Instance().Log ("(%d,%d) flows off the map\n", downstream.x, downstream.y);
+				LOG_DEBUG (LOG_WATER, "(%d,%d) flows off the map\n", downstream.x, downstream.y);
 				return id;
 			}
 		}
 		else
 		{
-			Logger::Instance().Log ("no lowestShorePoint found\n");
+			LOG_WARN (LOG_WATER, "no lowestShorePoint found\n");
 			return id;
 		}
 	}
 
-	Logger::Instance().Log ("lake %d may be growing without bound\n", id);
+	LOG_WARN (LOG_WATER, "lake %d may be growing without bound\n", id);
 	return id;
 }
 
@@ -496,9 +495,9 @@ void ErosionAgent::printHeightmap ()
 			Point p(i,j);
 			int height = Executive::Instance().getHeight(p);
 
-			Logger::Instance().Log ("%05d ", height);
+			LOG_DEBUG (LOG_WATER, "%05d ", height);
 		}
-		Logger::Instance().Log ("\n");
+		LOG_DEBUG (LOG_WATER, "\n");
 	}
 }
 
@@ -529,13 +528,13 @@ void ErosionAgent::flowWater ()
 		}
 
 		visited.insert(p);
-	//	Logger::Instance().Log ("insert (%d,%d) into visited set\n", p.x, p.y);
+	//	LOG_DEBUG (LOG_WATER, "insert (%d,%d) into visited set\n", p.x, p.y);
 
 		if (flow > minimum_flow)
 		{
-			Logger::Instance().Log ("river ends at (%d,%d) flow %d\n", p.x, p.y, flow);
+			LOG_DEBUG (LOG_WATER, "river ends at (%d,%d) flow %d\n", p.x, p.y, flow);
 			Point outflow = node.downstream;
-			Logger::Instance().Log ("outflow to (%d,%d)\n", outflow.x, outflow.y);
+			LOG_DEBUG (LOG_WATER, "outflow to (%d,%d)\n", outflow.x, outflow.y);
 		}
 		else
 		{
@@ -547,14 +546,14 @@ void ErosionAgent::flowWater ()
 			p = node.upstream;
 			if (p.x == -1)
 				break;
-			Logger::Instance().Log ("flow at %d,%d is %d\n", p.x, p.y, flow);
+			LOG_TRACE (LOG_WATER, "flow at %d,%d is %d\n", p.x, p.y, flow);
 
 			if (visited.in_set(p.x, p.y))
 			{
 				break;
 			}
 
-	//		Logger::Instance().Log ("visited set: ");
+	//		LOG_DEBUG (LOG_WATER, "visited set: ");
 		//	visited.printSet();
 
 			int id = indexOf(p);
@@ -564,7 +563,7 @@ void ErosionAgent::flowWater ()
 			if (flow < minimum_flow)
 				continue;
 
-		//	Logger::Instance().Log ("inserting (%d,%d) into visited set\n", p.x, p.y);
+		//	LOG_DEBUG (LOG_WATER, "inserting (%d,%d) into visited set\n", p.x, p.y);
 			visited.insert (p);
 
 			int width = (flow/2) + 1;
@@ -581,8 +580,8 @@ void ErosionAgent::flowWater ()
 
 	
 		}
-		Logger::Instance().Log ("river starts at (%d,%d)\n", p.x, p.y);
-		Logger::Instance().Log ("========\n");
+		LOG_DEBUG (LOG_WATER, "river starts at (%d,%d)\n", p.x, p.y);
+		LOG_DEBUG (LOG_WATER, "========\n");
 	}
 #if 0
 	for (int i = 0; i < params.x_size; i++)
@@ -632,27 +631,27 @@ int ErosionAgent::waterFlow(int id)
 
 	if (! Executive::Instance().on_land(current))
 	{
-	//	Logger::Instance().Log ("stopping water flow at (%d,%d) since we reached water\n", current.x, current.y);
+	//	LOG_DEBUG (LOG_WATER, "stopping water flow at (%d,%d) since we reached water\n", current.x, current.y);
 		return -1;
 	}
 
 	Point testpoint(1,2);
 	int testHeight = Executive::Instance().getHeight(testpoint);
-//	Logger::Instance().Log ("test point height (1,2) is %d\n", testHeight);
+//	LOG_DEBUG (LOG_WATER, "test point height (1,2) is %d\n", testHeight);
 
 	// note: this does not use the spanning forest calculated earlier
 	// find a lower unvisited point, or stop the water flow here
 	if (! findLowestNotInPath (current, lower))
 	{
-		//Logger::Instance().Log ("no lower node found not in path, from (%d,%d)\n", current.x, current.y);
-		//Logger::Instance().Log ("Path: ");
+		//LOG_DEBUG (LOG_WATER, "no lower node found not in path, from (%d,%d)\n", current.x, current.y);
+		//LOG_DEBUG (LOG_WATER, "Path: ");
 		//std::set<int>::iterator iter;
 
 		//for (iter = currentPath.begin(); iter != currentPath.end(); ++iter)
 		//{
-		//	Logger::Instance().Log ("%d, ", *iter);
+		//	LOG_DEBUG (LOG_WATER, "%d, ", *iter);
 		//}
-		//Logger::Instance().Log ("\n");
+		//LOG_DEBUG (LOG_WATER, "\n");
 
 		return -1;
 	}
@@ -672,17 +671,17 @@ int ErosionAgent::waterFlow(int id)
 
 	if ((currentHeight > h2) && (Executive::Instance().on_land(lower)))
 	{
-		//Logger::Instance().Log ("moving %d water from node %d (%d,%d) to node %d (%d,%d), child moving %d water\n", inflow, id, 
+		//LOG_DEBUG (LOG_WATER, "moving %d water from node %d (%d,%d) to node %d (%d,%d), child moving %d water\n", inflow, id, 
 		//	current.x, current.y, childId, lower.x, lower.y, childRate);
 		return childId;
 	}
 	else
 	{
-		//Logger::Instance().Log ("flow ends at child %d (%d,%d), current height = %d, best child %d\n",
+		//LOG_DEBUG (LOG_WATER, "flow ends at child %d (%d,%d), current height = %d, best child %d\n",
 		//	childId, lower.x, lower.y, currentHeight, h2);
 		//if (! Executive::Instance().on_land(lower))
 		//{
-		//	Logger::Instance().Log ("lower point is not on land\n");
+		//	LOG_DEBUG (LOG_WATER, "lower point is not on land\n");
 		//}
 		return -1;
 	}
@@ -692,7 +691,7 @@ int ErosionAgent::flowAt (Point& p)
 {
 	if (! Executive::Instance().onMap(p))
 	{
-		Logger::Instance().Log ("flow check for point %d,%d which is off of the map\n", p.x, p.y);
+		LOG_TRACE (LOG_WATER, "flow check for point %d,%d which is off of the map\n", p.x, p.y);
 		return 0;
 	} 
 
@@ -719,7 +718,7 @@ bool ErosionAgent::findLowestNotInPath (Point& current, Point& next)
 	int lowestHeight = 100000;
 	Point bestNeighbor;
 
-	//Logger::Instance().Log ("searching for next point, starting at (%d,%d)\n", current.x, current.y);
+	//LOG_DEBUG (LOG_WATER, "searching for next point, starting at (%d,%d)\n", current.x, current.y);
 
 	// check all neighboring points for something lower
 	for (int i = 0; i < 8; i++)
@@ -730,14 +729,14 @@ bool ErosionAgent::findLowestNotInPath (Point& current, Point& next)
 		// skip over points which are not on the map
 		if (! Executive::Instance().onMap(neighbor))
 		{
-	//		Logger::Instance().Log ("ignoring point (%d,%d) since it is off map\n", neighbor.x, neighbor.y);
+	//		LOG_DEBUG (LOG_WATER, "ignoring point (%d,%d) since it is off map\n", neighbor.x, neighbor.y);
 			continue;
 		}
 #endif
 		// skip over neighbors which we have visited
 		if (inPath(neighbor))
 		{
-	//		Logger::Instance().Log ("ignoring point (%d,%d) since it has been visited\n", neighbor.x, neighbor.y);
+	//		LOG_DEBUG (LOG_WATER, "ignoring point (%d,%d) since it has been visited\n", neighbor.x, neighbor.y);
 			continue;
 		}
 
@@ -749,7 +748,7 @@ bool ErosionAgent::findLowestNotInPath (Point& current, Point& next)
 			bestNeighbor = neighbor;
 		}
 
-		//Logger::Instance().Log ("consider (%d,%d) at height %d\n", neighbor.x, neighbor.y, neighborHeight);
+		//LOG_DEBUG (LOG_WATER, "consider (%d,%d) at height %d\n", neighbor.x, neighbor.y, neighborHeight);
 	}
 
 	if (lowestHeight < currentHeight)
@@ -803,7 +802,7 @@ void ErosionAgent::performTextureWalk ()
 
 void ErosionAgent::textureRiver (Point& location, int width)
 {
-	//Logger::Instance().Log ("building downstream at (%d,%d)\n", location.x, location.y);
+	//LOG_DEBUG (LOG_WATER, "building downstream at (%d,%d)\n", location.x, location.y);
 
 	int height = Executive::Instance().getHeight(location);
 	height = min (height, prev_height);
@@ -817,14 +816,14 @@ void ErosionAgent::textureRiver (Point& location, int width)
 	fixpointOp.setOverride(true);
 	textureOp.setOverride(true);
 
-	//Logger::Instance().Log ("preparing altitudeOp to set height to %d\n", height);
+	//LOG_DEBUG (LOG_WATER, "preparing altitudeOp to set height to %d\n", height);
 	WidenerOp widenerOp(altitudeOp, width, current_direction, false);
 	widenerOp.setPrevious(previous, prev_dir);
 	Executive::Instance().operatePoint(location, widenerOp);
 
-	//Logger::Instance().Log ("texturing riverbed\n");
+	//LOG_DEBUG (LOG_WATER, "texturing riverbed\n");
 
-	int random_width = width + rand() % 3 - 1;
+	int random_width = width + rng.nextInt(3) - 1;
 
 	WidenerOp textureRiver(textureOp, random_width, current_direction, false);
 	textureRiver.setPrevious(previous, prev_dir);
@@ -7,14 +7,13 @@
 
 using namespace std;
 
-int HillAgent::count = 0;
+std::atomic<int> HillAgent::count (0);
 
 HillAgent::HillAgent (int _tokens)
 {
 	type = HILL_AGENT;
 
-	count++;
-	id = count;
+	id = ++count;
 
 	ostringstream buf;
 	buf << "Hill Agent #" << id;
@@ -34,7 +33,7 @@ bool HillAgent::Execute ()
 {
 	if (tokens == 0)
 	{
-		Logger::Instance().Log ("%s finishing\n", name.c_str());
+		LOG_DEBUG (LOG_AGENTS, "%s finishing\n", name.c_str());
 		return false;
 	}
 
@@ -44,7 +43,7 @@ bool HillAgent::Execute ()
 		MountainAgent *mountain = Executive::Instance().randomMountainAgent();
 		if (! mountain)
 		{
-			Logger::Instance().Log ("%s: could not find a mountain agent\n", name.c_str());
+			LOG_WARN (LOG_AGENTS, "%s: could not find a mountain agent\n", name.c_str());
 			return false;
 		}
 	
@@ -52,7 +51,7 @@ bool HillAgent::Execute ()
 
 		if (! mountain->randomBase(location, center))
 		{
-			Logger::Instance().Log ("%s: could not find a base point for %s\n", name.c_str(),
+			LOG_WARN (LOG_AGENTS, "%s: could not find a base point for %s\n", name.c_str(),
 				mountain->getName().c_str());
 			return false;
 		}
@@ -75,7 +74,7 @@ bool HillAgent::Execute ()
 	Executive::Instance().setHeight(location, height);
 //	Executive::Instance().smoothPoint(location);
 
-	int dir = rand() % 8;
+	int dir = rng.nextInt(8);
 	Point p;
 	for (int i = 0; i < 8; i++)
 	{
@@ -89,6 +88,6 @@ bool HillAgent::Execute ()
 	}
 
 
-	Logger::Instance().Log ("%s cannot find an adjacent point on map\n", name.c_str());
+	LOG_WARN (LOG_AGENTS, "%s cannot find an adjacent point on map\n", name.c_str());
 	return false;
 }
\ No newline at end of file
@@ -19,9 +19,9 @@ void Lake::addPoint(Point& p, int flow)
 { 
 	if (points.in_set(p))
 	{
-		Logger::Instance().Log ("Attempt to add a point (%d,%d) to lake %d but is already in the lake\n",
+		LOG_WARN (LOG_WATER, "Attempt to add a point (%d,%d) to lake %d but is already in the lake\n",
 			p.x, p.y, id);
-		Logger::Instance().Log ("%d points in this lake\n", points.size());
+		LOG_WARN (LOG_WATER, "%d points in this lake\n", points.size());
 		return;
 	}
 
@@ -30,7 +30,7 @@ void Lake::addPoint(Point& p, int flow)
 	// new points which have non-lake neighbors are on the shore
 	if (! isSurrounded(p))
 	{
-		//Logger::Instance().Log ("adding (%d,%d) to lake %d's shoreline\n", p.x, p.y, id);
+		//LOG_DEBUG (LOG_WATER, "adding (%d,%d) to lake %d's shoreline\n", p.x, p.y, id);
 		shore.insert(p);
 		inflow += flow;
 
@@ -39,14 +39,14 @@ void Lake::addPoint(Point& p, int flow)
 			WaterNode node;
 			WaterModel::Instance().lookupNode(p, node);
 
-			//Logger::Instance().Log ("this is the max inflow point\n");
+			//LOG_DEBUG (LOG_WATER, "this is the max inflow point\n");
 			maxInflow = flow;
 			inflowPoint = p;
 		}
 	}
 	else
 	{
-		Logger::Instance().Log ("Lake::addPoint -- point (%d,%d) appears surrounded by other lake points\n",
+		LOG_WARN (LOG_WATER, "Lake::addPoint -- point (%d,%d) appears surrounded by other lake points\n",
 			p.x, p.y);
 	}
 }
@@ -109,7 +109,7 @@ bool Lake::lowestShorePoint(Point& lowPointAt)
 	int lowHeight = numeric_limits<int>::max();
 	Point lowPoint;
 
-	//Logger::Instance().Log ("attempt to find lowestShorePoint for lake %d, %d points in shore\n",
+	//LOG_DEBUG (LOG_WATER, "attempt to find lowestShorePoint for lake %d, %d points in shore\n",
 	//	id, shore.size());
 
 	shore.Reset_Iterator();
@@ -144,13 +144,13 @@ bool Lake::lowestShorePoint(Point& lowPointAt)
 		Point p = *iter;
 		shore.remove(p.x, p.y);
 
-		Logger::Instance().Log ("removing point (%d,%d) from shoreline set\n", p.x, p.y);
+		LOG_TRACE (LOG_WATER, "removing point (%d,%d) from shoreline set\n", p.x, p.y);
 	}
 
 
 	if (lowHeight < numeric_limits<int>::max())
 	{
-		//Logger::Instance().Log ("lowest shoreline height is %d at %d,%d\n", lowHeight, lowPoint.x, lowPoint.y);
+		//LOG_DEBUG (LOG_WATER, "lowest shoreline height is %d at %d,%d\n", lowHeight, lowPoint.x, lowPoint.y);
 
 		lowPointAt = lowPoint;
 		return true;
@@ -182,7 +182,7 @@ bool Lake::lowestNonLake(Point &src, Point& lowPointAt)
 
 	if (lowHeight < numeric_limits<int>::max())
 	{
-		//Logger::Instance().Log ("lowestNonLake: %d,%d at height %d\n", lowPoint.x, lowPoint.y, lowHeight);
+		//LOG_DEBUG (LOG_WATER, "lowestNonLake: %d,%d at height %d\n", lowPoint.x, lowPoint.y, lowHeight);
 
 		lowPointAt = lowPoint;
 		return true;
@@ -253,7 +253,7 @@ void Lake::raiseLake (int newHeight)
 
 	Point p;
 
-	Logger::Instance().Log ("lake %d: raising %d points to %d\n", id, points.size(), newHeight);
+	LOG_DEBUG (LOG_WATER, "lake %d: raising %d points to %d\n", id, points.size(), newHeight);
 
 	while (points.Iterate_Next(p))
 	{
@@ -263,15 +263,15 @@ void Lake::raiseLake (int newHeight)
 
 void Lake::displayLake ()
 {
-	Logger::Instance().Log ("Lake %d:  (%d points)", id, points.size());
+	LOG_DEBUG (LOG_WATER, "Lake %d:  (%d points)", id, points.size());
 
 	points.Reset_Iterator();
 	Point p;
 
 	while (points.Iterate_Next(p))
 	{
-		Logger::Instance().Log (" (%d,%d) ", p.x, p.y);
+		LOG_TRACE (LOG_WATER, " (%d,%d) ", p.x, p.y);
 	}
 
-	Logger::Instance().Log ("\n");
+	LOG_DEBUG (LOG_WATER, "\n");
 }
\ No newline at end of file
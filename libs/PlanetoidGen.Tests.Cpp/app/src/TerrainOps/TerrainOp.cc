@@ -7,6 +7,7 @@ TerrainOp::TerrainOp ()
 {
 	overrideFixed = false;
 	delta = 0;
+	rng = &Random::Current();
 }
 void TerrainOp::setOverride (bool b)						
 {
@@ -65,8 +66,8 @@ void SetHeightOp::Execute(Point &p)
 	else
 	{
 		int range = abs(range_max - range_min);
-		height = rand() % range + range_min;
-		//Logger::Instance().Log ("SetHeightOp sets altitude via rand to %d\n", height);
+		height = rng->nextInt(range) + range_min;
+		//LOG_DEBUG (LOG_TERRAIN, "SetHeightOp sets altitude via rand to %d\n", height);
 	}
 
 	int delta = getDelta();
@@ -83,7 +84,7 @@ void SetHeightOp::Execute(Point &p)
 		{
 			if (Executive::Instance().isWatched(p))
 			{
-				Logger::Instance().Log ("*** SetHeight overriding fix on watch point\n");
+				LOG_DEBUG (LOG_TERRAIN, "*** SetHeight overriding fix on watch point\n");
 			}
 
 			Executive::Instance().unfix(p);
@@ -106,7 +107,7 @@ void SmootherOp::Execute(Point& p)
 	{
 			if (Executive::Instance().isWatched(p))
 			{
-				Logger::Instance().Log ("*** Smoother overriding fix on watch point\n");
+				LOG_DEBUG (LOG_TERRAIN, "*** Smoother overriding fix on watch point\n");
 			}
 
 		Executive::Instance().unfix(p);
@@ -147,22 +148,22 @@ void RoughenerOp::Execute(Point& p)
 		Executive::Instance().unfix(p);
 	}
 
-	if (rand() % 100 < probability)
+	if (rng->nextInt(100) < probability)
 	{
-		if (rand() % 2 == 1)
+		if (rng->nextInt(2) == 1)
 		{
-			delta = -1 * (rand() % variance);
+			delta = -1 * rng->nextInt(variance);
 		}
 		else
 		{
-			delta = (rand() % variance);
+			delta = rng->nextInt(variance);
 		}
 
 		height += delta;
 		height = std::max(height, 1);
 
 		Executive::Instance().setHeight(p, height);
-		// Logger::Instance().Log ("adding %d to point, resulting in %d\n", delta, height);
+		// LOG_DEBUG (LOG_TERRAIN, "adding %d to point, resulting in %d\n", delta, height);
 	}
 
 	if (mayOverride() && fixed)
@@ -6,7 +6,7 @@
 
 using namespace std;
 
-bool logPlow = false;
+thread_local bool logPlow = false;
 WidenerOp::WidenerOp (TerrainOp& op, int w, int dir, bool doSmooth) : 
 	  subOp(op), width(w), direction(dir), smooth(doSmooth)	
 {
@@ -67,7 +67,7 @@ void WidenerOp::processLocation (Point& location, int dir)
     {
 		if (logPlow)
 		{
-			Logger::Instance().Log ("changing direction from %d to %d at (%d,%d)\n", prev_dir, dir, location.x, location.y);
+			LOG_TRACE (LOG_TERRAIN, "changing direction from %d to %d at (%d,%d)\n", prev_dir, dir, location.x, location.y);
 		}
 
         changeDirection (location.x, location.y, dir);
@@ -82,7 +82,7 @@ void WidenerOp::processLocation (Point& location, int dir)
     {
 		if (logPlow)
 		{
-			Logger::Instance().Log ("sliceDir is seen to be on a diagonal, filling\n");
+			LOG_TRACE (LOG_TERRAIN, "sliceDir is seen to be on a diagonal, filling\n");
 		}
 
         processSlice (previous.x, location.y, sliceDir);
@@ -90,7 +90,7 @@ void WidenerOp::processLocation (Point& location, int dir)
     }
 	else if (logPlow)
 	{
-		Logger::Instance().Log ("sliceDir %d is not on a diagonal, not filling\n");
+		LOG_TRACE (LOG_TERRAIN, "sliceDir %d is not on a diagonal, not filling\n");
 	}
 
 	previous = location;
@@ -139,7 +139,7 @@ void WidenerOp::convertDirection(int dir, int& dx, int& dy)
 		default:
 			dx = 0;
 			dy = 0;
-			Logger::Instance().Log ("invalid direction passed to Widener::convertDirection\n");
+			LOG_ERROR (LOG_TERRAIN, "invalid direction passed to Widener::convertDirection\n");
 	}
 
 	return;
@@ -156,7 +156,7 @@ void WidenerOp::processSlice (int x, int y, int dir)
 	int dx;
 	int dy;
 
-//	Logger::Instance().Log ("widener starting at (%d,%d) dir %d\n", x, y, dir);
+//	LOG_DEBUG (LOG_TERRAIN, "widener starting at (%d,%d) dir %d\n", x, y, dir);
 
 	if (isDiagonal(dir))
 	{
@@ -165,7 +165,7 @@ void WidenerOp::processSlice (int x, int y, int dir)
 
 	if (logPlow)
 	{
-		Logger::Instance().Log ("processSlice %d,%d dir=%d\n", x, y, dir);
+		LOG_TRACE (LOG_TERRAIN, "processSlice %d,%d dir=%d\n", x, y, dir);
 	}
 
   convertDirection (dir, dx, dy);
@@ -180,15 +180,15 @@ void WidenerOp::processSlice (int x, int y, int dir)
 
 	if (logPlow)
 	{
-		Logger::Instance().Log ("point on slice is (%d,%d)\n", p.x, p.y);
-		Logger::Instance().Log ("center point (%d,%d), clDistance = %d\n", x, y, cl_distance);
+		LOG_TRACE (LOG_TERRAIN, "point on slice is (%d,%d)\n", p.x, p.y);
+		LOG_TRACE (LOG_TERRAIN, "center point (%d,%d), clDistance = %d\n", x, y, cl_distance);
 	}
 
 	if (! Executive::Instance().onMap(p))
 	{
 		if (logPlow)
 		{
-			Logger::Instance().Log ("skipping point which is off the map\n");
+			LOG_TRACE (LOG_TERRAIN, "skipping point which is off the map\n");
 		}
 
 		continue;
@@ -199,7 +199,7 @@ void WidenerOp::processSlice (int x, int y, int dir)
 	if (decay_elev)
 	{
 		int delta = decay_elev * cl_distance;
-		//Logger::Instance().Log ("decaying elev by %d\n", delta);
+		//LOG_DEBUG (LOG_TERRAIN, "decaying elev by %d\n", delta);
 		subOp.setDelta(delta);
 	}
 
@@ -242,7 +242,7 @@ void WidenerOp::changeDirection (int x, int y, int dir)
 
   if (logPlow)
   {
-	  Logger::Instance().Log ("previous slices would be moving in direction %d\n", sliceDir);
+	  LOG_TRACE (LOG_TERRAIN, "previous slices would be moving in direction %d\n", sliceDir);
   }
 
   int x2 = px;
@@ -3,6 +3,8 @@
 #include "params.h"
 #include "logger.h"
 #include "pointset.h"
+#include "generationcontext.h"
+#include "heaptrack.h"
 
 
 using namespace std;
@@ -11,6 +13,13 @@ std::unique_ptr<WaterModel> WaterModel::_instance;
 
 WaterModel& WaterModel::Instance()
 {
+	GenerationContext *context = GenerationContext::Current();
+
+	if (context != NULL)
+	{
+		return context->getWaterModel();
+	}
+
 	if (_instance.get() == NULL)
 	{
 		_instance.reset (new WaterModel);
@@ -22,6 +31,7 @@ WaterModel& WaterModel::Instance()
 WaterModel::WaterModel()
 {
 	Params& params = Params::Instance();
+	HeapScope heap (HEAP_WATER);
 
 	for (int i = 0; i < params.x_size; i++)
 	{
@@ -83,18 +93,19 @@ void WaterModel::loadVector (std::vector<WaterNode>& dest)
 		dest.insert(dest.end(), map[i].begin(), map[i].end());
 	}
 
-	Logger::Instance().Log ("load full vector in WaterModel:  %d points\n", dest.size());
+	LOG_DEBUG (LOG_WATER, "load full vector in WaterModel:  %d points\n", dest.size());
 }
 
 void WaterModel::setFlowVectors()
 {
+	HeapScope heap (HEAP_WATER);
 
 	vector<WaterNode> allPoints;
 	loadVector(allPoints);
 
 	vector<WaterNode>::iterator iter;
 
-	Logger::Instance().Log ("\n\nSetting flow vectors for %d points\n\n", allPoints.size());
+	LOG_DEBUG (LOG_WATER, "\n\nSetting flow vectors for %d points\n\n", allPoints.size());
 
 	int sealevelPoints = 0;
 
@@ -109,7 +120,7 @@ void WaterModel::setFlowVectors()
 
 		if ((location.x == 32) && (location.y == 107))
 		{
-			Logger::Instance().Log ("breakpoint\n");
+			LOG_DEBUG (LOG_WATER, "breakpoint\n");
 		}
 
 		int height = Executive::Instance().getHeight(location);
@@ -131,28 +142,28 @@ void WaterModel::setFlowVectors()
 		// the lowest point will be "downstream" for this point on the river (and must be lower in elevation than the current point)
 		if (! findLowestNotInPath (location, next))
 		{
-//			Logger::Instance().Log ("start lake at (%d,%d)\n", location.x, location.y);
+//			LOG_DEBUG (LOG_WATER, "start lake at (%d,%d)\n", location.x, location.y);
 			int id = startLake(location, next);
 			flow = lakes[id].getOutflow();
 
 			if (location == next)
 			{
-				Logger::Instance().Log ("lake flowing to self\n");
+				LOG_DEBUG (LOG_WATER, "lake flowing to self\n");
 			}
 
-	//		Logger::Instance().Log ("lake %d is fed from (%d,%d)\n", id, next.x, next.y);
+	//		LOG_DEBUG (LOG_WATER, "lake %d is fed from (%d,%d)\n", id, next.x, next.y);
 	//		lakes[id].displayLake();
 	//		printHeightmap ();
 			if (! Executive::Instance().onMap(next))
 			{
-	//			Logger::Instance().Log ("lake flows off of the map\n");
+	//			LOG_DEBUG (LOG_WATER, "lake flows off of the map\n");
 				continue;
 			}
 		}
 
 		if (! Executive::Instance().onMap(next))
 		{
-	//		Logger::Instance().Log ("river flows off of the map to (%d,%d)\n", next.x, next.y);
+	//		LOG_DEBUG (LOG_WATER, "river flows off of the map to (%d,%d)\n", next.x, next.y);
 			continue;
 		}
 
@@ -168,14 +179,14 @@ void WaterModel::setFlowVectors()
 
 		map[next.x][next.y].addInflow(flow);
 		map[x][y].downstream = next;
-//		Logger::Instance().Log ("adding %d to flow into (%d,%d)\n", flow, next.x, next.y);
+//		LOG_DEBUG (LOG_WATER, "adding %d to flow into (%d,%d)\n", flow, next.x, next.y);
 		if (location == next)
 		{
-			Logger::Instance().Log ("water flowing to self\n");
+			LOG_DEBUG (LOG_WATER, "water flowing to self\n");
 		}
 	}
 
-	Logger::Instance().Log ("%d points at or below sea level\n", sealevelPoints);
+	LOG_DEBUG (LOG_WATER, "%d points at or below sea level\n", sealevelPoints);
 }
 
 void WaterModel::printAllFlows ()
@@ -192,7 +203,7 @@ void WaterModel::printAllFlows ()
 			if (!Executive::Instance().on_land(location))
 			{
 				ocean++;
-			//	Logger::Instance().Log ("(%d,%d) not on land\n", i, j);
+			//	LOG_DEBUG (LOG_WATER, "(%d,%d) not on land\n", i, j);
 				continue;
 			}
 
@@ -200,15 +211,14 @@ void WaterModel::printAllFlows ()
 	
 			Point downstream = map[i][j].downstream;
 
-			int nextFlow = flowAt(downstream);
-			Logger::Instance().Log ("(%d,%d) sending %d water to (%d,%d), which has %d\n", i, j, flow, 
-				downstream.x, downstream.y, nextFlow);
+			LOG_TRACE (LOG_WATER, "(%d,%d) sending %d water to (%d,%d), which has %d\n", i, j, flow, 
+				downstream.x, downstream.y, flowAt(downstream));
 			total += flow;
 		}
 	}
 
 	// total can be larger than the number of vertices, since a single unit of water counts in each point downstream
-	Logger::Instance().Log ("moved a total of %d water, %d water areas did not contribute \n", total, ocean);
+	LOG_DEBUG (LOG_WATER, "moved a total of %d water, %d water areas did not contribute \n", total, ocean);
 
 }
 
@@ -230,7 +240,7 @@ bool WaterModel::findLowestNotInPath (Point& current, Point& next)
 	int lowestHeight = 100000;
 	Point bestNeighbor;
 
-	//Logger::Instance().Log ("searching for next point, starting at (%d,%d)\n", current.x, current.y);
+	//LOG_DEBUG (LOG_WATER, "searching for next point, starting at (%d,%d)\n", current.x, current.y);
 
 	// check all neighboring points for something lower
 	for (int i = 0; i < 8; i++)
@@ -240,7 +250,7 @@ bool WaterModel::findLowestNotInPath (Point& current, Point& next)
 		// skip over neighbors which we have visited
 		if (visited.in_set(neighbor))
 		{
-	//		Logger::Instance().Log ("ignoring point (%d,%d) since it has been visited\n", neighbor.x, neighbor.y);
+	//		LOG_DEBUG (LOG_WATER, "ignoring point (%d,%d) since it has been visited\n", neighbor.x, neighbor.y);
 			continue;
 		}
 
@@ -252,7 +262,7 @@ bool WaterModel::findLowestNotInPath (Point& current, Point& next)
 			bestNeighbor = neighbor;
 		}
 
-		//Logger::Instance().Log ("consider (%d,%d) at height %d\n", neighbor.x, neighbor.y, neighborHeight);
+		//LOG_DEBUG (LOG_WATER, "consider (%d,%d) at height %d\n", neighbor.x, neighbor.y, neighborHeight);
 	}
 
 	if (lowestHeight < currentHeight)
@@ -273,6 +283,7 @@ int WaterModel::startLake (Point& p, Point& outflow)
 	Point lowest;
 	Point inflow;
 	int height = Executive::Instance().getHeight(p);
+	HeapScope heap (HEAP_WATER);
 
 	int id = lakes.size();
 
@@ -295,12 +306,12 @@ int WaterModel::startLake (Point& p, Point& outflow)
 		if (highestInflowNeighbor(id, lowest, p))
 		{
 			flow = flowAt(p);
-			//Logger::Instance().Log ("highest inflow into (%d,%d) is %d through %d,%d\n",
+			//LOG_DEBUG (LOG_WATER, "highest inflow into (%d,%d) is %d through %d,%d\n",
 			//	lowest.x, lowest.y, flow, p.x, p.y);
 		}
 		else
 		{
-			Logger::Instance().Log ("unable to find the inflow into point (%d,%d)\n", lowest.x, lowest.y);
+			LOG_WARN (LOG_WATER, "unable to find the inflow into point (%d,%d)\n", lowest.x, lowest.y);
 			flow = 0;
 		}
 
@@ -313,31 +324,31 @@ int WaterModel::startLake (Point& p, Point& outflow)
 		{
 			if (! Executive::Instance().onMap(downstream))
 			{
-				//Logger::Instance().Log ("lake %d empties off the map\n", id);
+				//LOG_DEBUG (LOG_WATER, "lake %d empties off the map\n", id);
 				inflow = downstream;
 				return id;
 			}
 
-			//Logger::Instance().Log ("possible overflow point at (%d,%d)\n", downstream.x, downstream.y);
+			//LOG_DEBUG (LOG_WATER, "possible overflow point at (%d,%d)\n", downstream.x, downstream.y);
 			// by definition the point "downstream" is not currently in the lake.  However we need to
 			// check if it is currently flowing into a lake point (and therefore needs to be added)
 
 			Point nextPoint;		// where the downstream point is flowing
 			if (downstreamPoint(downstream, nextPoint))
 			{
-				//Logger::Instance().Log ("lake %d considers overflowing towards(%d,%d)\n", id, nextPoint.x,
+				//LOG_DEBUG (LOG_WATER, "lake %d considers overflowing towards(%d,%d)\n", id, nextPoint.x,
 				//	nextPoint.y);
 				int height = Executive::Instance().getHeight(downstream);
 
 				// a point was found
 				if (! lakes[id].inLake(nextPoint))
 				{
-					//Logger::Instance().Log ("lake %d empties out of %d,%d to %d,%d\n",
+					//LOG_DEBUG (LOG_WATER, "lake %d empties out of %d,%d to %d,%d\n",
 					//	id, downstream.x, downstream.y, nextPoint.x, nextPoint.y);
 					lakes[id].setOutflowPoint(nextPoint);
 					if (! lakes[id].getInflowPoint(inflow))
 					{
-						Logger::Instance().Log ("unknown inflow point for this lake\n");
+						LOG_WARN (LOG_WATER, "unknown inflow point for this lake\n");
 					}
 					
 					lakes[id].raiseLake(height);
@@ -349,7 +360,7 @@ int WaterModel::startLake (Point& p, Point& outflow)
 					}
 					else
 					{
-						Logger::Instance().Log ("unable to find inflow/upstream point for lake\n");
+						LOG_WARN (LOG_WATER, "unable to find inflow/upstream point for lake\n");
 					}
 
 					outflow = downstream;
@@ -358,12 +369,12 @@ int WaterModel::startLake (Point& p, Point& outflow)
 				else
 				{
 					// downstream is *not* in the lake, but flows back in
-					Logger::Instance().Log ("lake point %d,%d flows downstream to (%d,%d) which is inside the lake\n",
+					LOG_DEBUG (LOG_WATER, "lake point %d,%d flows downstream to (%d,%d) which is inside the lake\n",
 						downstream.x, downstream.y, nextPoint.x, nextPoint.y);
 
 					int height = Executive::Instance().getHeight(downstream);
 					int height2 = Executive::Instance().getHeight(nextPoint);
-					Logger::Instance().Log ("h1 = %d, h2 = %d\n", height, height2);
+					LOG_DEBUG (LOG_WATER, "h1 = %d, h2 = %d\n", height, height2);
 					checkLakesForPoint (nextPoint);
 					lakes[id].displayLake();
 
@@ -373,7 +384,7 @@ int WaterModel::startLake (Point& p, Point& outflow)
 
 				// the downstream point also empties into the lake
 				lowest = downstream;
-				//Logger::Instance().Log ("point %d,%d empties into the lake\n", lowest.x, lowest.y);
+				//LOG_DEBUG (LOG_WATER, "point %d,%d empties into the lake\n", lowest.x, lowest.y);
 			//	printHeightmap ();
 			}
 			else
@@ -382,7 +393,7 @@ int WaterModel::startLake (Point& p, Point& outflow)
 				lakes[id].raiseLake(height);
 				if (! lakes[id].getInflowPoint(inflow))
 				{
-					Logger::Instance().Log ("unknown inflow point for this lake\n");
+					LOG_WARN (LOG_WATER, "unknown inflow point for this lake\n");
 				}
 
 				if (lakes[id].highestInflowNeighbor(inflow))
@@ -392,22 +403,22 @@ int WaterModel::startLake (Point& p, Point& outflow)
 				}
 				else
 				{
-					Logger::Instance().Log ("unable to find inflow/upstream point for lake\n");
+					LOG_WARN (LOG_WATER, "unable to find inflow/upstream point for lake\n");
 				}
 
 				outflow = downstream;
-				//Logger::Instance().Log ("(%d,%d) flows off the map\n", downstream.x, downstream.y);
+				//LOG_DEBUG (LOG_WATER, "(%d,%d) flows off the map\n", downstream.x, downstream.y);
 				return id;
 			}
 		}
 		else
 		{
-			Logger::Instance().Log ("no lowestShorePoint found\n");
+			LOG_WARN (LOG_WATER, "no lowestShorePoint found\n");
 			return id;
 		}
 	}
 
-	Logger::Instance().Log ("lake %d may be growing without bound\n", id);
+	LOG_WARN (LOG_WATER, "lake %d may be growing without bound\n", id);
 	return id;
 }
 
@@ -461,7 +472,7 @@ int WaterModel::flowAt (Point& p)
 {
 	if (! Executive::Instance().onMap(p))
 	{
-		// Logger::Instance().Log ("flow check for point %d,%d which is off of the map\n", p.x, p.y);
+		// LOG_DEBUG (LOG_WATER, "flow check for point %d,%d which is off of the map\n", p.x, p.y);
 		return 0;
 	} 
 
@@ -497,7 +508,7 @@ void WaterModel::propagateDownStream (Point& p, int flow)
 
 	while (downstream != end)
 	{
-		Logger::Instance().Log ("propagate visits (%d,%d)\n", downstream.x, downstream.y);
+		LOG_TRACE (LOG_WATER, "propagate visits (%d,%d)\n", downstream.x, downstream.y);
 
 		downstream = map[downstream.x][downstream.y].downstream;
 	}
@@ -505,7 +516,7 @@ void WaterModel::propagateDownStream (Point& p, int flow)
 
 void WaterModel::checkLakesForPoint (Point& p)
 {
-	Logger::Instance().Log ("point (%d,%d) is in the following lakes: ", p.x, p.y);
+	LOG_DEBUG (LOG_WATER, "point (%d,%d) is in the following lakes: ", p.x, p.y);
 
 	int size = (int) lakes.size();
 
@@ -513,8 +524,8 @@ void WaterModel::checkLakesForPoint (Point& p)
 	{
 		if (lakes[i].inLake(p))
 		{
-			Logger::Instance().Log (" %d ", i);
+			LOG_DEBUG (LOG_WATER, " %d ", i);
 		}
 	}
-	Logger::Instance().Log ("\n");
+	LOG_DEBUG (LOG_WATER, "\n");
 }
\ No newline at end of file
@@ -8,7 +8,7 @@
 
 const int BAD_SCORE = -10000000;
 
-int Action::count = 0;
+std::atomic<int> Action::count (0);
 
 // =======================================================
 /// @brief Action constructor
@@ -24,6 +24,7 @@ Action::Action (Map *m, int dir, Point& seed, int sz, int _parent)
 
 	id = count++;
 	parent = _parent;
+	rng = Random::Current().split();
 
 	mask = m;
 	action_size = sz;
@@ -42,20 +43,20 @@ Action::Action (Map *m, int dir, Point& seed, int sz, int _parent)
 
 	bset.setSize(mask->GetXSize(), mask->GetYSize());
 
-	// Logger::Instance().Log ("New Action %d (%d, %d)\n", id, seed.x, seed.y);
-	// Logger::Instance().Log ("Size = %d, Dir = %d\n", action_size, dir);
+	// LOG_DEBUG (LOG_MASK, "New Action %d (%d, %d)\n", id, seed.x, seed.y);
+	// LOG_DEBUG (LOG_MASK, "Size = %d, Dir = %d\n", action_size, dir);
 
 	// hopefully the seed point is an active point, but in case it is not, search the action's ray 
 	// used to check for 0 elevation, but points on the boundary should have been elevated already
 	if (!is_active(seed))
 	{
 		Point point;
-		// Logger::Instance().Log ("action %d, initial seed (%d,%d) is not active, searching ray\n", id, seed.x, seed.y);
+		// LOG_DEBUG (LOG_MASK, "action %d, initial seed (%d,%d) is not active, searching ray\n", id, seed.x, seed.y);
 		if (find_active_on_ray (seed, point))
 		{
 			seed_pt.x = point.x;
 			seed_pt.y = point.y;
-			// Logger::Instance().Log ("found new seed point %d,%d\n", point.x, point.y);
+			// LOG_DEBUG (LOG_MASK, "found new seed point %d,%d\n", point.x, point.y);
 		}
 		else
 		{
@@ -70,7 +71,7 @@ Action::Action (Map *m, int dir, Point& seed, int sz, int _parent)
 		seed_pt.y = seed.y;
 	}
 
-//	Logger::Instance().Log ("Action %d starting at (%d,%d)\n", id, seed_pt.x, seed_pt.y);
+//	LOG_DEBUG (LOG_MASK, "Action %d starting at (%d,%d)\n", id, seed_pt.x, seed_pt.y);
 
 	if (is_active (seed_pt))
 	{
@@ -80,20 +81,20 @@ Action::Action (Map *m, int dir, Point& seed, int sz, int _parent)
 
 	// dist = Dist_to_Edge (seed_pt) - 4;
 
-	int dir1 = rand() % 8;			// dir of attractor
+	int dir1 = rng.nextInt(8);			// dir of attractor
 	int dir2 = dir1;					// dir of repulsor
 
-	dist = rand() % mask->GetXSize();
+	dist = rng.nextInt(mask->GetXSize());
 	StepDir(seed_pt, attractor, dir1, dist);
-	// Logger::Instance().Log ("action %d set attractor (%d,%d)\n", id, attractor.x, attractor.y);
+	// LOG_DEBUG (LOG_MASK, "action %d set attractor (%d,%d)\n", id, attractor.x, attractor.y);
 
 	while (dir1 == dir2)
 	{
-		dir2 = rand() % 8;
+		dir2 = rng.nextInt(8);
 	}
-	dist = rand() % mask->GetXSize();
+	dist = rng.nextInt(mask->GetXSize());
 	StepDir(seed_pt, repulsor, dir2, dist);
-	// Logger::Instance().Log ("action %d set repulsor (%d,%d)\n", id, repulsor.x, repulsor.y);
+	// LOG_DEBUG (LOG_MASK, "action %d set repulsor (%d,%d)\n", id, repulsor.x, repulsor.y);
 
 }
 
@@ -188,7 +189,7 @@ void Action::dump_active ()
 	Point p;
 	int count = 0;
 
-	Logger::Instance().Log ("Active Boundary Points:\n");
+	LOG_DEBUG (LOG_MASK, "Active Boundary Points:\n");
 
 	mask->resetBoundaryIterator();
 
@@ -205,7 +206,7 @@ void Action::dump_active ()
 		else
 			msg << "(active)";
 
-		Logger::Instance().Log (msg.str());
+		LOG_DEBUG (LOG_MASK, msg.str());
 	}
 }
 
@@ -270,13 +271,13 @@ bool Action::find_active_on_ray (Point& src, Point& result)
 			return true;
 		}
 
-		// Logger::Instance().Log ("action %d searching ray, skipping inactive point\n", id);
+		// LOG_DEBUG (LOG_MASK, "action %d searching ray, skipping inactive point\n", id);
 
 		p.x = next.x;
 		p.y = next.y;
 	}
 
-	Logger::Instance().Log ("action %d failed to find an active point on ray\n", id);
+	LOG_WARN (LOG_MASK, "action %d failed to find an active point on ray\n", id);
 	return false;
 }
 
@@ -325,7 +326,7 @@ void Action::Display_Region (Point& p, int range)
 
 	msg << "Map from x = " << (x - range) << "-" << (x + range - 1);
 	msg << "  y = " << (y - range) << "-" << (y + range - 1);
-	Logger::Instance().Log (msg.str());
+	LOG_DEBUG (LOG_MASK, msg.str());
 
 	for (int i = (x - range); i < (x + range); i++)
 	{
@@ -347,12 +348,12 @@ void Action::Display_Region (Point& p, int range)
 		}
 
 		msg << std::endl;
-		Logger::Instance().Log (msg.str());
+		LOG_DEBUG (LOG_MASK, msg.str());
 	}
 
 	msg.str("");
 	msg << "Key:  X=off map, . = unset, + = set";
-	Logger::Instance().Log (msg.str());
+	LOG_DEBUG (LOG_MASK, msg.str());
 	msg.str("");
 }
 
@@ -435,12 +436,12 @@ bool Action::random_active (Point &point)
 
 	if (! bset.random_member(p))
 	{
-//		Logger::Instance().Log ("action %d appears to have an empty boundary set, searching ray from seed\n", id);
+//		LOG_DEBUG (LOG_MASK, "action %d appears to have an empty boundary set, searching ray from seed\n", id);
 		return find_active_on_ray (seed_pt, point);
 	}
 
 	// point was found, and is valid
-	// Logger::Instance().Log ("random active (%d,%d): %d free points\n", p.x, p.y, mask->num_free_points(p));
+	// LOG_DEBUG (LOG_MASK, "random active (%d,%d): %d free points\n", p.x, p.y, mask->num_free_points(p));
 
 	point.x = p.x;
 	point.y = p.y;
@@ -530,8 +531,8 @@ long Action::Score (Point& p)
 	msg << "Point (" << p->x << "," << p->y << "): ";
 	msg << "d_attr=" << d_attr << " d_hist=" << d_hist;
 	msg << " d_repl=" << d_repl << " d_map=" << d_map;
-	Logger::Instance().Log (msg.str());
-	Logger::Instance().Log ("Total = %d\n", 
+	LOG_DEBUG (LOG_MASK, msg.str());
+	LOG_DEBUG (LOG_MASK, "Total = %d\n", 
 		d_attr + d_hist - (d_repl + d_map));
 #endif
 
@@ -566,7 +567,7 @@ void Action::PlotPixels ()
 
 	if (! random_active(p))
 	{
-			Logger::Instance().Log ("random_active found no points\n");
+			LOG_WARN (LOG_MASK, "random_active found no points\n");
 			return;
 	}
 
@@ -574,13 +575,13 @@ void Action::PlotPixels ()
 	{
 		if (! random_active (p))
 		{
-			Logger::Instance().Log ("random_active found no points\n");
+			LOG_WARN (LOG_MASK, "random_active found no points\n");
 			return;
 		}
 
 		if (! is_active (p))
 		{
-			Logger::Instance().Log ("aborting PlotPixels since point wasn't marked active\n");
+			LOG_WARN (LOG_MASK, "aborting PlotPixels since point wasn't marked active\n");
 			return;
 		}
 
@@ -605,7 +606,7 @@ void Action::expand_pt (Point& p)
 	int curr_direction = direction;
 	int best_score = BAD_SCORE;
 
-	// Logger::Instance().Log ("action %d expanding point (%d,%d)\n", id, p.x, p.y);
+	// LOG_DEBUG (LOG_MASK, "action %d expanding point (%d,%d)\n", id, p.x, p.y);
 
 	// score all adjacent points
 	for (int dir = 0; dir < 8; dir++)
@@ -667,7 +668,9 @@ void Action::expand_pt (Point& p)
 void Action::generate ()
 {
 	Params& params = Params::Instance();
-	unsigned int action_size_limit = (rand() % (params.action_size_max - params.action_size_min)) + params.action_size_min;
+	RandomScope scope (rng);				// sub-actions and boundary picks draw from this subtree
+
+	unsigned int action_size_limit = rng.nextInt(params.action_size_max - params.action_size_min) + params.action_size_min;
 
 	// once size gets small, just generate raw pixels
 	if (action_size <= action_size_limit)
@@ -686,7 +689,7 @@ void Action::generate ()
 			return;
 		}
 
-		int dir = rand() % 8;
+		int dir = rng.nextInt(8);
 		int best_score = BAD_SCORE;
 		int best_dir = dir;
 
@@ -715,8 +718,8 @@ void Action::generate ()
 		{
 			return;
 		}
-//		Logger::Instance().Log ("action %d (from %d) is splitting, attempting to seed from (%d,%d)\n", id, parent, p.x, p.y);
-//		Logger::Instance().Log ("action %d is currently generating %d points\n", id, action_size);
+//		LOG_DEBUG (LOG_MASK, "action %d (from %d) is splitting, attempting to seed from (%d,%d)\n", id, parent, p.x, p.y);
+//		LOG_DEBUG (LOG_MASK, "action %d is currently generating %d points\n", id, action_size);
 		Action *sub = new Action (mask, best_dir, p, action_size/2, id);
 		sub -> generate ();
 		delete sub;
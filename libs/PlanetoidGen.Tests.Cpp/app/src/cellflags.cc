@@ -0,0 +1,107 @@
+#include "cellflags.h"
+#include <algorithm>
+
+CellFlags::CellFlags ()
+{
+	x_dim = 0;
+	y_dim = 0;
+}
+
+CellFlags::CellFlags (int x_size, int y_size)
+{
+	x_dim = 0;
+	y_dim = 0;
+	allocate (x_size, y_size);
+}
+
+// ===================================================================
+// allocate -- size the grid and clear every flag
+// ===================================================================
+void CellFlags::allocate (int x_size, int y_size)
+{
+	x_dim = x_size;
+	y_dim = y_size;
+
+	cells.assign ((size_t) x_dim * y_dim, 0);
+}
+
+// ===================================================================
+// count -- the number of cells on the map carrying a flag
+// ===================================================================
+long CellFlags::count (uint8_t flag)
+{
+	return countRect (0, 0, x_dim, y_dim, flag);
+}
+
+// ===================================================================
+// countRect -- the number of cells in [x1,x2) x [y1,y2) carrying a flag
+//
+// The rectangle is clipped to the map.
+// ===================================================================
+long CellFlags::countRect (int x1, int y1, int x2, int y2, uint8_t flag)
+{
+	x1 = std::max (x1, 0);
+	y1 = std::max (y1, 0);
+	x2 = std::min (x2, x_dim);
+	y2 = std::min (y2, y_dim);
+
+	long total = 0;
+
+	for (int y = y1; y < y2; y++)
+	{
+		const uint8_t *r = row (y);
+		int n = 0;
+
+		// branch-free so the inner loop vectorizes
+		for (int x = x1; x < x2; x++)
+		{
+			n += (r[x] & flag) != 0;
+		}
+
+		total += n;
+	}
+
+	return total;
+}
+
+// ===================================================================
+// anyInRect -- true if any cell in [x1,x2) x [y1,y2) carries a flag
+// ===================================================================
+bool CellFlags::anyInRect (int x1, int y1, int x2, int y2, uint8_t flag)
+{
+	x1 = std::max (x1, 0);
+	y1 = std::max (y1, 0);
+	x2 = std::min (x2, x_dim);
+	y2 = std::min (y2, y_dim);
+
+	for (int y = y1; y < y2; y++)
+	{
+		const uint8_t *r = row (y);
+		uint8_t seen = 0;
+
+		for (int x = x1; x < x2; x++)
+		{
+			seen |= r[x];
+		}
+
+		if (seen & flag)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ===================================================================
+// clearAll -- remove a flag from every cell
+// ===================================================================
+void CellFlags::clearAll (uint8_t flag)
+{
+	uint8_t keep = ~flag;
+
+	for (size_t i = 0; i < cells.size(); i++)
+	{
+		cells[i] &= keep;
+	}
+}
@@ -10,6 +10,7 @@
 #include <cstring>
 #include "params.h"
 #include "executive.h"
+#include "random.h"
 
 Culture_Generator::Culture_Generator ()
 {
@@ -37,7 +38,7 @@ void Culture_Generator::generate (void)
 	generate_textures ();
 	if (! texture)
 	{
-		Logger::Instance().Log ("textures not generated prior to cultural\n");
+		LOG_ERROR (LOG_AGENTS, "textures not generated prior to cultural\n");
 		return;
 	}
 
@@ -49,8 +50,8 @@ void Culture_Generator::generate (void)
 
 	if (! culture)
 	{
-		Logger::Instance().Log ("cannot open cultural file for output\n");
-		Logger::Instance().Log ("./split/cultural.xml:  %s\n",
+		LOG_ERROR (LOG_AGENTS, "cannot open cultural file for output\n");
+		LOG_ERROR (LOG_AGENTS, "./split/cultural.xml:  %s\n",
 			strerror (errno));
 	}
 
@@ -61,13 +62,13 @@ void Culture_Generator::generate (void)
 
 	if (find_flat_region (p))
 	{
-		Logger::Instance().Log ("flat region around (%d,%d)\n", p.x, p.y);
+		LOG_DEBUG (LOG_AGENTS, "flat region around (%d,%d)\n", p.x, p.y);
 
 		int grass3 = 7;
 		PointSet grassy_region (params.x_size, params.y_size);
 
 		texture_blob (grassy_region, p.x, p.y, grass3, 200);
-		Logger::Instance().Log ("%d points in grassy region\n",
+		LOG_DEBUG (LOG_AGENTS, "%d points in grassy region\n",
 			grassy_region.size());
 
 		// build forest region
@@ -77,14 +78,14 @@ void Culture_Generator::generate (void)
 
 			if (!grassy_region.random_member (seed))
 			{
-				Logger::Instance().Log ("unable to obtain random member of grassy blob, aborting texturing\n");
+				LOG_WARN (LOG_AGENTS, "unable to obtain random member of grassy blob, aborting texturing\n");
 				return;
 			}
 
-			float rotation = (rand() % 360000) / 1000.0f;
-			float scale = (0.9f + (rand() % 200) / 100.0f);
+			float rotation = Random::Current().nextInt(360000) / 1000.0f;
+			float scale = (0.9f + Random::Current().nextInt(200) / 100.0f);
 
-			switch (rand() % 2)
+			switch (Random::Current().nextInt(2))
 			{
 				case 0:
 					place_mesh (culture, std::string("weed2.mesh"), (float) seed.x, (float) seed.y, rotation, scale);
@@ -100,7 +101,7 @@ void Culture_Generator::generate (void)
 	}
 	else
 	{
-		Logger::Instance().Log ("no flat region found on terrain\n");
+		LOG_WARN (LOG_AGENTS, "no flat region found on terrain\n");
 	}
 
 	culture << "</Cultural>" << std::endl << std::endl;
@@ -113,7 +114,7 @@ void Culture_Generator::generate (void)
 
 	cPoint tx_p1, tx_p2;
 
-	Logger::Instance().Log ("translating corners of ocean\n");
+	LOG_DEBUG (LOG_AGENTS, "translating corners of ocean\n");
 	translate (0, 0, tx_p1);
 	translate (params.x_size, params.y_size, tx_p2);
 
@@ -134,7 +135,7 @@ void Culture_Generator::generate (void)
 
 
 	float maxAlt = (float) Executive::Instance().maxAltitude();
-	Logger::Instance().Log ("maximum altitude (unscaled) is %f\n", maxAlt);
+	LOG_DEBUG (LOG_AGENTS, "maximum altitude (unscaled) is %f\n", maxAlt);
 }
 
 // ==========================================================
@@ -155,9 +156,9 @@ void Culture_Generator::translate (int x, int y, cPoint& translated)
 	Params& params = Params::Instance();
 	Point p(x,y);
 
-	Logger::Instance().Log ("translate (%d,%d) into 3D space\n", x, y);
-	Logger::Instance().Log ("%d x pages, %d y pages\n", params.num_x_pages, params.num_y_pages);
-	Logger::Instance().Log ("page size is %d\n", params.page_size);
+	LOG_DEBUG (LOG_AGENTS, "translate (%d,%d) into 3D space\n", x, y);
+	LOG_DEBUG (LOG_AGENTS, "%d x pages, %d y pages\n", params.num_x_pages, params.num_y_pages);
+	LOG_DEBUG (LOG_AGENTS, "page size is %d\n", params.page_size);
 
 	float altitude = (float) Executive::Instance().getHeight(p);
 
@@ -173,12 +174,12 @@ void Culture_Generator::translate (int x, int y, cPoint& translated)
 	float total_x = (float) params.num_x_pages * (float) params.page_size;
 	float total_y = (float) params.num_y_pages * (float) params.page_size;
 
-	Logger::Instance().Log ("total of %f x-vertexes, and %f y-vertexes\n", total_x, total_y);
+	LOG_DEBUG (LOG_AGENTS, "total of %f x-vertexes, and %f y-vertexes\n", total_x, total_y);
 
 	float fractional_x = ((float) x / total_x);
 	float fractional_y = ((float) y / total_y);
 
-	Logger::Instance().Log ("fractional x = %f, fractional y = %f\n", fractional_x, fractional_y);
+	LOG_DEBUG (LOG_AGENTS, "fractional x = %f, fractional y = %f\n", fractional_x, fractional_y);
 
 	// entire map is translated so that the center is 0,0
 	// we divide the total length and width by 2, and subtract this from each coordinate
@@ -188,7 +189,7 @@ void Culture_Generator::translate (int x, int y, cPoint& translated)
 	float shifted_x = x - x_shift;
 	float shifted_y = y - y_shift;
 
-	Logger::Instance().Log ("x_shift = %f, y_shift = %f, shifted-x = %f, shifted-y = %f\n",
+	LOG_DEBUG (LOG_AGENTS, "x_shift = %f, y_shift = %f, shifted-x = %f, shifted-y = %f\n",
 		x_shift, y_shift, shifted_x, shifted_y);
 
 	translated.x = (shifted_x / params.page_size) * params.scale_x;
@@ -202,8 +203,8 @@ void Culture_Generator::translate (int x, int y, cPoint& translated)
 	translated.y = shifted_y * params.scale_z;
 #endif
 
-	Logger::Instance().Log ("scaling x by %d, scaling z by %d\n", params.scale_x, params.scale_z);
-	Logger::Instance().Log ("translated x,y = (%f, %f)\n", translated.x, translated.y);
+	LOG_DEBUG (LOG_AGENTS, "scaling x by %d, scaling z by %d\n", params.scale_x, params.scale_z);
+	LOG_DEBUG (LOG_AGENTS, "translated x,y = (%f, %f)\n", translated.x, translated.y);
 
 #if 0
 	float half_width = (params.num_x_pages / 2);
@@ -211,12 +212,12 @@ void Culture_Generator::translate (int x, int y, cPoint& translated)
 	x /= params.page_size;
 	y /= params.page_size;
 	
-	Logger::Instance().Log ("alt = %d, page_x = %d, page_y = %d\n", altitude, x, y);
+	LOG_DEBUG (LOG_AGENTS, "alt = %d, page_x = %d, page_y = %d\n", altitude, x, y);
 
 	float tx = (float) ((x * params.scale_x) - (half_width * params.scale_x));
 	float ty = (float) ((y * params.scale_z) - (half_height* params.scale_z));
 
-	Logger::Instance().Log ("tx = %f, ty = %f\n", tx, ty);
+	LOG_DEBUG (LOG_AGENTS, "tx = %f, ty = %f\n", tx, ty);
 
 	translated.x = tx;
 	translated.y = ty;
@@ -225,7 +226,7 @@ void Culture_Generator::translate (int x, int y, cPoint& translated)
 	float maxAlt = (float) Executive::Instance().maxAltitude();
 	float altScale = params.scale_y / maxAlt;
 
-	Logger::Instance().Log ("altitude scaling factor: %f, maxAlt = %f\n", altScale, maxAlt);
+	LOG_DEBUG (LOG_AGENTS, "altitude scaling factor: %f, maxAlt = %f\n", altScale, maxAlt);
 
 	translated.z = altitude * altScale;
 
@@ -326,9 +327,9 @@ void Culture_Generator::generate_textures (void)
 	texture -> SetSecondary(275, 251, indexOf(14), 255);
 
 	cPoint p;
-	Logger::Instance().Log ("first spike\n");
+	LOG_DEBUG (LOG_AGENTS, "first spike\n");
 	translate (250, 250, p);
-	Logger::Instance().Log ("second spike\n");
+	LOG_DEBUG (LOG_AGENTS, "second spike\n");
 	translate (275,250, p);
 }
 
@@ -360,7 +361,7 @@ Culture_Generator::max_gradient (int x, int y)
 		}
 	}
 
-	// Logger::Instance().Log ("max grad = %d\n", max);
+	// LOG_DEBUG (LOG_AGENTS, "max grad = %d\n", max);
 	return max;
 }
 
@@ -450,13 +451,13 @@ bool Culture_Generator::texture_blob (PointSet& points, int x, int y, int tex, i
 
 		if (! boundary.random_member (seed))
 		{
-			Logger::Instance().Log ("returning early from texture_blob\n");
+			LOG_DEBUG (LOG_AGENTS, "returning early from texture_blob\n");
 			return true;
 		}
 
 		bool found = false;
 		int attempts = 0;
-		int dir = rand() % 4;
+		int dir = Random::Current().nextInt(4);
 
 		// starting in a random direction, check cardinal neighbors
 		while ((!found) && attempts < 4)
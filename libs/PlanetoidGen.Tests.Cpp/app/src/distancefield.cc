@@ -0,0 +1,208 @@
+#include "distancefield.h"
+#include "params.h"
+#include "logger.h"
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+DistanceField::DistanceField (uint x, uint y)
+	: Image (x, y, STORAGE_U32, Params::Instance().storage_layout)
+{
+	empty = true;
+}
+
+// ===================================================================
+// transform1D -- squared distance transform of a sampled function
+//
+// Computes d[q] = min over p of ((q - p)^2 + f[p]) by tracking the lower
+// envelope of the parabolas rooted at each sample.  v holds the roots of
+// the parabolas in the envelope, z the boundaries between them.
+// ===================================================================
+void DistanceField::transform1D (const double *f, int n, double *d, int *v, double *z)
+{
+	const double inf = numeric_limits<double>::infinity();
+	int k = 0;
+
+	v[0] = 0;
+	z[0] = -inf;
+	z[1] = inf;
+
+	for (int q = 1; q < n; q++)
+	{
+		double s;
+
+		while (true)
+		{
+			int p = v[k];
+			s = ((f[q] + (double) q * q) - (f[p] + (double) p * p)) / (2.0 * q - 2.0 * p);
+
+			if ((s <= z[k]) && (k > 0))
+			{
+				k--;
+				continue;
+			}
+			break;
+		}
+
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = inf;
+	}
+
+	k = 0;
+	for (int q = 0; q < n; q++)
+	{
+		while (z[k + 1] < q)
+		{
+			k++;
+		}
+
+		int p = v[k];
+		d[q] = (double) (q - p) * (q - p) + f[p];
+	}
+}
+
+// ===================================================================
+// compute -- build the field from every cell carrying the source flag
+//
+// The column pass works on BLOCK columns at a time, gathered a row at a
+// time so the flags are read in order, and leaves the squared vertical
+// distances in the field itself; the row pass then finishes each row in
+// place.  Nothing the size of the map is allocated besides the field.
+// ===================================================================
+void DistanceField::compute (CellFlags& flags, uint8_t source)
+{
+	int x_size = GetXSize();
+	int y_size = GetYSize();
+	int longest = std::max (x_size, y_size);
+
+	// anything at least this far is farther than any cell on the map
+	const double far = 2.0 * (double) longest * longest + 1;
+
+	vector<double> column (longest + 1);
+	vector<double> result (longest + 1);
+	vector<int> v (longest + 1);
+	vector<double> z (longest + 2);
+	vector<uint32_t> line (std::max (x_size, BLOCK));
+
+	// one block of columns, each y_size long
+	vector<double> block ((size_t) BLOCK * y_size);
+
+	empty = (flags.count (source) == 0);
+
+	for (int x0 = 0; x0 < x_size; x0 += BLOCK)
+	{
+		int width = std::min (BLOCK, x_size - x0);
+
+		for (int y = 0; y < y_size; y++)
+		{
+			const uint8_t *cells = flags.row (y) + x0;
+
+			for (int b = 0; b < width; b++)
+			{
+				block[(size_t) b * y_size + y] = (cells[b] & source) ? 0 : far;
+			}
+		}
+
+		for (int b = 0; b < width; b++)
+		{
+			double *f = &block[(size_t) b * y_size];
+
+			transform1D (f, y_size, result.data(), v.data(), z.data());
+			std::copy (result.begin(), result.begin() + y_size, f);
+		}
+
+		// a column with no source stays at far, which is kept as UNBOUNDED;
+		// real vertical distances are below it on any map that fits
+		for (int y = 0; y < y_size; y++)
+		{
+			for (int b = 0; b < width; b++)
+			{
+				double dist = block[(size_t) b * y_size + y];
+				line[b] = (dist >= far) ? UNBOUNDED : (uint32_t) dist;
+			}
+
+			SetRow (y, x0, width, line.data());
+		}
+	}
+
+	for (int y = 0; y < y_size; y++)
+	{
+		GetRow (y, 0, x_size, line.data());
+
+		for (int x = 0; x < x_size; x++)
+		{
+			column[x] = (line[x] == UNBOUNDED) ? far : (double) line[x];
+		}
+
+		transform1D (column.data(), x_size, result.data(), v.data(), z.data());
+
+		for (int x = 0; x < x_size; x++)
+		{
+			line[x] = (uint32_t) std::min (result[x], (double) UNBOUNDED);
+		}
+
+		SetRow (y, 0, x_size, line.data());
+	}
+}
+
+// ===================================================================
+// distanceSq -- squared distance from a cell to the nearest source
+//
+// Returns INT_MAX when there are no source cells, and for anything at
+// least that far.
+// ===================================================================
+int DistanceField::distanceSq (int x, int y)
+{
+	if (empty)
+	{
+		return numeric_limits<int>::max();
+	}
+
+	return (int) std::min (Get (x, y), (unsigned long) numeric_limits<int>::max());
+}
+
+// ===================================================================
+// Export -- write the field as a greyscale image
+//
+// Distances are scaled so the farthest cell is white.  Returns false if
+// the file could not be written.
+// ===================================================================
+bool DistanceField::Export (const char *filename)
+{
+	uint x_size = GetXSize();
+	uint y_size = GetYSize();
+	unsigned long farthest = 0;
+
+	for (uint y = 0; y < y_size; y++)
+	{
+		for (uint x = 0; x < x_size; x++)
+		{
+			farthest = std::max (farthest, Get (x, y));
+		}
+	}
+
+	double limit = sqrt ((double) farthest);
+	if (limit == 0)
+	{
+		limit = 1;
+	}
+
+	Image out (x_size, y_size, STORAGE_U16);
+	out.SetMode (grey_8);
+
+	for (uint y = 0; y < y_size; y++)
+	{
+		for (uint x = 0; x < x_size; x++)
+		{
+			double dist = sqrt ((double) Get (x, y));
+			out.Set (x, y, (unsigned long) (dist / limit * 255));
+		}
+	}
+
+	LOG_INFO (LOG_TERRAIN, "writing distance field to %s, farthest cell %.1f\n", filename, limit);
+	return out.Write (filename);
+}
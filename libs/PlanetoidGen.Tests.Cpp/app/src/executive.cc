@@ -1,44 +1,73 @@
 #include "executive.h"
+#include "smoothkernel.h"
+#include "texturekernel.h"
 #include "logger.h"
 #include "agent.h"
 #include "params.h"
+#include "random.h"
+#include "threadpool.h"
+#include "pagequeue.h"
+#include "pyramid.h"
+#include "generationcontext.h"
+#include "heaptrack.h"
 #include <fstream>
 #include <sstream>
 #include <time.h>
 #include <deque>
 #include <limits>
+#include <algorithm>
 
 #include "MountainAgent.h"
 
 using namespace std;
 
+// most agent steps a deterministic batch may hold
+const int BATCH_LIMIT = 64;
+
+// while a deterministic batch runs, agents created by a worker are queued here
+static thread_local AgentList *pendingAgents = NULL;
+
+static const char *agent_type_names[NUM_AGENT_TYPES] =
+{
+	"shoreline", "mountain", "smooth", "river", "erosion", "hill"
+};
+
 Executive::Executive ()
 {
 	Params& params = Params::Instance();
 
 	mask = NULL;
+	metrics = &Metrics::Instance();
+	trace = Trace::Current();
 
 	map = new Heightmap(params.x_size, params.y_size);
 	map -> SetMode (rgba_8);
-	map -> SetName("./split/mapgen3.");
+	map -> SetName("./split/" + params.output_prefix + "mapgen3.");
 	map -> SetFormat(params.format);
 
+	flags.allocate(params.x_size, params.y_size);
+	coastDistance = NULL;
+
 	texture = new Index(params.x_size, params.y_size);
-	texture -> SetName("./split/mapgen3.Index.");
+	texture -> SetName("./split/" + params.output_prefix + "mapgen3.Index.");
 	texture -> SetFormat(params.format);
 
 	// There are currently 16 textures in the atlas
 	atlas_size = 16;
 
 	numMountainAgents = 0;
-	for (int i = 0; i < params.x_size; i++)
-	{
-		for (int j = 0; j < params.y_size; j++)
-		{
-			texture->SetPrimary(i, j, indexOf(1), 255);
-			texture->SetSecondary(i, j, indexOf(1), 255);
-		}
-	}
+	inFlight = 0;
+
+	runnable.setWeight(MOUNTAIN_AGENT, params.mountain_weight);
+	runnable.setWeight(SHORELINE_AGENT, params.beach_weight);
+	runnable.setWeight(SMOOTH_AGENT, params.smooth_weight);
+	runnable.setWeight(HILL_AGENT, params.hill_weight);
+	runnable.setWeight(RIVER_AGENT, params.river_weight);
+	runnable.setWeight(EROSION_AGENT, params.river_weight);
+
+	// everything starts as the first texture; a sparse index stores none of it
+	texture->FillTexture(indexOf(1), 255);
+	metrics->count(COUNT_CELLS_WRITTEN, (uint64_t) params.x_size * params.y_size);
 
 #if 0
 	Point p(3,144);
@@ -46,10 +75,34 @@ Executive::Executive ()
 #endif
 }
 
+Executive::~Executive ()
+{
+	for (unsigned int i = 0; i < agents.size(); i++)
+	{
+		delete agents[i];
+	}
+
+	delete texture;
+	delete coastDistance;
+	delete map;
+}
+
 std::unique_ptr<Executive> Executive::_instance;
 
+// ===================================================================
+// Instance -- the bound context's Executive
+//
+// Code running outside a context shares a process-wide one.
+// ===================================================================
 Executive& Executive::Instance()
 {
+	GenerationContext *context = GenerationContext::Current();
+
+	if (context != NULL)
+	{
+		return context->getExecutive();
+	}
+
 	if (_instance.get() == NULL)
 	{
 		_instance.reset (new Executive);
@@ -124,7 +177,7 @@ bool Executive::random_land(Point &point)
 {
 	if (mask == NULL)
 	{
-		Logger::Instance().Log ("Executive::random_land: no mask assigned, aborting run\n");
+		LOG_ERROR (LOG_GENERAL, "Executive::random_land: no mask assigned, aborting run\n");
 		exit (-1);
 	}
 
@@ -145,10 +198,10 @@ bool Executive::random_boundary(Point& point, int maxAltitude)
 		return false;
 	}
 
-	int pos = rand() % coastline.size();
+	int pos = Random::Current().nextInt(coastline.size());
 	if (! coastline.position(pos))
 	{
-		Logger::Instance().Log ("unable to position coastline iterator at %d\n", pos);
+		LOG_WARN (LOG_GENERAL, "unable to position coastline iterator at %d\n", pos);
 		exit (1);
 	}
 
@@ -187,16 +240,13 @@ Executive::randomMountainAgent ()
 {
 	if (mountainAgents.size() == 0)
 	{
-		Logger::Instance().Log ("random_mountain: no mountain agents\n");
+		LOG_WARN (LOG_GENERAL, "random_mountain: no mountain agents\n");
 		return nullptr;
 	}
 
-	int pos = rand() % mountainAgents.size();
+	int pos = Random::Current().nextInt(mountainAgents.size());
 
-	AgentSet::iterator i = mountainAgents.begin();
-	std::advance(i, pos);
-
-	MountainAgent *agent = (MountainAgent*) *i;
+	MountainAgent *agent = (MountainAgent*) mountainAgents[pos];
 	return agent;
 }
 
@@ -208,7 +258,7 @@ bool Executive::on_land (Point& point)
 {
 	if (mask == NULL)
 	{
-		Logger::Instance().Log ("Executive::on_land: no mask assigned, aborting run\n");
+		LOG_ERROR (LOG_GENERAL, "Executive::on_land: no mask assigned, aborting run\n");
 		exit (-1);
 	}
 
@@ -230,12 +280,12 @@ bool Executive::on_shore(Point &point)
 {
 	if (mask == NULL)
 	{
-		Logger::Instance().Log ("Executive::on_shore: no mask assigned, aborting run\n");
+		LOG_ERROR (LOG_GENERAL, "Executive::on_shore: no mask assigned, aborting run\n");
 		exit (-1);
 	}
 
 	// return mask->on_boundary(point.x, point.y);
-	return coastline.in_set(point.x, point.y);
+	return flags.test(point.x, point.y, CELL_COASTLINE);
 }
 
 // ===================================================================
@@ -257,20 +307,20 @@ void Executive::identifyCoastline ()
 
 	if (! onMap(p))
 	{
-		Logger::Instance().Log ("cannot place initial water point\n");
+		LOG_WARN (LOG_GENERAL, "cannot place initial water point\n");
 		exit (1);
 	}
 
 	deque<Point> openVertices;
 	openVertices.push_back(p);
 
-	ocean.insert(p);
+	flags.set(p.x, p.y, CELL_OCEAN);
 
 	while (! openVertices.empty())
 	{
 		Point p = openVertices.front();
 		openVertices.pop_front();
-		ocean.insert(p);
+		flags.set(p.x, p.y, CELL_OCEAN);
 
 		for (int dir = 0; dir < 8; dir++)
 		{
@@ -285,7 +335,7 @@ void Executive::identifyCoastline ()
 			}
 
 			// don't visit points more than once
-			if (ocean.in_set(adjacent))
+			if (flags.test(adjacent.x, adjacent.y, CELL_OCEAN))
 			{
 				continue;
 			}
@@ -293,13 +343,16 @@ void Executive::identifyCoastline ()
 			if (on_land(adjacent))
 			{
 				// adjacent to an open water
-				coastline.insert(adjacent);
-				//ocean.insert(adjacent);
+				if (! flags.test(adjacent.x, adjacent.y, CELL_COASTLINE))
+				{
+					flags.set(adjacent.x, adjacent.y, CELL_COASTLINE);
+					coastline.insert(adjacent);
+				}
 			}
 			else
 			{
 				// open ocean
-				ocean.insert(adjacent);
+				flags.set(adjacent.x, adjacent.y, CELL_OCEAN);
 				openVertices.push_back(adjacent);
 			}
 		}
@@ -310,14 +363,14 @@ void Executive::identifyCoastline ()
 	int count = 0;
 	while (coastline.Iterate_Next(p))
 	{
-		Logger::Instance().Log (" (%d,%d) ", p.x, p.y);
+		LOG_TRACE (LOG_GENERAL, " (%d,%d) ", p.x, p.y);
 		if (count++ % 10 == 9)
 		{
-			Logger::Instance().Log ("\n");
+			LOG_TRACE (LOG_GENERAL, "\n");
 		}
 	}
 
-	Logger::Instance().Log ("\n");
+	LOG_TRACE (LOG_GENERAL, "\n");
 #endif
 }
 
@@ -333,7 +386,7 @@ bool Executive::onMaskBoundary(Point& p)
 		return false;
 	}
 
-	if (coastline.in_set(p))
+	if (flags.test(p.x, p.y, CELL_COASTLINE))
 	{
 		return false;
 	}
@@ -343,7 +396,7 @@ bool Executive::onMaskBoundary(Point& p)
 	{
 		StepDir(p, next, dir);
 
-		if (coastline.in_set(next))
+		if (flags.test(next.x, next.y, CELL_COASTLINE))
 		{
 			continue;
 		}
@@ -361,19 +414,32 @@ void Executive::addAgent(Agent *a)
 {
 	AgentType type = a->getType();
 
+	// committed in order once the batch completes
+	if (pendingAgents != NULL)
+	{
+		pendingAgents->push_back(a);
+		return;
+	}
+
+	traceAgent ("added", a);
+
+	std::lock_guard<std::mutex> guard (scheduleLock);
+
+	agents.push_back(a);
+
 	// defer running river agents
 	switch (type)
 	{
 	case EROSION_AGENT:
 	case RIVER_AGENT:
-		riverAgents.insert(a);
+		runnable.defer(a);
 		break;
 	case MOUNTAIN_AGENT:
-		mountainAgents.insert(a);
-		runnable.insert(a);
+		mountainAgents.push_back(a);
+		runnable.add(a);
 		break;
 	default:
-		runnable.insert(a);
+		runnable.add(a);
 		break;
 	}
 }
@@ -389,8 +455,9 @@ void Executive::agentCompleted (Agent *a)
 	AgentType type = a->getType();
 
 	a->setRunnable(false);
+	traceAgent ("completed", a);
 
-	// Logger::Instance().Log ("%s completing\n", a->getName().c_str());
+	// LOG_DEBUG (LOG_GENERAL, "%s completing\n", a->getName().c_str());
 #if 0
 	switch (type)
 	{
@@ -398,40 +465,40 @@ void Executive::agentCompleted (Agent *a)
 		if (! anyRunnable (mountainAgents))
 		{
 			// the last mountain agent has completed
-			Logger::Instance().Log ("no runnable MountainAgents, starting RiverAgents\n");
-			makeRunnable (riverAgents);
+			LOG_INFO (LOG_GENERAL, "no runnable MountainAgents, starting RiverAgents\n");
+			runnable.release ();
 			return;
 		}
 		else
 		{
-			Logger::Instance().Log ("still runnable MountainAgents\n");
+			LOG_DEBUG (LOG_GENERAL, "still runnable MountainAgents\n");
 		}
 	}
 #endif
-	static bool one_time = true;
-
-	if (one_time && (runnable.size() == 0))
+	if (! runnable.isReleased() && runnable.empty() && (inFlight == 0))
 	{
-		Logger::Instance().Log ("starting river agent\n");
-		makeRunnable (riverAgents);
-		one_time = false;
+		LOG_INFO (LOG_GENERAL, "starting river agent\n");
+		runnable.release ();
+
+		if (trace != NULL)
+		{
+			trace->instant ("schedule", "river phase released");
+		}
 	}
 }
 
 // ===================================================================
 // determine if any agents in a set are runnable
 // ===================================================================
-bool Executive::anyRunnable(AgentSet& agents)
+bool Executive::anyRunnable(AgentList& agents)
 {
-	AgentSet::iterator iter;
-
-	for (iter = agents.begin(); iter != agents.end(); ++iter)
+	for (unsigned int i = 0; i < agents.size(); i++)
 	{
-		Agent *a = *iter;
+		Agent *a = agents[i];
 
 		if (a ->isRunnable())
 		{
-			Logger::Instance().Log ("%s is still runnable\n", a->getName().c_str());
+			LOG_DEBUG (LOG_GENERAL, "%s is still runnable\n", a->getName().c_str());
 			return true;
 		}
 	}
@@ -442,16 +509,14 @@ bool Executive::anyRunnable(AgentSet& agents)
 // ===================================================================
 // mark all agents in a set as runnable
 // ===================================================================
-void Executive::makeRunnable(AgentSet& agents)
+void Executive::makeRunnable(AgentList& agents)
 {
-	AgentSet::iterator iter;
-
-	for (iter = agents.begin(); iter != agents.end(); ++iter)
+	for (unsigned int i = 0; i < agents.size(); i++)
 	{
-		Agent *a = *iter;
+		Agent *a = agents[i];
 
 		a ->setRunnable(true);
-		runnable.insert(a);
+		runnable.add(a);
 	}
 }
 
@@ -461,7 +526,7 @@ void Executive::makeRunnable(AgentSet& agents)
 bool Executive::findInterior (Point& point, int distance)
 {
 	Point p;
-	int direction = rand() % 8;
+	int direction = Random::Current().nextInt(8);
 
 	for (int i = 0; i < 8; i++)
 	{
@@ -490,11 +555,11 @@ Executive::printArea(Point &point)
 			int height = getHeight(p);
 
 			if (mask->on_boundary(p.x, p.y))
-				Logger::Instance().Log ("+");
+				LOG_DEBUG (LOG_GENERAL, "+");
 			else
-				Logger::Instance().Log (".");
+				LOG_DEBUG (LOG_GENERAL, ".");
 		}
-		Logger::Instance().Log ("\n");
+		LOG_DEBUG (LOG_GENERAL, "\n");
 	}
 
 	for (int j = -2; j < 4; j++)
@@ -504,9 +569,9 @@ Executive::printArea(Point &point)
 			Point p(point.x + i, point.y + j);
 			int height = getHeight(p);
 
-			Logger::Instance().Log ("%05d ", height);
+			LOG_DEBUG (LOG_GENERAL, "%05d ", height);
 		}
-		Logger::Instance().Log ("\n");
+		LOG_DEBUG (LOG_GENERAL, "\n");
 	}
 }
 
@@ -530,16 +595,17 @@ void Executive::setHeight(Point &p, unsigned long alt)
 
 	if (isWatched(p))
 	{
-		Logger::Instance().Log ("*** set height of %d,%d as %d\n", p.x, p.y, alt);
+		LOG_DEBUG (LOG_GENERAL, "*** set height of %d,%d as %d\n", p.x, p.y, alt);
 	}
 
 	if (! isFixed(p))
 	{
 		map->Set(p.x, p.y, alt);
+		metrics->count(COUNT_CELLS_WRITTEN);
 	}
 	else if (isWatched(p))
 	{
-		Logger::Instance().Log ("point %d,%d is watched/fixed, cannot change altitude\n", p.x, p.y);
+		LOG_DEBUG (LOG_GENERAL, "point %d,%d is watched/fixed, cannot change altitude\n", p.x, p.y);
 	}
 }
 
@@ -556,17 +622,17 @@ void Executive::texturePoint (Point& p, int texture_id)
 
 	if (isWatched(p))
 	{
-		Logger::Instance().Log ("*** texture %d,%d as %d\n", p.x, p.y, texture_id);
+		LOG_DEBUG (LOG_GENERAL, "*** texture %d,%d as %d\n", p.x, p.y, texture_id);
 	}
 
 	if (! isFixed(p))
 	{
-		texture->SetPrimary(p.x, p.y, indexOf(texture_id), 255);
-		texture->SetSecondary(p.x, p.y, indexOf(texture_id), 255);
+		texture->SetTexture(p.x, p.y, indexOf(texture_id), 255);
+		metrics->count(COUNT_CELLS_WRITTEN);
 	}
 	else if (isWatched(p))
 	{
-		Logger::Instance().Log ("point %d,%d is fixed, cannot texture\n", p.x, p.y);
+		LOG_DEBUG (LOG_GENERAL, "point %d,%d is fixed, cannot texture\n", p.x, p.y);
 	}
 }
 
@@ -710,12 +776,15 @@ void Executive::assignArea(Point &point, int altitude)
 
 void Executive::fixArea(Point &point)
 {
-	SetInsertOp op(&fixed_points);
+	FixPointOp op;
 	operateArea (point, op);
 }
 
 // ===================================================================
 // calculate a weighted average of nearby points
+//
+// Points on the map read their neighbours without range checks, the
+// heightmap's halo covers the two cells the stencil reaches past an edge.
 // ===================================================================
 unsigned long Executive::weightedAverageHeight (Point& point)
 {
@@ -725,6 +794,19 @@ unsigned long Executive::weightedAverageHeight (Point& point)
 	int x = point.x;
 	int y = point.y;
 
+	if ((map->Halo() >= 2) && map->in_range(x, y))
+	{
+		Heightmap& h = *map;
+
+		sum = 4 * h.GetUnchecked (x, y)
+			+ h.GetUnchecked (x + 1, y) + h.GetUnchecked (x - 1, y)
+			+ h.GetUnchecked (x + 2, y) + h.GetUnchecked (x - 2, y)
+			+ h.GetUnchecked (x, y + 1) + h.GetUnchecked (x, y - 1)
+			+ h.GetUnchecked (x, y + 2) + h.GetUnchecked (x, y - 2);
+
+		return sum / 12;
+	}
+
 	sum = 4 * getHeight (current);
 
 	current.x = x + 1;
@@ -758,33 +840,86 @@ unsigned long Executive::weightedAverageHeight (Point& point)
 
 // ===================================================================
 // split the heightmap, and write out pages
+//
+// Returns false if any file could not be written; what was written is
+// left in place.
 // ===================================================================
 
-void Executive::writeHeightmap()
+bool Executive::writeHeightmap()
 {
 	Params& params = Params::Instance();
+	string prefix = params.output_prefix;
+	bool written = true;
+
+	const HeightStats& stats = map -> Stats ();
+	LOG_INFO (LOG_GENERAL, "heights %lu to %lu, mean %.1f, %ld of %ld cells land (%s kernels)\n",
+		stats.lowest, stats.highest, stats.mean, stats.land, stats.cells, HeightStats::kernelName());
+
+	// raw heights go out at full precision, before the map is scaled for the images
+	if (params.raw_format != RAW_NONE)
+	{
+		string filename = prefix + "height_full" + Image::RawExtension (params.raw_format);
+
+		written &= map -> WriteRaw (filename.c_str(), params.raw_format, params.raw_header);
+		written &= map -> SplitImage (params.page_size, params.raw_format, params.raw_header);
+	}
 
 	switch (params.format)
 	{
 		case FORMAT_PNG:
 			map ->Scale(30000);
-			map -> Write ("height_full.png");
+			written &= map -> Write ((prefix + "height_full.png").c_str());
 			break;
 		case FORMAT_JPG:
 
-			map -> Write ("height_full.jpg");
+			written &= map -> Write ((prefix + "height_full.jpg").c_str());
 			break;
 		case FORMAT_TGA:
 			map -> SetMode (grey_8);
 			map ->Scale(255);
-			map -> Write ("heightmap.tga");
+			written &= map -> Write ((prefix + "heightmap.tga").c_str());
 			break;
 	}
-	Logger::Instance().Log ("writing map\n");
+	LOG_INFO (LOG_GENERAL, "writing map\n");
+
+	if (params.write_coast_distance)
+	{
+		written &= coastDistanceField().Export ((prefix + "coast_distance.png").c_str());
+	}
+
 	generate_plsm_cfg ();
-	map -> SplitImage (params.page_size);
+
+	// the reduced levels are built before any page goes out, they all share the pool
+	Pyramid pyramid (*map, *texture, params.lod_levels);
+	pyramid.build ();
+
+	// height and index pages share one queue, so they are written side by side
+	PageQueue pages;
+
+	map -> SplitImage (params.page_size, pages);
 	//texture->SetMode(lum_16);
-	texture -> SplitImage(params.page_size);
+	texture -> SplitImage (params.page_size, pages);
+	pyramid.split (params.page_size, pages);
+	written &= pages.finish ();
+
+	if (map -> GetTileCache() != NULL)
+	{
+		LOG_INFO (LOG_GENERAL, "heightmap tiles: %ld faults, %ld evictions\n",
+			map -> GetTileCache() -> getFaults(), map -> GetTileCache() -> getEvictions());
+		LOG_INFO (LOG_GENERAL, "index tiles: %ld faults, %ld evictions\n",
+			texture -> GetTileCache() -> getFaults(), texture -> GetTileCache() -> getEvictions());
+	}
+
+	if (map -> GetLayout() == LAYOUT_SPARSE)
+	{
+		long tiles = (long) ((map -> GetXSize() + ImageBuffer::TILE - 1) / ImageBuffer::TILE)
+			* ((map -> GetYSize() + ImageBuffer::TILE - 1) / ImageBuffer::TILE);
+
+		LOG_INFO (LOG_GENERAL, "sparse tiles in use: heightmap %ld of %ld, index %ld of %ld\n",
+			map -> MaterializedTiles(), tiles, texture -> MaterializedTiles(), tiles);
+	}
+
+	return written;
 }
 
 // ===================================================================
@@ -796,14 +931,14 @@ void Executive::generate_plsm_cfg ()
 	ofstream cfgFile;
 	ostringstream filename;
 
-	filename << "./split/mapgen3.cfg";
+	filename << "./split/" << params.output_prefix << "mapgen3.cfg";
 	cfgFile.open (filename.str().c_str());
 
 	cfgFile << "# run-time configuration file for terrain data-set " << params.name
 		<< std::endl << std::endl;
 
 	cfgFile << "GroupName=PLSM2" << std::endl << std::endl;
-	cfgFile << "LandScapeFileName=mapgen3" << std::endl;
+	cfgFile << "LandScapeFileName=" << params.output_prefix << "mapgen3" << std::endl;
 	cfgFile << "FileSystem=LandScapeFileName" << std::endl;
 	cfgFile << "LandScapeExtension=png" << std::endl << std::endl;
 
@@ -971,6 +1106,22 @@ int Executive::maxGradient (Point& point)
 
 	int h1 = getHeight (point);
 
+	// the eight neighbours of a point on the map are all in the halo
+	if ((map->Halo() >= 1) && map->in_range(point.x, point.y))
+	{
+		static const int dx[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+		static const int dy[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+		for (int i = 0; i < 8; i++)
+		{
+			int h2 = (int) map->GetUnchecked (point.x + dx[i], point.y + dy[i]);
+
+			max_grad = std::max (max_grad, abs (h1 - h2));
+		}
+
+		return max_grad;
+	}
+
 	for (int i = 0; i < 8; i++)
 	{
 		StepDir(point, p, i);
@@ -1067,7 +1218,7 @@ void Executive::findGradient (GradientType type, Point& center, Point& point, in
 			}
 			break;
 		default:
-			Logger::Instance().Log ("Invalid gradient type passed to findGradient\n");
+			LOG_ERROR (LOG_GENERAL, "Invalid gradient type passed to findGradient\n");
 			exit (-1);
 		}
 	}
@@ -1089,12 +1240,12 @@ int  Executive::directionFrom (Point& src, Point& target)
 	// same point
 	if ((dx == 0) && (dy == 0))
 	{
-		Logger::Instance().Log ("directionFrom same point (%d,%d) to (%d,%d)\n", src.x, src.y, target.x, target.y);
+		LOG_WARN (LOG_GENERAL, "directionFrom same point (%d,%d) to (%d,%d)\n", src.x, src.y, target.x, target.y);
 		exit (1);
 		return -1;
 	}
 
-//	Logger::Instance().Log ("direction from (%d,%d) to (%d,%d) has dx=%d, dy=%d\n", src.x, src.y, target.x, target.y, dx, dy);
+//	LOG_DEBUG (LOG_GENERAL, "direction from (%d,%d) to (%d,%d) has dx=%d, dy=%d\n", src.x, src.y, target.x, target.y, dx, dy);
 
 	if ((dx == 0) && (dy > 0)) 	{ return DIR_UP; }
 	if ((dx > 0) && (dy > 0)) 	{ return DIR_UR; }
@@ -1105,7 +1256,7 @@ int  Executive::directionFrom (Point& src, Point& target)
 	if ((dx < 0) && (dy == 0)) 	{ return DIR_LEFT; }
 	if ((dx < 0) && (dy > 0)) 	{ return DIR_UL; }
 
-	Logger::Instance().Log ("unable to find direction from dx %d, dy %d\n", dx, dy);
+	LOG_WARN (LOG_GENERAL, "unable to find direction from dx %d, dy %d\n", dx, dy);
 	exit (1);
 	return -1;
 }
@@ -1117,12 +1268,12 @@ void Executive::shock_map (int num_points)
 #if 0
 	for (int i = 0; i < num_points; i++)
 	{
-		int x = rand() % (params.x_size / 2) + (params.x_size / 4);
-		int y = rand() % (params.y_size / 2) + (params.y_size / 4);
+		int x = Random::Current().nextInt(params.x_size / 2) + (params.x_size / 4);
+		int y = Random::Current().nextInt(params.y_size / 2) + (params.y_size / 4);
 
-		if (rand() % 2 == 1)
+		if (Random::Current().nextInt(2) == 1)
 		{
-			int height = rand() % (params.height_limit / 2) + 1000;
+			int height = Random::Current().nextInt(params.height_limit / 2) + 1000;
 			randomBlob (x, y, height);
 		}
 		else
@@ -1141,14 +1292,14 @@ void Executive::shock_map (int num_points)
 			random_land(p);
 		} while (distanceToCoastline(p) < 1000);
 
-		int len = rand() % 500 + 400;
+		int len = Random::Current().nextInt(500) + 400;
 		for (int j = 0; j < len; j++)
 		{
 			setHeight (p, 14000);
 
 			do
 			{
-				int dir = rand() % 8;
+				int dir = Random::Current().nextInt(8);
 				StepDir (p, p, dir);
 			} while (! on_land(p));
 		}
@@ -1161,7 +1312,7 @@ void Executive::randomBlob (int x, int y, int height)
 
 	int area = params.x_size * params.y_size;
 	int max_size = (area / 10) + 1;
-	int steps = rand() % max_size;
+	int steps = Random::Current().nextInt(max_size);
 
 	Point p(x, y);
 
@@ -1170,7 +1321,7 @@ void Executive::randomBlob (int x, int y, int height)
 		Point next;
 
 		setHeight(p, height);
-		int dir = rand() % 8;
+		int dir = Random::Current().nextInt(8);
 
 		do
 		{
@@ -1187,15 +1338,22 @@ void Executive::Setup()
 {
 	Params& params = Params::Instance();
 
-	Logger::Instance().Log ("starting coastline walk at %s\n", currentTime().c_str());
-	identifyCoastline();
-	Logger::Instance().Log ("ending coastline walk at %s\n", currentTime().c_str());
+	LOG_INFO (LOG_GENERAL, "starting coastline walk at %s\n", currentTime().c_str());
+	{
+		PhaseTimer timer ("coastline");
+		identifyCoastline();
+	}
+	LOG_INFO (LOG_GENERAL, "ending coastline walk at %s\n", currentTime().c_str());
+	LOG_INFO (LOG_GENERAL, "%d coastline points, %ld ocean cells\n", coastline.size(), flags.count(CELL_OCEAN));
 
-	Logger::Instance().Log ("starting randomization at %s\n", currentTime().c_str());
+	LOG_INFO (LOG_GENERAL, "starting randomization at %s\n", currentTime().c_str());
 
 	// create some noise over the landmass
-	map->randomize (params.noise_size);
-	Logger::Instance().Log ("ending randomization at %s\n", currentTime().c_str());
+	{
+		PhaseTimer timer ("randomize");
+		map->randomize (params.noise_size);
+	}
+	LOG_INFO (LOG_GENERAL, "ending randomization at %s\n", currentTime().c_str());
 
 //	int area = params.x_size * params.y_size;
 //	shock_map (area / 2000);
@@ -1203,55 +1361,55 @@ void Executive::Setup()
 
 void Executive::PostRun ()
 {
-	Params& params = Params::Instance();
+	PhaseTimer timer ("postrun");
 
-	for (int i = 0; i < params.x_size; i++)
-	{
-		for (int j = 0; j < params.y_size; j++)
-		{
-			Point p(i,j);
-			smoothPoint(p);
-		}
-	}
-	unsigned int maxAlt = maxAltitude();
-	unsigned int minAlt = minAltitude();
+	// a final smoothing sweep, which also finds the range of the map
+	SmoothKernel smoother (*map, flags);
+	smoother.sweepRowsParallel (0, map->GetYSize());
+
+	unsigned int maxAlt = smoother.maxSeen();
+	unsigned int minAlt = smoother.minSeen();
 	unsigned int snowline = maxAlt - 5000;
 	int dirtline = 2000;
 
-	Logger::Instance().Log ("max alt = %d, snowline at %d, dirt begins at %d\n", maxAlt, snowline, dirtline);
-	Logger::Instance().Log ("min alt = %d\n", minAlt);
-
-	for (int i = 0; i < params.x_size; i++)
-	{
-		for (int j = 0; j < params.y_size; j++)
-		{
-			Point p(i,j);
+	LOG_INFO (LOG_GENERAL, "max alt = %d, snowline at %d, dirt begins at %d\n", maxAlt, snowline, dirtline);
+	LOG_INFO (LOG_GENERAL, "min alt = %d\n", minAlt);
+	LOG_INFO (LOG_GENERAL, "%ld fixed points\n", flags.count(CELL_FIXED));
+
+	TextureRule rule;
+	rule.snowline = (int) snowline;
+	rule.rock_gradient = 400;
+	rule.dirtline = dirtline;
+	rule.snow = TextureKernel::pack (indexOf (TEXTURE_SNOW));
+	rule.rock = TextureKernel::pack (indexOf (TEXTURE_ROCK1));
+	rule.dirt = TextureKernel::pack (indexOf (TEXTURE_DIRT3));		// kind of sandy
+	rule.grass = TextureKernel::pack (indexOf (TEXTURE_GRASS2));
+
+	TextureKernel classifier (*map, *texture, flags);
+	classifier.classifyParallel (rule);
+}
 
-			if (isFixed(p))
-				continue;
+// ===================================================================
+// coastDistanceField -- the coastline distance field, built on first use
+//
+// Only agents which care about the coast ask for it, so a map without
+// them never pays for the field.  Agents on the workers may race to be
+// first; the others wait for the one building it.
+// ===================================================================
 
-			int height = getHeight(p);
+DistanceField& Executive::coastDistanceField ()
+{
+	std::call_once (coastDistanceBuilt, [this] ()
+	{
+		PhaseTimer timer ("distance_field");
+		HeapScope heap (HEAP_IMAGE);
 
-			int grad = maxGradient(p);
+		coastDistance = new DistanceField(flags.GetXSize(), flags.GetYSize());
+		coastDistance->compute(flags, CELL_COASTLINE);
+		LOG_INFO (LOG_GENERAL, "coastline distance field built at %s\n", currentTime().c_str());
+	});
 
-			if (height > (int) snowline)
-			{
-				texturePoint(p, TEXTURE_SNOW);
-			}
-			else if (grad > 400)
-			{
-				texturePoint (p, TEXTURE_ROCK1);
-			}
-			else if (height < dirtline)
-			{
-				texturePoint(p, TEXTURE_DIRT3);		// kind of sandy
-			}
-			else
-			{
-				texturePoint(p, TEXTURE_GRASS2);
-			}
-		}
-	}
+	return *coastDistance;
 }
 
 // ===================================================================
@@ -1263,8 +1421,20 @@ int Executive::distanceSq(Point& p1, Point& p2)
 	return (p1.x - p2.x)*(p1.x - p2.x) + (p1.y - p2.y)*(p1.y - p2.y);
 }
 
+// ===================================================================
+// Return the squared distance from a point to the nearest coastline cell
+//
+// Points on the map read the distance field; anything off the map falls
+// back to a scan of the coastline.
+// ===================================================================
+
 int Executive::distanceToCoastline (Point& p)
 {
+	if (flags.onGrid(p.x, p.y))
+	{
+		return coastDistanceField().distanceSq(p.x, p.y);
+	}
+
 	int minDistance = numeric_limits<int>::max();
 
 	coastline.Reset_Iterator();
@@ -1284,65 +1454,335 @@ int Executive::distanceToCoastline (Point& p)
 
 // ===================================================================
 // Simulate agent execution until no agents are runnable.
+//
+// With one thread agents run in turn.  With more, agents whose next steps
+// have a known footprint lease the tiles under it and run on the thread
+// pool; agents without one run alone.  Deterministic mode runs agents in
+// batches of disjoint footprints and commits each batch in pick order, so
+// the map does not depend on the number of threads.
 // ===================================================================
 
 void Executive::Run()
 {
+	Params& params = Params::Instance();
+
 	if (mask == NULL)
 	{
-		Logger::Instance().Log ("Executive::Run: no mask assigned, aborting run\n");
+		LOG_ERROR (LOG_GENERAL, "Executive::Run: no mask assigned, aborting run\n");
 		return;
 	}
 
-	while (runnable.size() > 0)
+	PhaseTimer timer ("run");
+
+	schedule = Random::Root().stream(STREAM_SCHEDULE);
+	leases.allocate(params.x_size, params.y_size, params.lease_tile);
+
+	if (params.deterministic)
+	{
+		runBatched();
+	}
+	else if ((ThreadPool::Instance().size() > 1) && ! ThreadPool::onPoolThread())
 	{
-		AgentSet::iterator iter;
-		AgentSet finished;
+		runParallel();
+	}
+	else
+	{
+		runSequential();
+	}
+}
 
-#if SEQUENTIAL_SCHEDULE
-		for (iter = runnable.begin(); iter != runnable.end(); ++iter)
-		{
-			Agent *agent = *iter;
+// ===================================================================
+// run a few steps of an agent, drawing from its own stream
+// ===================================================================
+bool Executive::executeAgent (Agent *agent, int steps)
+{
+	// each type's share of the run, summed over the threads it ran on
+	static const char *phases[NUM_AGENT_TYPES] =
+	{
+		"run.shoreline", "run.mountain", "run.smooth", "run.river", "run.erosion", "run.hill"
+	};
 
-			if (! agent->Execute())
-			{
-				// schedule for deletion
-				finished.insert(agent);
-			}
+	PhaseTimer timer (phases[agent->getType()], false);
+	HeapScope heap (HEAP_AGENTS);
+	RandomScope scope (agent->stream());
+	bool result = true;
+
+	// the area is the agent's own bound on what these steps touch
+	Rect area;
+	bool bounded = false;
+	uint64_t started = 0;
+
+	if (trace != NULL)
+	{
+		bounded = agent->footprint(steps, area);
+		started = trace->now();
+	}
+
+	for (int i = 0; i < steps; i++)
+	{
+		result = agent->Execute();
+	}
+
+	metrics->count(COUNT_AGENT_STEPS, steps);
+
+	if (trace != NULL)
+	{
+		char args[256];
+
+		if (bounded)
+		{
+			snprintf (args, sizeof (args), "\"type\": \"%s\", \"steps\": %d, \"tokens\": %u, \"finished\": %s, "
+				"\"area\": [%d, %d, %d, %d]", agent_type_names[agent->getType()], steps, agent->getTokens(),
+				result ? "false" : "true", area.x1, area.y1, area.x2, area.y2);
 		}
-#endif
-		iter = runnable.begin();
-		int pos = rand() % runnable.size();
-		std::advance(iter, pos);
-		Agent *agent = *iter;
+		else
+		{
+			snprintf (args, sizeof (args), "\"type\": \"%s\", \"steps\": %d, \"tokens\": %u, \"finished\": %s, "
+				"\"area\": null", agent_type_names[agent->getType()], steps, agent->getTokens(),
+				result ? "false" : "true");
+		}
+
+		trace->span ("agent", agent->getName(), started, trace->now(), args);
+	}
+
+	return result;
+}
+
+// ===================================================================
+// traceAgent -- mark an agent joining or leaving the pool on the timeline
+// ===================================================================
+void Executive::traceAgent (const char *event, Agent *a)
+{
+	if (trace == NULL)
+	{
+		return;
+	}
+
+	trace->instant ("schedule", std::string (event) + " " + a->getName(),
+		std::string ("\"type\": \"") + agent_type_names[a->getType()] + "\"");
+}
+
+// ===================================================================
+// prefetch -- an agent is about to work in area, page in what it will use
+//
+// Only tiled images do anything with the hint.
+// ===================================================================
+void Executive::prefetch (Rect& area)
+{
+	map -> Prefetch (area.x1, area.y1, area.x2, area.y2);
+	texture -> Prefetch (area.x1, area.y1, area.x2, area.y2);
+	mask -> Prefetch (area.x1, area.y1, area.x2, area.y2);
+}
+
+// ===================================================================
+// return an agent to the pool, or retire it if it has finished
+// ===================================================================
+void Executive::finishAgent (Agent *agent, bool result)
+{
+	if (result)
+	{
+		runnable.add(agent);
+	}
+	else
+	{
+		agentCompleted(agent);
+	}
+}
 
-		int run = rand() % 4;
-		bool result = true;
+void Executive::runSequential ()
+{
+	bool tiled = (Params::Instance().storage_layout == LAYOUT_TILED);
+
+	while (! runnable.empty())
+	{
+		Agent *agent = runnable.pick(schedule);
+
+		int run = schedule.nextInt(4);
+		Rect area;
 
-		for (int i = 0; i < run; i++)
+		if (tiled && agent->footprint(run, area))
 		{
-			result = agent->Execute();
+			prefetch(area);
 		}
 
-		if (! result)
+		if (! executeAgent(agent, run))
 		{
-			runnable.erase (agent);
+			runnable.remove (agent);
 			agentCompleted(agent);
 		}
+	}
+}
+
+// ===================================================================
+// runParallel -- hand agents to the thread pool as their tiles come free
+//
+// A running agent is out of the pool, so it cannot be picked twice.
+// ===================================================================
+void Executive::runParallel ()
+{
+	ThreadPool& pool = ThreadPool::Instance();
+	std::unique_lock<std::mutex> guard (scheduleLock);
 
-#if SEQUENTIAL
-		// clear out any agents which have finished running
-		for (iter = finished.begin(); iter != finished.end(); ++iter)
+	while (! runnable.empty() || (inFlight > 0))
+	{
+		if (runnable.empty())
 		{
-			Agent *agent = *iter;
+			agentDone.wait (guard);
+			continue;
+		}
 
-			runnable.erase(agent);
-			agentCompleted(agent);
-			//delete agent;
+		Agent *agent = runnable.pick(schedule);
+		int run = schedule.nextInt(4);
+		Rect area;
+
+		if (! agent->footprint(run, area))
+		{
+			// unbounded, wait for everyone else to stop and run it here
+			agentDone.wait (guard, [this] {return inFlight == 0;});
+
+			runnable.remove(agent);
+			guard.unlock();
+			bool result = executeAgent(agent, run);
+			guard.lock();
+
+			finishAgent(agent, result);
+			continue;
+		}
+
+		if (! leases.acquire(area))
+		{
+			// only running agents hold leases, so one will finish
+			agentDone.wait (guard);
+			continue;
 		}
 
-		finished.clear();
+		runnable.remove(agent);
+		inFlight++;
+		prefetch(area);
+
+		pool.submit ([this, agent, run, area] () mutable
+		{
+			bool result = executeAgent(agent, run);
+
+			std::lock_guard<std::mutex> done (scheduleLock);
+			leases.release(area);
+			inFlight--;
+			finishAgent(agent, result);
+			agentDone.notify_all();
+		});
 	}
-#endif
+}
+
+// ===================================================================
+// runBatched -- run agents in deterministic batches
+//
+// Picks are drawn exactly as in a sequential run and added to the batch
+// until one overlaps the batch, has no footprint, or the batch is full.
+// That pick starts the next batch.  Agents created during a batch, and
+// agents finishing in it, are committed in pick order afterwards.
+// ===================================================================
+void Executive::runBatched ()
+{
+	typedef struct
+	{
+		Agent *agent;
+		int run;
+		Rect area;
+		bool result;
+		AgentList spawned;
+	} BatchEntry;
+
+	ThreadPool& pool = ThreadPool::Instance();
+	std::vector<BatchEntry> batch;
+
+	Agent *held = NULL;						// the pick which ended the last batch
+	int heldRun = 0;
+
+	while ((held != NULL) || ! runnable.empty())
+	{
+		batch.clear();
+
+		while ((int) batch.size() < BATCH_LIMIT)
+		{
+			Agent *agent;
+			int run;
+
+			if (held != NULL)
+			{
+				agent = held;
+				run = heldRun;
+				held = NULL;
+			}
+			else if (! runnable.empty())
+			{
+				agent = runnable.pick(schedule);
+				run = schedule.nextInt(4);
+			}
+			else
+			{
+				break;
+			}
+
+			Rect area;
+			bool bounded = agent->footprint(run, area);
+
+			if (bounded && leases.acquire(area))
+			{
+				prefetch(area);
+				batch.push_back ({agent, run, area, true, AgentList()});
+				continue;
+			}
+
+			if (! batch.empty())
+			{
+				held = agent;
+				heldRun = run;
+				break;
+			}
+
+			// unbounded with nothing else pending, run it alone
+			if (! executeAgent(agent, run))
+			{
+				runnable.remove (agent);
+				agentCompleted(agent);
+			}
+			break;
+		}
+
+		pool.parallelFor (batch.size(), [this, &batch] (int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				BatchEntry& entry = batch[i];
+
+				pendingAgents = &entry.spawned;
+				entry.result = executeAgent(entry.agent, entry.run);
+				pendingAgents = NULL;
+			}
+		});
+
+		for (unsigned int i = 0; i < batch.size(); i++)
+		{
+			BatchEntry& entry = batch[i];
+
+			leases.release(entry.area);
+
+			for (unsigned int j = 0; j < entry.spawned.size(); j++)
+			{
+				addAgent(entry.spawned[j]);
+			}
+
+			if (! entry.result)
+			{
+				runnable.remove (entry.agent);
+				agentCompleted(entry.agent);
+			}
+		}
+
+		// the held pick may have been the last step of an agent in the batch
+		if ((held != NULL) && (held->getSlot() < 0))
+		{
+			held = NULL;
+		}
 	}
 }
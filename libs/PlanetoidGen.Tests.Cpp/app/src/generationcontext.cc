@@ -0,0 +1,112 @@
+#include "generationcontext.h"
+#include "executive.h"
+#include "WaterModel.h"
+#include "logger.h"
+#include "map.h"
+#include <stdlib.h>
+
+static thread_local GenerationContext *current = NULL;
+
+GenerationContext::GenerationContext (const Params& p)
+	: params (p), root (p.seed)
+{
+	logfile = NULL;
+
+	if (! params.trace.empty())
+	{
+		trace.reset (new Trace);
+	}
+}
+
+GenerationContext::~GenerationContext ()
+{
+	// the executive and agents may log while they are torn down
+	ContextScope scope (this);
+
+	water.reset ();
+	executive.reset ();
+	mask.reset ();
+	logger.reset ();
+
+	if (logfile != NULL)
+	{
+		fclose (logfile);
+	}
+}
+
+GenerationContext *GenerationContext::Current ()
+{
+	return current;
+}
+
+// ===================================================================
+// Bind -- make a context current on this thread, returning the old one
+// ===================================================================
+GenerationContext *GenerationContext::Bind (GenerationContext *context)
+{
+	GenerationContext *previous = current;
+	current = context;
+	return previous;
+}
+
+// ===================================================================
+// getExecutive -- the context's Executive, created on first use
+//
+// The Executive sizes itself from Params::Instance(), so it is built with
+// this context bound.
+// ===================================================================
+Executive& GenerationContext::getExecutive ()
+{
+	if (executive.get() == NULL)
+	{
+		ContextScope scope (this);
+		executive.reset (new Executive);
+	}
+
+	return *executive;
+}
+
+WaterModel& GenerationContext::getWaterModel ()
+{
+	if (water.get() == NULL)
+	{
+		ContextScope scope (this);
+		water.reset (new WaterModel);
+	}
+
+	return *water;
+}
+
+// ===================================================================
+// createMask -- a new, empty mask the size of the map
+// ===================================================================
+Map& GenerationContext::createMask ()
+{
+	mask.reset (new Map (params.x_size, params.y_size));
+	return *mask;
+}
+
+// ===================================================================
+// openLog -- give this context a log file of its own
+//
+// Without one, the context logs to the process-wide log.  Returns false
+// if the file cannot be opened; this may run on a pool worker, so the
+// caller decides what to do about it.
+// ===================================================================
+bool GenerationContext::openLog (const std::string& filename)
+{
+	FILE *f = fopen (filename.c_str(), "w");
+
+	if (f == NULL)
+	{
+		perror (filename.c_str());
+		return false;
+	}
+
+	logger.reset (new Logger);
+	logger->SetLevel (params.log_level);
+	logger->SetCategories (params.log_categories);
+	logger->SetLog (f);
+	logfile = f;
+	return true;
+}
@@ -0,0 +1,220 @@
+#include "heaptrack.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <new>
+
+// in front of every block operator new hands out; 16 bytes keeps the
+// block as aligned as malloc's
+typedef struct
+{
+	uint64_t size;
+	uint32_t subsystem;						// UNTRACKED if it was not counted
+	uint32_t unused;
+} Header;
+
+static const uint32_t UNTRACKED = 0xffffffff;
+
+static const char *subsystem_names[HEAP_SUBSYSTEMS] =
+{
+	"other", "pointset", "image", "agents", "water", "writer"
+};
+
+// constant initialized, so allocations made before main are safe
+static std::atomic<bool> enabled (false);
+static HeapCounters total;
+static HeapCounters subsystems[HEAP_SUBSYSTEMS];
+
+static thread_local HeapSubsystem current = HEAP_OTHER;
+static thread_local HeapCounters *phase = NULL;
+
+void HeapTrack::Enable (bool on)
+{
+#if MAPGEN_HEAP_TRACK
+	enabled.store (on, std::memory_order_relaxed);
+#else
+	if (on)
+	{
+		LOG_WARN (LOG_GENERAL, "heap tracking was compiled out (MAPGEN_HEAP_TRACK=0)\n");
+	}
+#endif
+}
+
+bool HeapTrack::Enabled ()
+{
+	return enabled.load (std::memory_order_relaxed);
+}
+
+HeapCounters& HeapTrack::Total ()
+{
+	return total;
+}
+
+HeapCounters& HeapTrack::Subsystem (HeapSubsystem s)
+{
+	return subsystems[s];
+}
+
+const char *HeapTrack::SubsystemName (HeapSubsystem s)
+{
+	return subsystem_names[s];
+}
+
+static void resetCounters (HeapCounters& c)
+{
+	c.allocated = 0;
+	c.allocations = 0;
+	c.peak = c.live.load();
+}
+
+void HeapTrack::Reset ()
+{
+	resetCounters (total);
+	for (int s = 0; s < HEAP_SUBSYSTEMS; s++)
+	{
+		resetCounters (subsystems[s]);
+	}
+}
+
+HeapSubsystem HeapTrack::Bind (HeapSubsystem s)
+{
+	HeapSubsystem previous = current;
+	current = s;
+	return previous;
+}
+
+HeapSubsystem HeapTrack::Current ()
+{
+	return current;
+}
+
+HeapCounters *HeapTrack::BindPhase (HeapCounters *p)
+{
+	HeapCounters *previous = phase;
+	phase = p;
+	return previous;
+}
+
+HeapCounters *HeapTrack::CurrentPhase ()
+{
+	return phase;
+}
+
+// ===================================================================
+// Allocate -- a block of bytes, counted if tracking is on
+// ===================================================================
+void *HeapTrack::Allocate (size_t bytes)
+{
+	Header *h = (Header *) malloc (bytes + sizeof (Header));
+
+	if (h == NULL)
+	{
+		return NULL;
+	}
+
+	h->size = bytes;
+	h->subsystem = UNTRACKED;
+
+	if (! enabled.load (std::memory_order_relaxed))
+	{
+		return h + 1;
+	}
+
+	HeapCounters& sub = subsystems[current];
+	h->subsystem = current;
+
+	sub.allocated.fetch_add (bytes, std::memory_order_relaxed);
+	sub.allocations.fetch_add (1, std::memory_order_relaxed);
+	sub.raisePeak (sub.live.fetch_add (bytes, std::memory_order_relaxed) + bytes);
+
+	total.allocated.fetch_add (bytes, std::memory_order_relaxed);
+	total.allocations.fetch_add (1, std::memory_order_relaxed);
+	int64_t live = total.live.fetch_add (bytes, std::memory_order_relaxed) + bytes;
+	total.raisePeak (live);
+
+	if (phase != NULL)
+	{
+		phase->allocated.fetch_add (bytes, std::memory_order_relaxed);
+		phase->allocations.fetch_add (1, std::memory_order_relaxed);
+		phase->raisePeak (live);
+	}
+
+	return h + 1;
+}
+
+void HeapTrack::Release (void *block)
+{
+	Header *h = (Header *) block - 1;
+
+	// counted blocks come off the counts even once tracking is off
+	if (h->subsystem != UNTRACKED)
+	{
+		subsystems[h->subsystem].live.fetch_sub (h->size, std::memory_order_relaxed);
+		total.live.fetch_sub (h->size, std::memory_order_relaxed);
+	}
+
+	free (h);
+}
+
+#if MAPGEN_HEAP_TRACK
+
+// ===================================================================
+// global operator new and delete
+//
+// The aligned forms are left to the library; they do not come through
+// here in either direction.
+// ===================================================================
+static void *allocateOrThrow (size_t bytes)
+{
+	for (;;)
+	{
+		void *block = HeapTrack::Allocate (bytes);
+
+		if (block != NULL)
+		{
+			return block;
+		}
+
+		std::new_handler handler = std::get_new_handler ();
+		if (handler == NULL)
+		{
+			throw std::bad_alloc ();
+		}
+		handler ();
+	}
+}
+
+void *operator new (size_t bytes)
+{
+	return allocateOrThrow (bytes);
+}
+
+void *operator new[] (size_t bytes)
+{
+	return allocateOrThrow (bytes);
+}
+
+void operator delete (void *block) noexcept
+{
+	if (block != NULL)
+		HeapTrack::Release (block);
+}
+
+void operator delete[] (void *block) noexcept
+{
+	if (block != NULL)
+		HeapTrack::Release (block);
+}
+
+void operator delete (void *block, size_t) noexcept
+{
+	if (block != NULL)
+		HeapTrack::Release (block);
+}
+
+void operator delete[] (void *block, size_t) noexcept
+{
+	if (block != NULL)
+		HeapTrack::Release (block);
+}
+
+#endif
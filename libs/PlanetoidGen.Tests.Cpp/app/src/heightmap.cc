@@ -4,17 +4,24 @@
 #include "logger.h"
 #include "params.h"
 #include "executive.h"
+#include "random.h"
+#include "threadpool.h"
+#include "metrics.h"
 
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 
 Heightmap::Heightmap (int x, int y)
-	: Image (x, y)
+	: Image (x, y, Params::Instance().height_storage, Params::Instance().storage_layout,
+		HEIGHT_HALO, Params::Instance().halo_padding)
 {
-	for (int i = 0; i < x; i++)
-		for (int j = 0; j < y; j++)
-			Set(i,j, 0);
+	// storage is zeroed on allocation
+	TrackWrites ();
+
+	uint TILE = ImageBuffer::TILE;
+	partials.resize ((size_t) ((x + TILE - 1) / TILE) * ((y + TILE - 1) / TILE));
 }
 
 Heightmap::~Heightmap ()
@@ -27,6 +34,9 @@ Heightmap::~Heightmap ()
 //
 // 5/12/2008:  I used to allow negative altitudes but that appears
 // not to be the case anymore (Image contains only unsigned values)
+//
+// Each NOISE_TILE square draws from its own stream, so the noise in a
+// tile does not depend on the order the tiles are visited in.
 // ===================================================================
 
 void Heightmap::randomize (unsigned long band_size)
@@ -36,53 +46,123 @@ void Heightmap::randomize (unsigned long band_size)
 	int midpoint = 3000;
 	int half_band = band_size / 2;								// half above and half below mid
 
-	Logger::Instance().Log ("Randomizing\n");
-	for (unsigned int i = 0; i < (unsigned int) params.y_size; i++)
+	Random noise = Random::Root().stream(STREAM_NOISE);
+	int x_tiles = (params.x_size + NOISE_TILE - 1) / NOISE_TILE;
+	int y_tiles = (params.y_size + NOISE_TILE - 1) / NOISE_TILE;
+
+	LOG_INFO (LOG_TERRAIN, "Randomizing\n");
+	for (int ty = 0; ty < y_tiles; ty++)
 	{
-		for (unsigned int j = 0; j < (unsigned int) params.x_size; j++)
+		for (int tx = 0; tx < x_tiles; tx++)
 		{
-			Point p(j, i);
+			Random tile = noise.stream(ty * x_tiles + tx);
 
-			if (Executive::Instance().on_land (p))
-			{
-				int offset = rand() % band_size;
+			int x_end = std::min ((tx + 1) * NOISE_TILE, params.x_size);
+			int y_end = std::min ((ty + 1) * NOISE_TILE, params.y_size);
 
-				// translate the band to half the max height
-				unsigned long altitude = (unsigned long) 
-					(midpoint + offset - half_band);
-
-				Set (j, i, altitude);
-			}
-			else
+			for (int i = ty * NOISE_TILE; i < y_end; i++)
 			{
-				Set (j, i, 0);
+				for (int j = tx * NOISE_TILE; j < x_end; j++)
+				{
+					Point p(j, i);
+
+					if (Executive::Instance().on_land (p))
+					{
+						int offset = tile.nextInt(band_size);
+
+						// translate the band to half the max height
+						unsigned long altitude = (unsigned long)
+							(midpoint + offset - half_band);
+
+						Set (j, i, altitude);
+					}
+					else
+					{
+						Set (j, i, 0);
+					}
+				}
 			}
 		}
 	}
+
+	Metrics::Instance().count (COUNT_CELLS_WRITTEN, (uint64_t) params.x_size * params.y_size);
 }
 
 // ===================================================================
-// Max -- return the highest point on the map
+// Stats -- gather the range, mean, land area and histogram of the map
 //
-// This is useful for scaling.
+// Each tile's share is kept, and only the tiles written since the last
+// call are read again, across the thread pool.  A tile of a sparse map
+// which has never been written counts as its one value without being
+// read.
 // ===================================================================
-unsigned long Heightmap::Max ()
+const HeightStats& Heightmap::Stats ()
 {
-	unsigned long max = 0;
+	if (DirtyTiles() == 0)
+	{
+		return stats;
+	}
+
+	const uint TILE = ImageBuffer::TILE;
+	uint tiles_x = (GetXSize() + TILE - 1) / TILE;
 
-	for (unsigned int i = 0; i < GetXSize(); i++)
+	std::vector<size_t> redo;
+	for (size_t t = 0; t < partials.size(); t++)
 	{
-		for (unsigned int j = 0; j < GetYSize(); j++)
+		if (TakeDirty (t))
 		{
-			unsigned long value = Get (i, j);
-			if (value > max)
+			redo.push_back (t);
+		}
+	}
+
+	ThreadPool::Instance().parallelFor ((int) redo.size(), [this, &redo, tiles_x, TILE] (int begin, int end)
+	{
+		uint32_t row[ImageBuffer::TILE];
+
+		for (int k = begin; k < end; k++)
+		{
+			HeightStats::Partial& p = partials[redo[k]];
+			uint tx = redo[k] % tiles_x;
+			uint ty = redo[k] / tiles_x;
+			uint x1 = tx * TILE;
+			uint y1 = ty * TILE;
+			uint n = std::min (TILE, GetXSize() - x1);
+			uint rows = std::min (TILE, GetYSize() - y1);
+
+			HeightStats::clear (p);
+
+			unsigned long value;
+			if (ConstantTile (tx, ty, value))
+			{
+				HeightStats::addValue (p, (uint32_t) value, (size_t) n * rows);
+				continue;
+			}
+
+			for (uint y = y1; y < y1 + rows; y++)
 			{
-				max = value;
+				GetRow (y, x1, n, row);
+				HeightStats::addRow (p, row, n);
 			}
 		}
+	});
+
+	stats.reset ();
+	for (size_t t = 0; t < partials.size(); t++)
+	{
+		stats.merge (partials[t]);
 	}
 
-	return max;
+	return stats;
+}
+
+// ===================================================================
+// Max -- return the highest point on the map
+//
+// This is useful for scaling.
+// ===================================================================
+unsigned long Heightmap::Max ()
+{
+	return Stats().highest;
 }
 
 // ===================================================================
@@ -92,21 +172,7 @@ unsigned long Heightmap::Max ()
 // ===================================================================
 unsigned long Heightmap::Min ()
 {
-	unsigned long min = Get(0,0);
-
-	for (unsigned int i = 0; i < GetXSize(); i++)
-	{
-		for (unsigned int j = 0; j < GetYSize(); j++)
-		{
-			unsigned long value = Get (i, j);
-			if (value < min)
-			{
-				min = value;
-			}
-		}
-	}
-
-	return min;
+	return Stats().lowest;
 }
 
 // ===================================================================
@@ -156,7 +222,7 @@ bool Heightmap::neighbor (Point& seed, Point& neighbor, int direction)
 // ===================================================================
 bool Heightmap::random_neighbor (Point& src, Point& neighbor)
 {
-	int direction = rand() % 4;
+	int direction = Random::Current().nextInt(4);
 	bool done = false;
 	int x = src.x;
 	int y = src.y;
@@ -285,16 +351,41 @@ Heightmap::Scale (unsigned long limit)
 
 	float scaling_factor = (float) limit / (float) max_value;
 
-	Logger::Instance().Log ("scale map to 0-%d.  Max value on map is %d, factor is %f\n", limit, max_value, scaling_factor);
+	LOG_INFO (LOG_TERRAIN, "scale map to 0-%d.  Max value on map is %d, factor is %f\n", limit, max_value, scaling_factor);
+
+	// tile by tile across the thread pool, the cells of a row at once
+	const uint TILE = ImageBuffer::TILE;
+	uint tiles_x = (GetXSize() + TILE - 1) / TILE;
+	uint tiles_y = (GetYSize() + TILE - 1) / TILE;
 
-	for (unsigned int i = 0; i < GetXSize(); i++)
+	ThreadPool::Instance().parallelFor ((int) (tiles_x * tiles_y), [this, tiles_x, scaling_factor, TILE] (int begin, int end)
 	{
-		for (unsigned int j = 0; j < GetYSize(); j++)
+		uint32_t row[ImageBuffer::TILE];
+
+		for (int t = begin; t < end; t++)
 		{
-			unsigned long unscaled = Get(i, j);
-			unsigned long scaled = (unsigned long) (scaling_factor * unscaled);
+			uint tx = t % tiles_x;
+			uint ty = t / tiles_x;
+			uint x1 = tx * TILE;
+			uint y1 = ty * TILE;
+			uint n = std::min (TILE, GetXSize() - x1);
+
+			// an unwritten tile of a sparse map is rescaled as one value
+			unsigned long unscaled;
+			if (ConstantTile (tx, ty, unscaled))
+			{
+				FillTile (tx, ty, HeightStats::scaleValue ((uint32_t) unscaled, scaling_factor));
+				continue;
+			}
 
-			Set (i, j, scaled);
+			for (uint y = y1; y < std::min (y1 + TILE, GetYSize()); y++)
+			{
+				GetRow (y, x1, n, row);
+				HeightStats::scaleRow (row, n, scaling_factor);
+				SetRow (y, x1, n, row);
+			}
 		}
-	}
+	});
+
+	Metrics::Instance().count (COUNT_CELLS_WRITTEN, (uint64_t) GetXSize() * GetYSize());
 }
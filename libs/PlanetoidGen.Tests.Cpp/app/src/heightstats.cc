@@ -0,0 +1,251 @@
+#include "heightstats.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HEIGHTSTATS_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define HEIGHTSTATS_NEON 1
+#endif
+
+HeightStats::HeightStats ()
+{
+	reset ();
+}
+
+void HeightStats::reset ()
+{
+	lowest = UINT32_MAX;
+	highest = 0;
+	sum = 0;
+	mean = 0;
+	land = 0;
+	cells = 0;
+	histogram.assign (HISTOGRAM_BINS, 0);
+}
+
+// ===================================================================
+// merge -- fold one tile's results into the totals
+// ===================================================================
+void HeightStats::merge (const Partial& p)
+{
+	if (p.cells == 0)
+	{
+		return;
+	}
+
+	lowest = std::min (lowest, (unsigned long) p.lowest);
+	highest = std::max (highest, (unsigned long) p.highest);
+	land += p.land;
+	cells += p.cells;
+	sum += p.sum;
+	mean = (double) sum / cells;
+
+	for (int w = 0; w < HISTOGRAM_WAYS; w++)
+	{
+		for (int i = 0; i < HISTOGRAM_BINS; i++)
+		{
+			histogram[i] += p.histogram[w][i];
+		}
+	}
+}
+
+void HeightStats::clear (Partial& p)
+{
+	p.lowest = UINT32_MAX;
+	p.highest = 0;
+	p.sum = 0;
+	p.land = 0;
+	p.cells = 0;
+	std::fill (&p.histogram[0][0], &p.histogram[0][0] + HISTOGRAM_WAYS * HISTOGRAM_BINS, 0);
+}
+
+void HeightStats::addValue (Partial& p, uint32_t value, size_t n)
+{
+	if (n == 0)
+	{
+		return;
+	}
+
+	p.lowest = std::min (p.lowest, value);
+	p.highest = std::max (p.highest, value);
+	p.sum += (uint64_t) value * n;
+	p.land += (value > 0) ? (uint32_t) n : 0;
+	p.cells += (uint32_t) n;
+	p.histogram[0][std::min (value >> HISTOGRAM_SHIFT, (uint32_t) HISTOGRAM_BINS - 1)] += (uint32_t) n;
+}
+
+// ===================================================================
+// addRow -- range, sum and land count in vector registers, then the
+// histogram, which has no vector form worth having
+// ===================================================================
+void HeightStats::addRow (Partial& p, const uint32_t *row, size_t n)
+{
+	uint32_t lo = p.lowest;
+	uint32_t hi = p.highest;
+	uint64_t sum = 0;
+	uint32_t zeros = 0;
+	size_t i = 0;
+
+#if defined(HEIGHTSTATS_AVX2)
+	if (n >= 8)
+	{
+		__m256i vlo = _mm256_set1_epi32 (-1);
+		__m256i vhi = _mm256_setzero_si256 ();
+		__m256i vzeros = _mm256_setzero_si256 ();
+		__m256i vsum = _mm256_setzero_si256 ();
+		const __m256i zero = _mm256_setzero_si256 ();
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i v = _mm256_loadu_si256 ((const __m256i *) (row + i));
+
+			vlo = _mm256_min_epu32 (vlo, v);
+			vhi = _mm256_max_epu32 (vhi, v);
+			vzeros = _mm256_sub_epi32 (vzeros, _mm256_cmpeq_epi32 (v, zero));
+			vsum = _mm256_add_epi64 (vsum, _mm256_cvtepu32_epi64 (_mm256_castsi256_si128 (v)));
+			vsum = _mm256_add_epi64 (vsum, _mm256_cvtepu32_epi64 (_mm256_extracti128_si256 (v, 1)));
+		}
+
+		uint32_t l[8], h[8], z[8];
+		uint64_t s[4];
+
+		_mm256_storeu_si256 ((__m256i *) l, vlo);
+		_mm256_storeu_si256 ((__m256i *) h, vhi);
+		_mm256_storeu_si256 ((__m256i *) z, vzeros);
+		_mm256_storeu_si256 ((__m256i *) s, vsum);
+
+		for (int k = 0; k < 8; k++)
+		{
+			lo = std::min (lo, l[k]);
+			hi = std::max (hi, h[k]);
+			zeros += z[k];
+		}
+		sum = s[0] + s[1] + s[2] + s[3];
+	}
+#elif defined(HEIGHTSTATS_NEON)
+	if (n >= 4)
+	{
+		uint32x4_t vlo = vdupq_n_u32 (UINT32_MAX);
+		uint32x4_t vhi = vdupq_n_u32 (0);
+		uint32x4_t vzeros = vdupq_n_u32 (0);
+		uint64x2_t vsum = vdupq_n_u64 (0);
+
+		for (; i + 4 <= n; i += 4)
+		{
+			uint32x4_t v = vld1q_u32 (row + i);
+
+			vlo = vminq_u32 (vlo, v);
+			vhi = vmaxq_u32 (vhi, v);
+			vzeros = vsubq_u32 (vzeros, vceqzq_u32 (v));
+			vsum = vpadalq_u32 (vsum, v);
+		}
+
+		lo = std::min (lo, vminvq_u32 (vlo));
+		hi = std::max (hi, vmaxvq_u32 (vhi));
+		zeros += vaddvq_u32 (vzeros);
+		sum = vaddvq_u64 (vsum);
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		lo = std::min (lo, row[i]);
+		hi = std::max (hi, row[i]);
+		zeros += (row[i] == 0);
+		sum += row[i];
+	}
+
+	p.lowest = lo;
+	p.highest = hi;
+	p.sum += sum;
+	p.land += (uint32_t) n - zeros;
+	p.cells += (uint32_t) n;
+
+	// the ways are taken in turn, so a run of one height is not a chain of
+	// increments each waiting on the last
+	const uint32_t last = HISTOGRAM_BINS - 1;
+
+	for (i = 0; i + HISTOGRAM_WAYS <= n; i += HISTOGRAM_WAYS)
+	{
+		for (int w = 0; w < HISTOGRAM_WAYS; w++)
+		{
+			p.histogram[w][std::min (row[i + w] >> HISTOGRAM_SHIFT, last)]++;
+		}
+	}
+	for (; i < n; i++)
+	{
+		p.histogram[0][std::min (row[i] >> HISTOGRAM_SHIFT, last)]++;
+	}
+}
+
+// ===================================================================
+// scaleRow -- multiply and saturate, as scaleValue does cell by cell
+//
+// The conversion to float and the multiply round to nearest and the
+// conversion back truncates, as the scalar code does, so the results
+// are the same bit for bit.
+// ===================================================================
+void HeightStats::scaleRow (uint32_t *row, size_t n, float factor)
+{
+	size_t i = 0;
+
+#if defined(HEIGHTSTATS_AVX2)
+	const __m256 f = _mm256_set1_ps (factor);
+	const __m256 two16 = _mm256_set1_ps (65536.0f);
+	const __m256 two31 = _mm256_set1_ps (2147483648.0f);
+	const __m256 two32 = _mm256_set1_ps (4294967296.0f);
+	const __m256i low16 = _mm256_set1_epi32 (0xffff);
+	const __m256i sign = _mm256_set1_epi32 ((int) 0x80000000);
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256 ((const __m256i *) (row + i));
+
+		// unsigned to float in two exact halves, rounded once when they are added
+		__m256 hi = _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_srli_epi32 (v, 16)), two16);
+		__m256 lo = _mm256_cvtepi32_ps (_mm256_and_si256 (v, low16));
+		__m256 p = _mm256_mul_ps (f, _mm256_add_ps (hi, lo));
+
+		// NaN and negatives to 0, then an unsigned truncation
+		p = _mm256_max_ps (p, _mm256_setzero_ps ());
+
+		__m256 top = _mm256_cmp_ps (p, two31, _CMP_GE_OQ);
+		__m256i out = _mm256_cvttps_epi32 (_mm256_sub_ps (p, _mm256_and_ps (top, two31)));
+
+		out = _mm256_add_epi32 (out, _mm256_and_si256 (_mm256_castps_si256 (top), sign));
+		out = _mm256_or_si256 (out, _mm256_castps_si256 (_mm256_cmp_ps (p, two32, _CMP_GE_OQ)));
+
+		_mm256_storeu_si256 ((__m256i *) (row + i), out);
+	}
+#elif defined(HEIGHTSTATS_NEON)
+	// vcvtq_u32_f32 truncates toward zero and saturates, NaN and negatives
+	// to 0 and anything past UINT32_MAX to UINT32_MAX, which is exactly
+	// scaleValue; it must not become a rounding conversion
+	const float32x4_t f = vdupq_n_f32 (factor);
+
+	for (; i + 4 <= n; i += 4)
+	{
+		float32x4_t p = vmulq_f32 (f, vcvtq_f32_u32 (vld1q_u32 (row + i)));
+
+		vst1q_u32 (row + i, vcvtq_u32_f32 (p));
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		row[i] = scaleValue (row[i], factor);
+	}
+}
+
+const char *HeightStats::kernelName ()
+{
+#if defined(HEIGHTSTATS_AVX2)
+	return "avx2";
+#elif defined(HEIGHTSTATS_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
@@ -1,8 +1,16 @@
 #include "image.h"
 #include <stdlib.h>
+#include <string.h>
 
 #include "stb_image.h"
-#include "stb_image_write.h"
+#include "pngwriter.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+#include "pagequeue.h"
+#include "metrics.h"
+#include "heaptrack.h"
+#include <algorithm>
+#include <bit>
 
 #include <cstdarg>
 #include <math.h>
@@ -15,12 +23,15 @@
 
 using namespace std;
 
-Image::Image (uint x, uint y)
+Image::Image (uint x, uint y, StorageType t, StorageLayout l, uint haloCells, HaloPadding haloPadding)
 {
 	size_x = x;
 	size_y = y;
 
-	map = NULL;
+	storage = t;
+	layout = l;
+	halo = haloCells;
+	padding = haloPadding;
 	allocate (x, y);
 	origin = origin_top;
 	mode = rgba_8;
@@ -28,27 +39,39 @@ Image::Image (uint x, uint y)
 
 	max = 0;
 	min = 0;
+	page_size = 0;
+	page_level = 0;
 }
 
 Image::Image (const char *filename)
 {
-	map = NULL;
+	storage = STORAGE_U32;
+	layout = LAYOUT_DENSE;
+	halo = 0;
+	padding = PAD_ZERO;
 	Load (const_cast <char *> (filename));
 	origin = origin_top;
 	mode = rgba_8;
 	max = 0;
 	min = 0;
+	page_size = 0;
+	page_level = 0;
 }
 
 Image::Image ()
 {
 	size_x = 0;
 	size_y = 0;
-	map = NULL;
+	storage = STORAGE_U32;
+	layout = LAYOUT_DENSE;
+	halo = 0;
+	padding = PAD_ZERO;
 	origin = origin_top;
 	mode = rgba_8;
 	max = 0;
 	min = 0;
+	page_size = 0;
+	page_level = 0;
 }
 
 Image::~Image ()
@@ -92,34 +115,32 @@ double rint( double x)
 
 void Image::release ()
 {
-	for (unsigned int i = 0; i < size_x; i++)
-	{
-		delete [] map[i];
-	}
-	delete [] map;
+	map.release ();
 
 	size_x = 0;
 	size_y = 0;
-	map = NULL;
 }
 
 // ===================================================================
 // Image::allocate -- allocate memory for the image
+//
+// The cells live in one contiguous, row-major block (see ImageBuffer),
+// using the element type selected when the image was constructed.  Tiled
+// images page through a scratch file instead, as the parameters say, and
+// sparse ones only allocate the tiles which are written.  Only dense
+// images keep the halo asked for.
 // ===================================================================
 void Image::allocate (uint xlen, uint ylen)
 {
-	map = new unsigned long *[size_x];
-	for (unsigned int x = 0; x < size_x; x++)
+	if (layout == LAYOUT_TILED)
 	{
-		map[x] = new unsigned long[size_y*4];
-	}
+		Params& params = Params::Instance();
 
-	for (unsigned int i = 0; i < size_y; i++)
+		map.allocate (xlen, ylen, storage, layout, params.scratch_dir.c_str(), (size_t) params.resident_mb << 20);
+	}
+	else
 	{
-		for (unsigned int j = 0; j < size_x; j++)
-		{
-			map[j][i] = 0;
-		}
+		map.allocate (xlen, ylen, storage, layout, ".", 0, halo, padding);
 	}
 }
 
@@ -140,11 +161,11 @@ void Image::Set (uint x, uint y, unsigned long value)
 {
 	if (! in_range (x, y))
 	{
-	//	Logger::Instance().Log ("Image::Set: (%d,%d) out of range\n", x, y);
+	//	LOG_DEBUG (LOG_STORAGE, "Image::Set: (%d,%d) out of range\n", x, y);
 		return;
 	}
 
-	map[x][y] = value;
+	map.set (x, y, value);
 }
 
 // ===================================================================
@@ -153,7 +174,7 @@ void Image::fSet (float x_percent, float y_percent, unsigned long value)
 {
 	if (! in_f_range (x_percent, y_percent))
 	{
-		Logger::Instance().Log ("Set: (%f,%f) out of range\n", 
+		LOG_WARN (LOG_STORAGE, "Set: (%f,%f) out of range\n", 
 			x_percent, y_percent);
 		return;
 	}
@@ -161,7 +182,7 @@ void Image::fSet (float x_percent, float y_percent, unsigned long value)
 	uint x = (int) rint (size_x * x_percent);
 	uint y = (int) rint (size_y * y_percent);
 
-	map[x][y] = value;
+	map.set (x, y, value);
 }
 
 // ===================================================================
@@ -175,10 +196,10 @@ unsigned long Image::Get (int x, int y)
 {
 	if (! in_range (x, y))
 	{
-		return 0;
+		return map.inHalo (x, y) ? map.getUnchecked (x, y) : 0;
 	}
 
-	return map[x][y];
+	return map.get (x, y);
 }
 
 // ===================================================================
@@ -195,7 +216,7 @@ unsigned long Image::fGet (float x_percent, float y_percent)
 {
 	if (! in_f_range (x_percent, y_percent))
 	{
-		Logger::Instance().Log ("Get: (%f,%f) out of range\n", 
+		LOG_WARN (LOG_STORAGE, "Get: (%f,%f) out of range\n", 
 			x_percent, y_percent);
 		return 0;
 	}
@@ -203,218 +224,350 @@ unsigned long Image::fGet (float x_percent, float y_percent)
 	uint x = (int) rint (size_x * x_percent);
 	uint y = (int) rint (size_y * y_percent);
 
-	return map[x][y];
+	return map.get (x, y);
 }
 
 // ===================================================================
-//  BuildByteSeq
-/// @brief 		Convert a 2D image to a 1D sequence of byte values
+//  BuildRow
+/// @brief 		Convert part of one row to the bytes of a PNG scanline
 ///
-/// This is in preparation for writing the image out.
+/// Cells off the image are written as 0.
 ///
-/// Inputs:
-///	  x1, y1, x2, y2:   The bounding points, inclusive
-///    scale:            A scaling factor which is applied to each point
+/// @param	 y				The image row
+/// @param	 x1, x2			The columns to convert, x2 exclusive
+/// @param	 channels		1 for greyscale, 4 for RGBA
+/// @param	 scale			A scaling factor which is applied to each point
+/// @param	 row			The scanline, (x2 - x1) pixels
 // ===================================================================
-unsigned char *Image::BuildByteSeq (uint x1, uint y1, uint x2, uint y2,
-	float scale)
+void Image::BuildRow (uint y, uint x1, uint x2, int channels, float scale, uint8_t *row)
 {
-	uint width = (x2 - x1);
-	uint height = (y2 - y1);
-	uint length = width * height;
-
-    Params& params = Params::Instance();
-
-	Logger::Instance().Log ("building byte seq for %d x %d image\n", width, height);
-	unsigned char *byte_seq = new unsigned char[length*4];
+	const uint BATCH = 256;
+	uint32_t values[BATCH];
 
-	if (byte_seq == NULL)
-		return NULL;
+	Params& params = Params::Instance();
+	int range = params.mountain_max_alt + params.hill_max_alt;
 
-	if (origin == origin_top)
+	for (uint x = x1; x < x2; x += BATCH)
 	{
-    	// convert 2d array to 1d bitmap
-		for (uint y = y1; y < y2; y++)
+		uint n = std::min (BATCH, x2 - x);
+		uint on_image = 0;
+
+		if (y < size_y && x < size_x)
 		{
-			for (uint x = x1; x < x2; x++)
-			{
-				unsigned long value = Get (x, y);
+			on_image = std::min (n, size_x - x);
+			map.getRow (y, x, on_image, values);
+		}
 
-				unsigned char r, g, b, a;
-				switch (mode)
-				{
-				case grey_8:
-					r = (unsigned char) ((value & 0xff) * scale);
-					g = (unsigned char) ((value & 0xff) * scale);
-					b = (unsigned char) ((value & 0xff) * scale);
-					a = (unsigned char) 255;
-					break;
-				case rgba_8:
-				default:
-                    unsigned char v = (unsigned char)(value * scale / (params.mountain_max_alt + params.hill_max_alt) * 255);
-                    r = v;
-                    g = v;
-                    b = v;
-                    a = 255;
-					//r = (unsigned char) ((value >> 24) * scale);
-					//g = (unsigned char) (((value >> 16) & 0xff) * scale);
-					//b = (unsigned char) (((value >> 8) & 0xff) * scale);
-					//a = (unsigned char) ((value & 0xff) * scale);
-					break;
-				}
+		std::fill (values + on_image, values + n, 0);
 
-				int idx = ((y - y1) * width + (x - x1)) * 4;
+		uint8_t *out = row + (size_t) (x - x1) * channels * ((mode == lum_16) ? 2 : 1);
 
-				byte_seq[idx++] = r;
-				byte_seq[idx++] = g;
-				byte_seq[idx++] = b;
-				byte_seq[idx++] = a;
-			}
-		}
-	}
-	else
-	{
-    	// convert 2d array to 1d bitmap
-		for (uint y = y1; y < y2; y++)
+		for (uint i = 0; i < n; i++)
 		{
-			for (uint x = x1; x < x2; x++)
+			unsigned long value = values[i];
+
+			switch (mode)
+			{
+			case grey_8:
+				out[i] = (uint8_t) ((value & 0xff) * scale);
+				break;
+			case lum_16:
 			{
-				unsigned long value = Get (x, y);
-				unsigned char r, g, b, a;
-				switch (mode)
+				float v = std::min (value * scale, 65535.0f);
+				uint16_t s = (uint16_t) v;
+
+				out[2 * i] = (uint8_t) (s >> 8);
+				out[2 * i + 1] = (uint8_t) s;
+				break;
+			}
+			case rgba_8:
+			default:
+				if (channels == 1)
 				{
-				case grey_8:
-					r = (unsigned char) ((value & 0xff) * scale);
-					g = (unsigned char) ((value & 0xff) * scale);
-					b = (unsigned char) ((value & 0xff) * scale);
-					a = (unsigned char) 255;
-					break;
-				case rgba_8:
-				default:
-					r = (unsigned char) ((value >> 24) * scale);
-					g = (unsigned char) (((value >> 16) & 0xff) * scale);
-					b = (unsigned char) (((value >> 8) & 0xff) * scale);
-					a = (unsigned char) ((value & 0xff) * scale);
-					break;
+					// heights as grey, relative to the tallest mountain and hill
+					out[i] = (uint8_t) (int64_t) (value * scale / range * 255);
 				}
-
-				byte_seq[((y2-y) * width + (x - x1)) * 4 + 0] = r;
-				byte_seq[((y2-y) * width + (x - x1)) * 4 + 1] = g;
-				byte_seq[((y2-y) * width + (x - x1)) * 4 + 2] = b;
-				byte_seq[((y2-y) * width + (x - x1)) * 4 + 3] = a;
+				else
+				{
+					out[4 * i] = (uint8_t) ((value >> 24) * scale);
+					out[4 * i + 1] = (uint8_t) (((value >> 16) & 0xff) * scale);
+					out[4 * i + 2] = (uint8_t) (((value >> 8) & 0xff) * scale);
+					out[4 * i + 3] = (uint8_t) ((value & 0xff) * scale);
+				}
+				break;
 			}
 		}
 	}
-
-	return byte_seq;
 }
 
 // ===================================================================
-// BuildShortSeq
-/// @brief 		Convert a 2D image to a 1D sequence of unsigned shorts
+//  Write
+/// @brief Save an entire image to a file
 ///
-/// This is in preparation for writing the image out.
-//
-/// @param	 x1,y1,x2,y2	The bounding points, inclusive
-/// @param	 scale          A scaling factor which is applied to each point
-/// @return  A pointer to a linear bitmap array
+/// @param filename		The output filename
+/// @param scale		a scaling factor to apply to each point
+/// @return				false, having logged it, if the file was not written
 // ===================================================================
-unsigned short *Image::BuildShortSeq (uint x1, uint y1, uint x2, uint y2,
+
+bool Image::Write (const char *filename, float scale)
+{
+	return Write (filename, 0, 0, size_x, size_y, scale);
+}
+
+
+// ==========================================================
+//  Write
+/// @brief Save a region of the image to a file
+///
+/// @param filename		the basename (no extension) of the file to save
+/// @param x1,y1,x2,y2 	the boundaries of the region to save (inclusive)
+/// @param scale		a scaling factor to apply to each point
+/// @return				false, having logged it, if the file was not written
+///
+/// Pages are written on the pool's workers, so a failure is returned for
+/// the caller to act on rather than ending the process here.
+// ==========================================================
+
+bool Image::Write (const char *filename, uint x1, uint y1, uint x2, uint y2,
 	float scale)
 {
 	uint width = x2 - x1;
 	uint height = y2 - y1;
-	uint length = width * height;
+	HeapScope heap (HEAP_WRITER);
 
-	unsigned short *short_seq = new unsigned short[length];
+	unlink (filename);
 
-	if (short_seq == NULL)
-		return NULL;
+	// rgba_8 images with the origin at the top hold heights, which are grey;
+	// bottom-origin ones hold packed colours
+	PngFormat png;
+	int channels = 1;
 
-	if (origin == origin_top)
+	switch (mode)
 	{
-    	// convert 2d array to 1d bitmap
-		for (uint y = y1; y < y2; y++)
+	case grey_8:
+		png = PNG_GREY8;
+		break;
+	case lum_16:
+		png = PNG_GREY16;
+		break;
+	case rgba_8:
+	default:
+		if (origin == origin_top)
 		{
-			for (uint x = x1; x < x2; x++)
-			{
-				unsigned long value = Get (x, y);
-				short_seq[(y - y1) * width + (x - x1)] = 
-					(unsigned short) (value * scale);
-			}
+			png = PNG_GREY8;
+		}
+		else
+		{
+			png = PNG_RGBA8;
+			channels = 4;
 		}
+		break;
+	}
+
+	LOG_INFO (LOG_STORAGE, "writing %d x %d image to %s\n", width, height, filename);
+
+	PngWriter writer (png, width, height);
+	bool written = writer.write (filename, [this, x1, x2, y1, y2, channels, scale] (uint row, uint8_t *out)
+	{
+		uint y = (origin == origin_top) ? y1 + row : y2 - 1 - row;
+		BuildRow (y, x1, x2, channels, scale, out);
+	});
+
+	if (! written)
+	{
+		LOG_ERROR (LOG_STORAGE, "cannot write %s\n", filename);
+	}
+
+	return written;
+}
+
+// raw samples are built in host byte order, then swapped to little-endian
+// on a big-endian host
+static void swapRawRow (uint8_t *out, uint n, size_t sample)
+{
+	for (uint8_t *p = out, *end = out + n * sample; p < end; p += sample)
+	{
+		std::reverse (p, p + sample);
+	}
+}
+
+static void put16le (uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+}
+
+static void put32le (uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+const char *Image::RawExtension (RawFormat raw)
+{
+	return (raw == RAW_R32F) ? ".r32" : ".r16";
+}
+
+// ===================================================================
+//  BuildRawRow
+/// @brief		Convert n cells of row y, from column x, to raw samples
+///
+/// When the cells are already stored as the sample type the row is
+/// copied as it is; otherwise R16 saturates at 65535.  The samples
+/// come out little-endian whatever the host's byte order.
+///
+/// @param	 y, x, n		The cells to convert, which must lie on the image
+/// @param	 raw			The sample format
+/// @param	 out			n samples, 2 or 4 bytes each
+// ===================================================================
+void Image::BuildRawRow (uint y, uint x, uint n, RawFormat raw, uint8_t *out)
+{
+	StorageType type = map.getType();
+
+	if ((raw == RAW_R16 && type == STORAGE_U16) || (raw == RAW_R32F && type == STORAGE_F32))
+	{
+		map.copyRow (y, x, n, out);
 	}
 	else
 	{
-    	// convert 2d array to 1d bitmap
-		for (uint y = y1; y < y2; y++)
+		convertRawRow (y, x, n, raw, out);
+	}
+
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		swapRawRow (out, n, (raw == RAW_R16) ? 2 : 4);
+	}
+}
+
+// ===================================================================
+//  convertRawRow
+/// @brief		Convert n cells of row y to raw samples in host byte order
+// ===================================================================
+void Image::convertRawRow (uint y, uint x, uint n, RawFormat raw, uint8_t *out)
+{
+	const uint BATCH = 256;
+	uint32_t values[BATCH];
+
+	for (uint i = 0; i < n; i += BATCH)
+	{
+		uint count = std::min (BATCH, n - i);
+		map.getRow (y, x + i, count, values);
+
+		if (raw == RAW_R16)
+		{
+			uint16_t samples[BATCH];
+			for (uint j = 0; j < count; j++)
+			{
+				samples[j] = (values[j] > 0xffff) ? 0xffff : (uint16_t) values[j];
+			}
+			memcpy (out + (size_t) i * 2, samples, (size_t) count * 2);
+		}
+		else
 		{
-			for (uint x = x1; x < x2; x++)
+			float samples[BATCH];
+			for (uint j = 0; j < count; j++)
 			{
-				unsigned long value = Get (x, y);
-				short_seq[(y2 - y) * width + (x - x1)] = 
-					(unsigned short) (value * scale);
+				samples[j] = (float) values[j];
 			}
+			memcpy (out + (size_t) i * 4, samples, (size_t) count * 4);
 		}
 	}
-
-	return short_seq;
 }
 
 // ===================================================================
-//  Write
-/// @brief Save an entire image to a file
-///
-/// @param filename		The output filename
-/// @param scale		a scaling factor to apply to each point
+//  WriteRaw
+/// @brief Save an entire image as raw samples
 // ===================================================================
-
-void Image::Write (const char *filename, float scale)
+bool Image::WriteRaw (const char *filename, RawFormat raw, bool header)
 {
-	Write (filename, 0, 0, size_x, size_y, scale);
+	return WriteRaw (filename, 0, 0, size_x, size_y, raw, header);
 }
 
-
-// ==========================================================
-//  Write
-/// @brief Save a region of the image to a file
+// ===================================================================
+//  WriteRaw
+/// @brief Save a region of the image as raw R16 or R32F samples
 ///
-/// @param filename		the basename (no extension) of the file to save
-/// @param x1,y1,x2,y2 	the boundaries of the region to save (inclusive)
-/// @param scale		a scaling factor to apply to each point
-// ==========================================================
-
-void Image::Write (const char *filename, uint x1, uint y1, uint x2, uint y2,
-	float scale)
+/// Samples are little-endian, rows run top to bottom as in the PNG
+/// output, and cells beyond the edge of the image are 0.  The file is
+/// sized up front and each row is converted straight into its mapping,
+/// so no copy of the region is built in memory.
+///
+/// With header set the samples follow a RAW_HEADER_BYTES header, all
+/// fields little-endian:
+///
+///	 0	"PGHM"
+///	 4	uint16 version, 1
+///	 6	uint16 sample format, 1 = R16, 2 = R32F
+///	 8	uint32 width
+///	12	uint32 height
+///	16	uint32 offset of the first sample
+///	20	reserved, 0
+///
+/// @param filename		The output filename
+/// @param x1,y1,x2,y2	The region to save, x2 and y2 exclusive
+/// @param raw			The sample format
+/// @param header		Write the header in front of the samples
+/// @return				false, having logged it, if the file was not written
+// ===================================================================
+bool Image::WriteRaw (const char *filename, uint x1, uint y1, uint x2, uint y2,
+	RawFormat raw, bool header)
 {
 	uint width = x2 - x1;
 	uint height = y2 - y1;
+	size_t sample = (raw == RAW_R16) ? 2 : 4;
+	size_t offset = header ? RAW_HEADER_BYTES : 0;
+	size_t pitch = (size_t) width * sample;
+	HeapScope heap (HEAP_WRITER);
 
-	unlink (filename);
+	LOG_INFO (LOG_STORAGE, "writing %d x %d raw image to %s\n", width, height, filename);
+
+	MappedFile file;
+	if (! file.create (filename, offset + pitch * height))
+	{
+		LOG_ERROR (LOG_STORAGE, "cannot write %s\n", filename);
+		return false;
+	}
 
-	unsigned char *byte_seq;
-	unsigned short *short_seq;
+	uint8_t *base = file.bytes();
 
-	// bind image attributes and save
-	switch (mode)
+	if (header)
 	{
-	case rgba_8:
-	case grey_8:
-		byte_seq = BuildByteSeq (x1, y1, x2, y2);
+		memcpy (base, "PGHM", 4);
+		put16le (base + 4, 1);
+		put16le (base + 6, (raw == RAW_R16) ? 1 : 2);
+		put32le (base + 8, width);
+		put32le (base + 12, height);
+		put32le (base + 16, (uint32_t) offset);
+	}
 
-		if (byte_seq == NULL)
+	// the mapping starts zeroed, so only cells on the image are converted
+	uint on_x = (x1 < size_x) ? std::min (x2, size_x) - x1 : 0;
+
+	ThreadPool::Instance().parallelFor ((int) height, [this, base, offset, pitch, x1, y1, y2, on_x, raw] (int begin, int end)
+	{
+		for (int row = begin; row < end; row++)
 		{
-			Logger::Instance().Log ("Cannot allocate bitmap for index\n");
-			exit (1);
+			uint y = (origin == origin_top) ? y1 + row : y2 - 1 - row;
+
+			if ((y < size_y) && (on_x > 0))
+			{
+				BuildRawRow (y, x1, on_x, raw, base + offset + pitch * row);
+			}
 		}
-        stbi_write_png(filename, width, height, 4, byte_seq, 0);
-        //stbi_write_jpg(filename, width, height, 4, byte_seq, 100);
-		delete [] byte_seq;
-		break;
-	default:
-		Logger::Instance().Log ("unsupported mode in image write");
-		exit (1);
+	});
+
+	if (! file.close ())
+	{
+		LOG_ERROR (LOG_STORAGE, "cannot write %s\n", filename);
+		return false;
 	}
+
+	Metrics& metrics = Metrics::Instance();
+	metrics.count (COUNT_BYTES_WRITTEN, offset + pitch * height);
+	metrics.count (COUNT_FILES_WRITTEN);
+	return true;
 }
 
 // ==========================================================
@@ -429,6 +582,8 @@ void Image::Load (const char *filename)
     size_x = x;
     size_y = y;
 
+	// packed RGBA needs all 32 bits
+	storage = STORAGE_U32;
 	allocate (size_x, size_y);
 
     for (unsigned int y = 0; y < size_y; y++)
@@ -440,7 +595,7 @@ void Image::Load (const char *filename)
             unsigned char blue = data[(y * size_x + x) * 4 + 2];
             unsigned char alpha = data[(y * size_x + x) * 4 + 3];
 
-            map[x][y] = (red << 24) | (green << 16) | (blue << 8) | alpha;
+            map.set (x, y, ((unsigned long) red << 24) | (green << 16) | (blue << 8) | alpha);
         }
     }
 
@@ -462,38 +617,109 @@ string Image::getExtension ()
 	}
 }
 
+// ==========================================================
+// PageBounds -- the cells of one page along an axis
+//
+// Level n of a map split at page_size: page k covers map cells
+// [k * page_size, (k + 1) * page_size), which are level cells
+// [(k * page_size) >> n, ((k + 1) * page_size + 2^n - 1) >> n).  Neighbouring
+// level pages share a cell where page_size is not a multiple of 2^n.
+// ==========================================================
+void Image::PageBounds (int page, int page_size, int level, uint& lo, uint& hi)
+{
+	uint64_t first = (uint64_t) page * page_size;
+	uint64_t last = first + page_size;
+
+	lo = (uint) (first >> level);
+	hi = (uint) ((last + (1u << level) - 1) >> level);
+}
+
 // ==========================================================
 // write_page -- write out one page of the image data
+//
+// Map pages are page_size square even past the edge of the image; pages
+// of a reduced level are clipped to it.
 // ==========================================================
-void Image::write_page (int page_x, int page_y)
+bool Image::write_page (int page_x, int page_y, RawFormat raw, bool header)
 {
-	int x1 = page_x * page_size;
-	int x2 = x1 + page_size;
-	int y1 = page_y * page_size;
-	int y2 = y1 + page_size;
+	uint x1, x2, y1, y2;
+
+	PageBounds (page_x, page_size, page_level, x1, x2);
+	PageBounds (page_y, page_size, page_level, y1, y2);
+
+	if (page_level > 0)
+	{
+		x2 = std::min (x2, size_x);
+		y2 = std::min (y2, size_y);
+	}
 
 	ostringstream filename;
-	string extension = getExtension();
+	string extension = (raw == RAW_NONE) ? getExtension() : RawExtension (raw);
 
 	filename << name << page_y << "." << page_x << extension;
-	Write (filename.str().c_str(), x1, y1, x2, y2);
+
+	if (raw == RAW_NONE)
+	{
+		return Write (filename.str().c_str(), x1, y1, x2, y2);
+	}
+
+	return WriteRaw (filename.str().c_str(), x1, y1, x2, y2, raw, header);
 }
 
 // ==========================================================
 // SplitImage -- write the image out as a series of pages
+//
+// Pages are images in the image's format unless raw is given, in which
+// case they are raw samples with the matching extension.  Returns false
+// if any page could not be written.
+// ==========================================================
+bool Image::SplitImage (int size, RawFormat raw, bool header)
+{
+	PageQueue pages;
+
+	SplitImage (size, pages, raw, header);
+	return pages.finish ();
+}
+
 // ==========================================================
-void Image::SplitImage (int size)
+// SplitImage -- queue the pages of the image on pages
+//
+// The pages may still be being written when this returns; the image must
+// not change until the queue has finished.
+// ==========================================================
+void Image::SplitImage (int size, PageQueue& pages, RawFormat raw, bool header)
 {
 	page_size = size;
-	int num_x_pages = (size_x + page_size - 1) / page_size;
-	int num_y_pages = (size_y + page_size - 1) / page_size;
+	page_level = 0;
 
+	queuePages ((size_x + page_size - 1) / page_size, (size_y + page_size - 1) / page_size,
+		pages, raw, header);
+}
 
+// ==========================================================
+// SplitLevel -- queue the pages of a reduced level of detail
+//
+// The page counts come from the full image, since a level's own size
+// cannot tell how many pages the image was split into.
+// ==========================================================
+void Image::SplitLevel (int size, int level, int num_x_pages, int num_y_pages, PageQueue& pages)
+{
+	page_size = size;
+	page_level = level;
+
+	queuePages (num_x_pages, num_y_pages, pages, RAW_NONE, false);
+}
+
+void Image::queuePages (int num_x_pages, int num_y_pages, PageQueue& pages, RawFormat raw, bool header)
+{
 	for (int page_x = 0; page_x < num_x_pages; page_x++)
 	{
 		for (int page_y = 0; page_y < num_y_pages; page_y++)
 		{
-			write_page (page_x, page_y);
-        }
-    }
+			pages.add ([this, page_x, page_y, raw, header] ()
+			{
+				return write_page (page_x, page_y, raw, header);
+			});
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,775 @@
+#include "imagebuffer.h"
+#include "heaptrack.h"
+#include "logger.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+ImageBuffer::ImageBuffer ()
+{
+	size_x = 0;
+	size_y = 0;
+	type = STORAGE_U32;
+	layout = LAYOUT_DENSE;
+	stride = 0;
+	block = NULL;
+	base = NULL;
+	data = NULL;
+	halo = 0;
+	padding = PAD_ZERO;
+	lead = 0;
+	cache = NULL;
+	tiles_x = 0;
+	tiles_y = 0;
+	materialized = 0;
+	dirtyTiles = 0;
+}
+
+ImageBuffer::~ImageBuffer ()
+{
+	release ();
+}
+
+// ===================================================================
+// allocate -- reserve a zeroed, aligned block for an x by y image
+//
+// Rows are padded so that each one starts on an ALIGNMENT boundary.
+// Tiled images get whole tiles, in a scratch file; sparse images get
+// none until they are written.  Only dense images have a halo.
+// ===================================================================
+void ImageBuffer::allocate (unsigned int x, unsigned int y, StorageType t, StorageLayout l,
+	const char *directory, size_t residentBytes, unsigned int haloCells, HaloPadding haloPadding)
+{
+	HeapScope heap (HEAP_IMAGE);
+
+	release ();
+
+	size_x = x;
+	size_y = y;
+	type = t;
+	layout = l;
+	tiles_x = ((size_t) size_x + TILE - 1) / TILE;
+	tiles_y = ((size_t) size_y + TILE - 1) / TILE;
+
+	if (layout == LAYOUT_SPARSE)
+	{
+		stride = TILE;
+
+		sparse.reset (new std::atomic<unsigned char *>[tiles_x * tiles_y]);
+		fills.reset (new uint32_t[tiles_x * tiles_y]);
+
+		clear ();
+		return;
+	}
+
+	if (layout == LAYOUT_TILED)
+	{
+		size_t tileBytes = (size_t) TILE * TILE * elementSize();
+		stride = TILE;
+
+		// a handful of tiles at least, agents work across tile edges
+		size_t limit = residentBytes / tileBytes;
+		if ((residentBytes > 0) && (limit < 16))
+		{
+			limit = 16;
+		}
+
+		cache = new TileCache;
+		if (! cache->create (tiles_x * tiles_y, tileBytes, limit, directory))
+		{
+			LOG_ERROR (LOG_STORAGE, "ImageBuffer: cannot page a %u x %u image through %s\n", size_x, size_y, directory);
+			exit (1);
+		}
+
+		data = cache->base();
+		return;
+	}
+
+	// a mirror has nothing to reflect further out than the image is wide
+	halo = (haloCells < MAX_HALO) ? haloCells : MAX_HALO;
+	if (haloPadding == PAD_MIRROR)
+	{
+		halo = std::min (halo, std::min (size_x, size_y) - 1);
+	}
+	padding = (halo > 0) ? haloPadding : PAD_ZERO;
+
+	size_t per_line = ALIGNMENT / elementSize();
+	lead = ((size_t) halo + per_line - 1) / per_line * per_line;
+	stride = (lead + size_x + halo + per_line - 1) / per_line * per_line;
+
+	block = new unsigned char[bytes() + ALIGNMENT];
+
+	size_t misalign = (size_t) block % ALIGNMENT;
+	base = block + (misalign ? ALIGNMENT - misalign : 0);
+	data = base + ((size_t) halo * stride + lead) * elementSize();
+
+	clear ();
+}
+
+void ImageBuffer::release ()
+{
+	freeTiles ();
+	sparse.reset ();
+	fills.reset ();
+	dirty.reset ();
+	dirtyTiles = 0;
+
+	delete [] block;
+	delete cache;
+
+	block = NULL;
+	base = NULL;
+	data = NULL;
+	halo = 0;
+	padding = PAD_ZERO;
+	lead = 0;
+	cache = NULL;
+	size_x = 0;
+	size_y = 0;
+	stride = 0;
+	tiles_x = 0;
+	tiles_y = 0;
+}
+
+// ===================================================================
+// clear -- reset every cell to 0, and the halo with them
+// ===================================================================
+void ImageBuffer::clear ()
+{
+	if (sparse != NULL)
+	{
+		freeTiles ();
+
+		for (size_t i = 0; i < tiles_x * tiles_y; i++)
+		{
+			fills[i] = 0;
+		}
+	}
+	else if (cache != NULL)
+	{
+		cache->clear ();
+	}
+	else if (base != NULL)
+	{
+		memset (base, 0, bytes());
+	}
+
+	if (dirty != NULL)
+	{
+		for (size_t i = 0; i < tiles_x * tiles_y; i++)
+		{
+			dirty[i] = 1;
+		}
+		dirtyTiles = (long) (tiles_x * tiles_y);
+	}
+}
+
+// ===================================================================
+// fill -- give every cell the same value
+//
+// Sparse images only change the value their unwritten tiles read as.  A
+// zero halo stays zero, so dense images with one are filled a row at a
+// time; otherwise the rows, their padding and the ghost cells all take
+// the value in one pass.
+// ===================================================================
+void ImageBuffer::fill (unsigned long value)
+{
+	if (sparse != NULL)
+	{
+		freeTiles ();
+
+		for (size_t i = 0; i < tiles_x * tiles_y; i++)
+		{
+			fills[i] = (uint32_t) stored (value);
+		}
+	}
+	else if (cache != NULL)
+	{
+		std::vector<uint32_t> cells (size_x, (uint32_t) stored (value));
+
+		for (unsigned int y = 0; y < size_y; y++)
+		{
+			setRow (y, 0, size_x, cells.data());
+		}
+	}
+	else if ((halo > 0) && (padding == PAD_ZERO))
+	{
+		for (unsigned int y = 0; y < size_y; y++)
+		{
+			fillCells (data + (size_t) y * stride * elementSize(), size_x, value);
+		}
+	}
+	else if (base != NULL)
+	{
+		fillCells (base, bytes() / elementSize(), value);
+	}
+
+	if (dirty != NULL)
+	{
+		for (size_t i = 0; i < tiles_x * tiles_y; i++)
+		{
+			dirty[i] = 1;
+		}
+		dirtyTiles = (long) (tiles_x * tiles_y);
+	}
+}
+
+// ===================================================================
+// prefetch -- start reading in the tiles under a box of cells
+// ===================================================================
+void ImageBuffer::prefetch (int x1, int y1, int x2, int y2)
+{
+	if (cache == NULL)
+	{
+		return;
+	}
+
+	int last_x = (int) size_x - 1;
+	int last_y = (int) size_y - 1;
+
+	x1 = (x1 < 0) ? 0 : x1;
+	y1 = (y1 < 0) ? 0 : y1;
+	x2 = (x2 > last_x) ? last_x : x2;
+	y2 = (y2 > last_y) ? last_y : y2;
+
+	for (int ty = y1 >> TILE_SHIFT; ty <= (y2 >> TILE_SHIFT); ty++)
+	{
+		for (int tx = x1 >> TILE_SHIFT; tx <= (x2 >> TILE_SHIFT); tx++)
+		{
+			cache->prefetch ((size_t) ty * tiles_x + tx);
+		}
+	}
+}
+
+// ===================================================================
+// getRow -- read n cells starting at (x,y) as int32
+//
+// Values too large for an int32 saturate.
+// ===================================================================
+void ImageBuffer::getRow (unsigned int y, unsigned int x, unsigned int n, int32_t *dst)
+{
+	while (n > 0)
+	{
+		unsigned int run = span (x, n);
+		const unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+		{
+			unsigned long v = fills[tileOf (x, y)];
+			std::fill (dst, dst + run, (v > INT32_MAX) ? INT32_MAX : (int32_t) v);
+
+			x += run;
+			dst += run;
+			n -= run;
+			continue;
+		}
+
+		switch (type)
+		{
+		case STORAGE_U16:
+		{
+			const uint16_t *src = (const uint16_t *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = src[j];
+			}
+			break;
+		}
+		case STORAGE_U32:
+		{
+			const uint32_t *src = (const uint32_t *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = (src[j] > INT32_MAX) ? INT32_MAX : (int32_t) src[j];
+			}
+			break;
+		}
+		default:
+		{
+			const float *src = (const float *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				unsigned long v = fromFloat (src[j]);
+				dst[j] = (v > INT32_MAX) ? INT32_MAX : (int32_t) v;
+			}
+			break;
+		}
+		}
+
+		x += run;
+		dst += run;
+		n -= run;
+	}
+}
+
+void ImageBuffer::getRow (unsigned int y, unsigned int x, unsigned int n, uint32_t *dst)
+{
+	while (n > 0)
+	{
+		unsigned int run = span (x, n);
+		const unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+		{
+			std::fill (dst, dst + run, fills[tileOf (x, y)]);
+
+			x += run;
+			dst += run;
+			n -= run;
+			continue;
+		}
+
+		switch (type)
+		{
+		case STORAGE_U16:
+		{
+			const uint16_t *src = (const uint16_t *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = src[j];
+			}
+			break;
+		}
+		case STORAGE_U32:
+			memcpy (dst, p, run * sizeof (uint32_t));
+			break;
+		default:
+		{
+			const float *src = (const float *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = (uint32_t) fromFloat (src[j]);
+			}
+			break;
+		}
+		}
+
+		x += run;
+		dst += run;
+		n -= run;
+	}
+}
+
+// ===================================================================
+// setRow -- write n int32 values starting at (x,y)
+//
+// Negative values are stored as 0, otherwise this matches set().
+// ===================================================================
+void ImageBuffer::setRow (unsigned int y, unsigned int x, unsigned int n, const int32_t *src)
+{
+	unsigned int x0 = x;
+	unsigned int n0 = n;
+
+	while (n > 0)
+	{
+		unsigned int run = span (x, n);
+		unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+		{
+			size_t tile = tileOf (x, y);
+			bool same = true;
+
+			for (unsigned int j = 0; j < run; j++)
+			{
+				same &= (stored ((src[j] < 0) ? 0 : src[j]) == fills[tile]);
+			}
+
+			if (same)
+			{
+				x += run;
+				src += run;
+				n -= run;
+				continue;
+			}
+
+			p = materialize (tile) + within (x, y) * elementSize();
+		}
+
+		switch (type)
+		{
+		case STORAGE_U16:
+		{
+			uint16_t *dst = (uint16_t *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				int32_t v = src[j];
+				dst[j] = (v < 0) ? 0 : ((v > 0xffff) ? 0xffff : (uint16_t) v);
+			}
+			break;
+		}
+		case STORAGE_U32:
+		{
+			uint32_t *dst = (uint32_t *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = (src[j] < 0) ? 0 : (uint32_t) src[j];
+			}
+			break;
+		}
+		default:
+		{
+			float *dst = (float *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = (src[j] < 0) ? 0.0f : (float) src[j];
+			}
+			break;
+		}
+		}
+
+		x += run;
+		src += run;
+		n -= run;
+	}
+
+	markRow (y, x0, n0);
+
+	if (padding != PAD_ZERO)
+	{
+		refreshRow (y, x0, n0);
+	}
+}
+
+void ImageBuffer::setRow (unsigned int y, unsigned int x, unsigned int n, const uint32_t *src)
+{
+	unsigned int x0 = x;
+	unsigned int n0 = n;
+
+	while (n > 0)
+	{
+		unsigned int run = span (x, n);
+		unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+		{
+			size_t tile = tileOf (x, y);
+			bool same = true;
+
+			for (unsigned int j = 0; j < run; j++)
+			{
+				same &= (stored (src[j]) == fills[tile]);
+			}
+
+			if (same)
+			{
+				x += run;
+				src += run;
+				n -= run;
+				continue;
+			}
+
+			p = materialize (tile) + within (x, y) * elementSize();
+		}
+
+		switch (type)
+		{
+		case STORAGE_U16:
+		{
+			uint16_t *dst = (uint16_t *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = (src[j] > 0xffff) ? 0xffff : (uint16_t) src[j];
+			}
+			break;
+		}
+		case STORAGE_U32:
+			memcpy (p, src, run * sizeof (uint32_t));
+			break;
+		default:
+		{
+			float *dst = (float *) p;
+			for (unsigned int j = 0; j < run; j++)
+			{
+				dst[j] = (float) src[j];
+			}
+			break;
+		}
+		}
+
+		x += run;
+		src += run;
+		n -= run;
+	}
+
+	markRow (y, x0, n0);
+
+	if (padding != PAD_ZERO)
+	{
+		refreshRow (y, x0, n0);
+	}
+}
+
+// ===================================================================
+// copyRow -- copy n cells starting at (x,y) without conversion
+// ===================================================================
+void ImageBuffer::copyRow (unsigned int y, unsigned int x, unsigned int n, void *dst)
+{
+	size_t element = elementSize();
+	unsigned char *out = (unsigned char *) dst;
+
+	while (n > 0)
+	{
+		unsigned int run = span (x, n);
+		const unsigned char *p = locate (x, y);
+
+		if (p == NULL)
+			fillCells (out, run, fills[tileOf (x, y)]);
+		else
+			memcpy (out, p, run * element);
+
+		x += run;
+		out += run * element;
+		n -= run;
+	}
+}
+
+// ===================================================================
+// materialize -- give a sparse tile its own cells, all at its constant
+//
+// Two threads may write to the same new tile at once; the first one to
+// install its copy wins and the other's is thrown away.
+// ===================================================================
+unsigned char *ImageBuffer::materialize (size_t tile)
+{
+	size_t cells = (size_t) TILE * TILE;
+	HeapScope heap (HEAP_IMAGE);
+	unsigned char *cell = new unsigned char[cells * elementSize()];
+
+	fillCells (cell, cells, fills[tile]);
+
+	unsigned char *expected = NULL;
+	if (! sparse[tile].compare_exchange_strong (expected, cell, std::memory_order_acq_rel))
+	{
+		delete [] cell;
+		return expected;
+	}
+
+	materialized++;
+	return cell;
+}
+
+// ===================================================================
+// fillCells -- store value in n cells, as set() would
+// ===================================================================
+void ImageBuffer::fillCells (unsigned char *dst, size_t n, unsigned long value)
+{
+	if (value == 0)
+	{
+		memset (dst, 0, n * elementSize());
+		return;
+	}
+
+	switch (type)
+	{
+	case STORAGE_U16:
+		std::fill ((uint16_t *) dst, (uint16_t *) dst + n, (value > 0xffff) ? 0xffff : (uint16_t) value);
+		break;
+	case STORAGE_U32:
+		std::fill ((uint32_t *) dst, (uint32_t *) dst + n, (uint32_t) value);
+		break;
+	default:
+		std::fill ((float *) dst, (float *) dst + n, (float) value);
+		break;
+	}
+}
+
+void ImageBuffer::freeTiles ()
+{
+	if (sparse == NULL)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < tiles_x * tiles_y; i++)
+	{
+		delete [] sparse[i].exchange (NULL);
+	}
+	materialized = 0;
+}
+
+bool ImageBuffer::constantTile (unsigned int tx, unsigned int ty, unsigned long& value)
+{
+	if (sparse == NULL)
+	{
+		return false;
+	}
+
+	size_t tile = (size_t) ty * tiles_x + tx;
+	if (sparse[tile].load (std::memory_order_acquire) != NULL)
+	{
+		return false;
+	}
+
+	value = fills[tile];
+	return true;
+}
+
+// ===================================================================
+// uniform -- are the cells of a box known to hold one value?
+//
+// Only unwritten sparse tiles are known; a written tile may well hold a
+// single value, but finding out would mean reading it.
+// ===================================================================
+bool ImageBuffer::uniform (int x1, int y1, int x2, int y2, unsigned long& value)
+{
+	if (sparse == NULL)
+	{
+		return false;
+	}
+
+	int last_x = (int) size_x - 1;
+	int last_y = (int) size_y - 1;
+
+	x1 = (x1 < 0) ? 0 : x1;
+	y1 = (y1 < 0) ? 0 : y1;
+	x2 = (x2 > last_x) ? last_x : x2;
+	y2 = (y2 > last_y) ? last_y : y2;
+
+	bool first = true;
+
+	for (int ty = y1 >> TILE_SHIFT; ty <= (y2 >> TILE_SHIFT); ty++)
+	{
+		for (int tx = x1 >> TILE_SHIFT; tx <= (x2 >> TILE_SHIFT); tx++)
+		{
+			unsigned long v;
+			if (! constantTile (tx, ty, v) || (! first && (v != value)))
+			{
+				return false;
+			}
+
+			value = v;
+			first = false;
+		}
+	}
+
+	return ! first;
+}
+
+void ImageBuffer::fillTile (unsigned int tx, unsigned int ty, unsigned long value)
+{
+	if (sparse == NULL)
+	{
+		return;
+	}
+
+	size_t tile = (size_t) ty * tiles_x + tx;
+	unsigned char *cell = sparse[tile].exchange (NULL);
+
+	if (cell != NULL)
+	{
+		delete [] cell;
+		materialized--;
+	}
+
+	fills[tile] = (uint32_t) stored (value);
+	markDirty (tx * TILE, ty * TILE);
+}
+
+// ===================================================================
+// ghosts -- list coordinate c, and the halo coordinates holding copies
+// of it, along an axis of size cells
+// ===================================================================
+int ImageBuffer::ghosts (int c, int size, int *out)
+{
+	int h = (int) halo;
+	int n = 0;
+
+	out[n++] = c;
+
+	if (padding == PAD_CLAMP)
+	{
+		for (int i = 1; (c == 0) && (i <= h); i++)
+			out[n++] = -i;
+		for (int i = 0; (c == size - 1) && (i < h); i++)
+			out[n++] = size + i;
+	}
+	else
+	{
+		// reflected about the edge cells, which are not repeated
+		if ((c >= 1) && (c <= h))
+			out[n++] = -c;
+		if ((c >= size - 1 - h) && (c <= size - 2))
+			out[n++] = 2 * (size - 1) - c;
+	}
+
+	return n;
+}
+
+// ===================================================================
+// refreshHalo -- copy a cell near the edge out to the ghost cells which
+// repeat or reflect it
+// ===================================================================
+void ImageBuffer::refreshHalo (unsigned int x, unsigned int y)
+{
+	int xs[MAX_HALO + 2];
+	int ys[MAX_HALO + 2];
+	int nx = ghosts ((int) x, (int) size_x, xs);
+	int ny = ghosts ((int) y, (int) size_y, ys);
+
+	size_t element = elementSize();
+	const unsigned char *src = data + ((size_t) y * stride + x) * element;
+
+	for (int j = 0; j < ny; j++)
+	{
+		for (int i = 0; i < nx; i++)
+		{
+			if ((i > 0) || (j > 0))
+			{
+				memcpy (data + ((ptrdiff_t) ys[j] * (ptrdiff_t) stride + xs[i]) * (ptrdiff_t) element, src, element);
+			}
+		}
+	}
+}
+
+void ImageBuffer::refreshRow (unsigned int y, unsigned int x, unsigned int n)
+{
+	for (unsigned int i = x; i < x + n; i++)
+	{
+		if (nearEdge (i, y))
+		{
+			refreshHalo (i, y);
+		}
+	}
+}
+
+// ===================================================================
+// trackWrites -- start flagging the tiles which are written
+// ===================================================================
+void ImageBuffer::trackWrites ()
+{
+	size_t tiles = tiles_x * tiles_y;
+	HeapScope heap (HEAP_IMAGE);
+
+	dirty.reset (new std::atomic<uint8_t>[tiles]);
+	for (size_t i = 0; i < tiles; i++)
+	{
+		dirty[i] = 1;
+	}
+	dirtyTiles = (long) tiles;
+}
+
+bool ImageBuffer::takeDirty (size_t tile)
+{
+	if ((dirty == NULL) || ! dirty[tile].exchange (0))
+	{
+		return false;
+	}
+
+	dirtyTiles--;
+	return true;
+}
+
+void ImageBuffer::markRow (unsigned int y, unsigned int x, unsigned int n)
+{
+	if ((dirty == NULL) || (n == 0))
+	{
+		return;
+	}
+
+	for (unsigned int tx = x >> TILE_SHIFT; tx <= ((x + n - 1) >> TILE_SHIFT); tx++)
+	{
+		markDirty (tx << TILE_SHIFT, y);
+	}
+}
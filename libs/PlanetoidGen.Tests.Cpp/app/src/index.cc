@@ -1,10 +1,9 @@
 #include "index.h"
+#include "params.h"
 
-Index::Index (uint x, uint y) : Image (x, y)
+Index::Index (uint x, uint y) : Image (x, y, STORAGE_U32, Params::Instance().storage_layout)
 {
-	for (int i = 0; i < x; i++)
-		for (int j = 0; j < y; j++)
-			Set(i,j, 0);
+	// storage is zeroed on allocation
 }
 
 Index::~Index ()
@@ -29,9 +28,7 @@ void Index::SetPrimary (uint x, uint y, uchar texture_id, uchar alpha)
 	}
 
 	ulong current = Get (x, y);
-	ulong next = (texture_id << 24) | (alpha << 16) |
-		 (current & 0xffff);
-	Set (x, y, next);
+	Set (x, y, Pack (texture_id, alpha, 0, 0) | (current & 0xffff));
 }
 
 void Index::SetSecondary (uint x, uint y, uchar texture_id, uchar alpha)
@@ -43,9 +40,26 @@ void Index::SetSecondary (uint x, uint y, uchar texture_id, uchar alpha)
 	}
 
 	ulong current = Get (x, y);
-	ulong next = (current & 0xffff0000) |
-		(texture_id << 8) | alpha;
-	Set (x, y, next);
+	Set (x, y, (current & 0xffff0000) | Pack (0, 0, texture_id, alpha));
+}
+
+void Index::SetTexture (uint x, uint y, uchar texture_id, uchar alpha)
+{
+	if (! in_range (x, y))
+	{
+		fprintf (stderr, "SetTexture: (%d,%d) out of range\n", x, y);
+		return;
+	}
+
+	Set (x, y, Pack (texture_id, alpha, texture_id, alpha));
+}
+
+// ===================================================================
+// FillTexture -- the whole map one texture, as a single bulk fill
+// ===================================================================
+void Index::FillTexture (uchar texture_id, uchar alpha)
+{
+	Fill (Pack (texture_id, alpha, texture_id, alpha));
 }
 
 // ===================================================================
@@ -1,13 +1,47 @@
 #include "logger.h"
+#include "generationcontext.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+static const char *level_names[] = {"trace", "debug", "info", "warn", "error", "off"};
+static const char *category_names[] = {"general", "mask", "agents", "terrain", "water", "storage"};
 
 Logger::Logger ()
+	: ring (new Slot[SLOTS])
 {
 	logfile = NULL;
+	level = LOG_LEVEL_INFO;
+	categories = (1u << LOG_CATEGORIES) - 1;
+
+	for (unsigned int i = 0; i < SLOTS; i++)
+	{
+		ring[i].sequence.store (i, std::memory_order_relaxed);
+	}
+
+	tail = 0;
+	head = 0;
+	written = 0;
+	sleeping = false;
+	stopping = false;
+}
+
+Logger::~Logger ()
+{
+	stop ();
 }
 
 std::unique_ptr<Logger> Logger::_instance;
 Logger& Logger::Instance()
 {
+	GenerationContext *context = GenerationContext::Current();
+
+	if ((context != NULL) && (context->getLogger() != NULL))
+	{
+		return *context->getLogger();
+	}
+
 	if (_instance.get() == NULL)
 	{
 		_instance.reset (new Logger);
@@ -17,34 +51,296 @@ Logger& Logger::Instance()
 }
 
 // ===================================================================
-// Log -- log a message to a file, like printf
+// SetLog -- change the file messages go to
+//
+// The writer thread runs while there is a file.  Levels and categories
+// should be set before other threads start logging.
 // ===================================================================
-void Logger::Log (const char *fmt, ...)
+void Logger::SetLog (FILE *l)
 {
-	va_list ap;
+	stop ();
+
+	logfile = l;
 
 	if (logfile != NULL)
 	{
-		va_start (ap, fmt);
-		vfprintf (logfile, fmt, ap);
-		va_end (ap);
+		writer = std::thread (&Logger::drain, this);
 	}
 }
 
-void Logger::SetLog (FILE *l)
+void Logger::SetLevel (LogLevel l)
 {
-	logfile = l;
-	setbuf (logfile, NULL);
+	level = l;
+}
+
+void Logger::SetCategories (unsigned int mask)
+{
+	categories = mask;
 }
 
+// ===================================================================
+// Log -- log a message to a file, like printf
+// ===================================================================
+void Logger::Log (LogLevel l, LogCategory c, const char *fmt, ...)
+{
+	if (! Enabled (l, c))
+	{
+		return;
+	}
+
+	char buffer[512];
+	va_list ap;
+
+	va_start (ap, fmt);
+	int n = vsnprintf (buffer, sizeof (buffer), fmt, ap);
+	va_end (ap);
+
+	if (n < 0)
+	{
+		return;
+	}
+
+	if ((size_t) n < sizeof (buffer))
+	{
+		push (buffer, n);
+		return;
+	}
+
+	std::vector<char> longer (n + 1);
+
+	va_start (ap, fmt);
+	vsnprintf (longer.data(), longer.size(), fmt, ap);
+	va_end (ap);
+
+	push (longer.data(), n);
+}
 
 // ===================================================================
 // Log -- log a message to a file, using std::string
 // ===================================================================
-void Logger::Log (std::string msg)
+void Logger::Log (LogLevel l, LogCategory c, const std::string& msg)
 {
-	if (logfile != NULL)
+	if (! Enabled (l, c))
+	{
+		return;
+	}
+
+	std::string line = msg + "\n";
+	push (line.data(), line.size());
+}
+
+// ===================================================================
+// push -- copy a message into consecutive slots of the ring
+//
+// One atomic add claims all the slots a message needs, so the writer
+// finds it whole and in the order the tickets were handed out.  A slot
+// is free again once its sequence has gone round to the ticket.
+// ===================================================================
+void Logger::push (const char *text, size_t length)
+{
+	length = std::min (length, (size_t) MAX_SLOTS * SLOT_TEXT);
+
+	size_t count = (length + SLOT_TEXT - 1) / SLOT_TEXT;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	uint64_t ticket = tail.fetch_add (count);
+
+	for (size_t k = 0; k < count; k++)
 	{
-		fprintf (logfile, "%s\n", msg.c_str());
+		Slot& slot = ring[(ticket + k) & (SLOTS - 1)];
+
+		while (slot.sequence.load (std::memory_order_acquire) != ticket + k)
+		{
+			// the ring is full
+			wakeWriter ();
+			std::this_thread::yield ();
+		}
+
+		size_t n = std::min (length, (size_t) SLOT_TEXT);
+
+		memcpy (slot.text, text, n);
+		slot.length = (uint32_t) n;
+		text += n;
+		length -= n;
+
+		slot.sequence.store (ticket + k + 1);
 	}
+
+	wakeWriter ();
+}
+
+void Logger::wakeWriter ()
+{
+	if (sleeping.load () && sleeping.exchange (false))
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		wake.notify_one ();
+	}
+}
+
+// ===================================================================
+// drain -- the writer thread: write out filled slots as they appear
+//
+// It sleeps when the ring is empty, until a message arrives or a
+// while has passed.
+// ===================================================================
+void Logger::drain ()
+{
+	const size_t BATCH = 64 * 1024;
+	std::vector<char> batch;
+
+	batch.reserve (BATCH);
+
+	for (;;)
+	{
+		for (;;)
+		{
+			Slot& slot = ring[head & (SLOTS - 1)];
+
+			if (slot.sequence.load (std::memory_order_acquire) != head + 1)
+			{
+				break;
+			}
+
+			batch.insert (batch.end(), slot.text, slot.text + slot.length);
+			slot.sequence.store (head + SLOTS, std::memory_order_release);
+			head++;
+
+			if (batch.size() >= BATCH)
+			{
+				fwrite (batch.data(), 1, batch.size(), logfile);
+				batch.clear ();
+			}
+		}
+
+		if (! batch.empty ())
+		{
+			fwrite (batch.data(), 1, batch.size(), logfile);
+			fflush (logfile);
+			batch.clear ();
+		}
+
+		std::unique_lock<std::mutex> guard (lock);
+
+		written = head;
+		drained.notify_all ();
+
+		if (stopping)
+		{
+			break;
+		}
+
+		// a message published after this store is seen by the check below,
+		// or its writer sees the flag and wakes us
+		sleeping = true;
+
+		if (ring[head & (SLOTS - 1)].sequence.load () == head + 1)
+		{
+			sleeping = false;
+			continue;
+		}
+
+		wake.wait_for (guard, std::chrono::milliseconds (100),
+			[this] {return ! sleeping.load () || stopping;});
+		sleeping = false;
+	}
+}
+
+// ===================================================================
+// Flush -- wait for the writer to catch up with every message so far
+// ===================================================================
+void Logger::Flush ()
+{
+	if (! writer.joinable ())
+	{
+		return;
+	}
+
+	uint64_t target = tail.load ();
+	std::unique_lock<std::mutex> guard (lock);
+
+	sleeping = false;
+	wake.notify_one ();
+	drained.wait (guard, [this, target] {return written.load () >= target;});
+}
+
+void Logger::stop ()
+{
+	if (! writer.joinable ())
+	{
+		return;
+	}
+
+	Flush ();
+
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		stopping = true;
+		wake.notify_one ();
+	}
+
+	writer.join ();
+	stopping = false;
+}
+
+bool Logger::ParseLevel (const std::string& name, LogLevel& l)
+{
+	for (int i = LOG_LEVEL_TRACE; i <= LOG_LEVEL_OFF; i++)
+	{
+		if (name.compare (level_names[i]) == 0)
+		{
+			l = (LogLevel) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ===================================================================
+// ParseCategories -- "all", or category names separated by commas
+// ===================================================================
+bool Logger::ParseCategories (const std::string& names, unsigned int& mask)
+{
+	if (names.compare ("all") == 0)
+	{
+		mask = (1u << LOG_CATEGORIES) - 1;
+		return true;
+	}
+
+	unsigned int result = 0;
+	size_t start = 0;
+
+	while (start <= names.size())
+	{
+		size_t end = names.find (',', start);
+
+		if (end == std::string::npos)
+		{
+			end = names.size();
+		}
+
+		std::string name = names.substr (start, end - start);
+		int c = 0;
+
+		while ((c < LOG_CATEGORIES) && (name.compare (category_names[c]) != 0))
+		{
+			c++;
+		}
+
+		if (c == LOG_CATEGORIES)
+		{
+			return false;
+		}
+
+		result |= 1u << c;
+		start = end + 1;
+	}
+
+	mask = result;
+	return true;
 }
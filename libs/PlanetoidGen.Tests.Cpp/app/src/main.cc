@@ -1,100 +1,3 @@
-#define TRACK_MEMORY 0
-
-#if TRACK_MEMORY == 1
-#include <cstdlib>
-#include <new>
-#include <limits>
-#include <unordered_map>
-#include <memory>
-
-template <class T>
-struct Mallocator
-{
-    typedef T value_type;
-
-    Mallocator() = default;
-    template <class U> constexpr Mallocator(const Mallocator <U>&) noexcept {}
-
-    [[nodiscard]] T* allocate(std::size_t n) {
-        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
-            throw std::bad_array_new_length();
-
-        if (auto p = static_cast<T*>(std::malloc(n * sizeof(T)))) {
-            return p;
-        }
-
-        throw std::bad_alloc();
-    }
-
-    void deallocate(T* p, std::size_t n) noexcept {
-        std::free(p);
-    }
-};
-
-template <class T, class U>
-bool operator==(const Mallocator <T>&, const Mallocator <U>&) { return true; }
-template <class T, class U>
-bool operator!=(const Mallocator <T>&, const Mallocator <U>&) { return false; }
-
-static size_t usedBytes = 0;
-static size_t usedBytesTotal = 0;
-static size_t usedBytesMax = 0;
-using mymap = std::unordered_map<void*, size_t, std::hash<void*>, std::equal_to<void*>, Mallocator<std::pair<void* const, size_t>>>;
-static mymap* usedAllocs = nullptr;
-
-// Overloading Global new operator
-void* operator new(size_t sz)
-{
-    if (usedAllocs == nullptr)
-    {
-        usedAllocs = new (malloc(sizeof(mymap))) mymap();
-    }
-
-    void* m = malloc(sz);
-
-    usedBytes += sz;
-    usedBytesTotal += sz;
-    if (usedBytes > usedBytesMax) usedBytesMax = usedBytes;
-    usedAllocs->insert({ m, sz });
-
-    return m;
-}
-// Overloading Global delete operator
-void operator delete(void* m)
-{
-    free(m);
-
-    usedBytes -= (*usedAllocs)[m];
-    usedAllocs->erase(m);
-}
-// Overloading Global new[] operator
-void* operator new[](size_t sz)
-{
-    if (usedAllocs == nullptr)
-    {
-        usedAllocs = new (malloc(sizeof(mymap))) mymap();
-    }
-
-    void* m = malloc(sz);
-
-    usedBytes += sz;
-    usedBytesTotal += sz;
-    if (usedBytes > usedBytesMax) usedBytesMax = usedBytes;
-    usedAllocs->insert({ m, sz });
-
-    return m;
-}
-// Overloading Global delete[] operator
-void operator delete[](void* m)
-{
-    free(m);
-
-    usedBytes -= (*usedAllocs)[m];
-    usedAllocs->erase(m);
-}
-
-#endif
-
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
@@ -114,6 +17,7 @@ void operator delete[](void* m)
 // Agents
 #include "MountainAgent.h"
 #include "SmoothAgent.h"
+#include "SweepSmoothAgent.h"
 #include "ShoreLineAgent.h"
 #include "RiverAgent.h"
 #include "ErosionAgent.h"
@@ -122,6 +26,12 @@ void operator delete[](void* m)
 
 #define LOGGING 1
 #include "params.h"
+#include "random.h"
+#include "generationcontext.h"
+#include "heaptrack.h"
+#include "threadpool.h"
+#include <atomic>
+#include <algorithm>
 
 using namespace std;
 
@@ -129,20 +39,32 @@ FILE *logfile = NULL;
 int repeatTimes = 0;
 
 string exe_name;
+bool name_given = false;				// -name was used, so per-seed names keep it
 
 const char *boolstring (bool flag);
+const char *storageName (StorageType t);
 
-void generate ();
+bool generate (GenerationContext& context);
+bool generateSeeds ();
 void logParams ();
 
-unique_ptr<Params> Params::_instance;
-
 void usage ()
 {
 	fprintf (stderr, "Usage:  %s  [-seed seed]\n", exe_name.c_str());
 	fprintf (stderr, "            [-x width] [-y height]\n");
 	fprintf (stderr, "            [-name map-name]\n");
 	fprintf (stderr, "            [-size n]\n");
+	fprintf (stderr, "            [-height_storage u16|u32|f32]\n");
+	fprintf (stderr, "            [-storage dense|tiled|sparse] [-scratch directory] [-resident_mb n]\n");
+	fprintf (stderr, "            [-halo zero|clamp|mirror]\n");
+	fprintf (stderr, "            [-coast_distance]\n");
+	fprintf (stderr, "            [-raw r16|r32f] [-raw_header]\n");
+	fprintf (stderr, "            [-lod_levels n]\n");
+	fprintf (stderr, "            [-log_level trace|debug|info|warn|error|off]\n");
+	fprintf (stderr, "            [-log_categories all|general,mask,agents,terrain,water,storage]\n");
+	fprintf (stderr, "            [-threads n] [-deterministic] [-lease_tile n]\n");
+	fprintf (stderr, "            [-seeds n] [-jobs n] [-output_prefix prefix]\n");
+	fprintf (stderr, "            [-report file.json] [-heap_track] [-trace file.json]\n");
 
 	exit (1);
 }
@@ -180,6 +102,7 @@ void process_arglist (Arglist *args)
 		if (args->getArg(i).compare("-name") == 0)
 		{
 			p.name = args->getArg(++i);
+			name_given = true;
 			continue;
 		}
 
@@ -231,6 +154,184 @@ void process_arglist (Arglist *args)
 			continue;
 		}
 
+		if (args->getArg(i).compare("-height_storage") == 0)
+		{
+			string storage = args->getArg(++i);
+
+			if (storage.compare("u16") == 0)
+				p.height_storage = STORAGE_U16;
+			else if (storage.compare("u32") == 0)
+				p.height_storage = STORAGE_U32;
+			else if (storage.compare("f32") == 0)
+				p.height_storage = STORAGE_F32;
+			else
+			{
+				fprintf (stderr, "unknown height storage %s\n", storage.c_str());
+				usage ();
+			}
+			continue;
+		}
+
+		if (args->getArg(i).compare("-threads") == 0)
+		{
+			p.threads = atol (args->getArg(++i).c_str());
+			continue;
+		}
+
+		if (args->getArg(i).compare("-deterministic") == 0)
+		{
+			p.deterministic = true;
+			continue;
+		}
+
+		if (args->getArg(i).compare("-lease_tile") == 0)
+		{
+			p.lease_tile = atol (args->getArg(++i).c_str());
+			continue;
+		}
+
+		if (args->getArg(i).compare("-seeds") == 0)
+		{
+			p.num_seeds = atol (args->getArg(++i).c_str());
+			continue;
+		}
+
+		if (args->getArg(i).compare("-jobs") == 0)
+		{
+			p.jobs = atol (args->getArg(++i).c_str());
+			continue;
+		}
+
+		if (args->getArg(i).compare("-output_prefix") == 0)
+		{
+			p.output_prefix = args->getArg(++i);
+			continue;
+		}
+
+		if (args->getArg(i).compare("-report") == 0)
+		{
+			p.report = args->getArg(++i);
+			continue;
+		}
+
+		if (args->getArg(i).compare("-heap_track") == 0)
+		{
+			p.heap_track = true;
+			continue;
+		}
+
+		if (args->getArg(i).compare("-trace") == 0)
+		{
+			p.trace = args->getArg(++i);
+			continue;
+		}
+
+		if (args->getArg(i).compare("-storage") == 0)
+		{
+			string layout = args->getArg(++i);
+
+			if (layout.compare("dense") == 0)
+				p.storage_layout = LAYOUT_DENSE;
+			else if (layout.compare("tiled") == 0)
+				p.storage_layout = LAYOUT_TILED;
+			else if (layout.compare("sparse") == 0)
+				p.storage_layout = LAYOUT_SPARSE;
+			else
+			{
+				fprintf (stderr, "unknown storage layout %s\n", layout.c_str());
+				usage ();
+			}
+			continue;
+		}
+
+		if (args->getArg(i).compare("-halo") == 0)
+		{
+			string halo = args->getArg(++i);
+
+			if (halo.compare("zero") == 0)
+				p.halo_padding = PAD_ZERO;
+			else if (halo.compare("clamp") == 0)
+				p.halo_padding = PAD_CLAMP;
+			else if (halo.compare("mirror") == 0)
+				p.halo_padding = PAD_MIRROR;
+			else
+			{
+				fprintf (stderr, "unknown halo padding %s\n", halo.c_str());
+				usage ();
+			}
+			continue;
+		}
+
+		if (args->getArg(i).compare("-scratch") == 0)
+		{
+			p.scratch_dir = args->getArg(++i);
+			continue;
+		}
+
+		if (args->getArg(i).compare("-resident_mb") == 0)
+		{
+			p.resident_mb = atol (args->getArg(++i).c_str());
+			continue;
+		}
+
+		if (args->getArg(i).compare("-coast_distance") == 0)
+		{
+			p.write_coast_distance = true;
+			continue;
+		}
+
+		if (args->getArg(i).compare("-raw") == 0)
+		{
+			string raw = args->getArg(++i);
+
+			if (raw.compare("r16") == 0)
+				p.raw_format = RAW_R16;
+			else if (raw.compare("r32f") == 0)
+				p.raw_format = RAW_R32F;
+			else
+			{
+				fprintf (stderr, "unknown raw format %s\n", raw.c_str());
+				usage ();
+			}
+			continue;
+		}
+
+		if (args->getArg(i).compare("-raw_header") == 0)
+		{
+			p.raw_header = true;
+			continue;
+		}
+
+		if (args->getArg(i).compare("-lod_levels") == 0)
+		{
+			p.lod_levels = atol (args->getArg(++i).c_str());
+			continue;
+		}
+
+		if (args->getArg(i).compare("-log_level") == 0)
+		{
+			string level = args->getArg(++i);
+
+			if (! Logger::ParseLevel (level, p.log_level))
+			{
+				fprintf (stderr, "unknown log level %s\n", level.c_str());
+				usage ();
+			}
+			continue;
+		}
+
+		if (args->getArg(i).compare("-log_categories") == 0)
+		{
+			string categories = args->getArg(++i);
+
+			if (! Logger::ParseCategories (categories, p.log_categories))
+			{
+				fprintf (stderr, "unknown log categories %s\n", categories.c_str());
+				usage ();
+			}
+			continue;
+		}
+
 		// ===== Agent counts and tokens  =====
 		if (args->getArg(i).compare("-num_mountain_agents") == 0)
 		{
@@ -278,6 +379,31 @@ void process_arglist (Arglist *args)
 			p.hill_tokens = atol (args->getArg(++i).c_str());
 			continue;
 		}
+		if (args->getArg(i).compare("-mountain_weight") == 0)
+		{
+			p.mountain_weight = atol (args->getArg(++i).c_str());
+			continue;
+		}
+		if (args->getArg(i).compare("-beach_weight") == 0)
+		{
+			p.beach_weight = atol (args->getArg(++i).c_str());
+			continue;
+		}
+		if (args->getArg(i).compare("-smooth_weight") == 0)
+		{
+			p.smooth_weight = atol (args->getArg(++i).c_str());
+			continue;
+		}
+		if (args->getArg(i).compare("-hill_weight") == 0)
+		{
+			p.hill_weight = atol (args->getArg(++i).c_str());
+			continue;
+		}
+		if (args->getArg(i).compare("-river_weight") == 0)
+		{
+			p.river_weight = atol (args->getArg(++i).c_str());
+			continue;
+		}
 
 		// =====  Coastline Agent Params =====
 		if (args->getArg(i).compare("-action_size_min") == 0)
@@ -472,6 +598,10 @@ void process_arglist (Arglist *args)
 	p.num_x_pages = (p.x_size + p.page_size - 1) / p.page_size;
 	p.num_y_pages = (p.y_size + p.page_size - 1) / p.page_size;
 
+	Logger::Instance().SetLevel (p.log_level);
+	Logger::Instance().SetCategories (p.log_categories);
+	HeapTrack::Enable (p.heap_track);
+
 #if LOGGING
 	logParams ();
 #endif
@@ -485,48 +615,95 @@ const char *boolstring (bool flag)
 		return "false";
 }
 
+const char *storageName (StorageType t)
+{
+	switch (t)
+	{
+	case STORAGE_U16:
+		return "u16";
+	case STORAGE_F32:
+		return "f32";
+	default:
+		return "u32";
+	}
+}
+
 void logParams ()
 {
 	Params& params = Params::Instance();
 
-	Logger::Instance().Log ("seed = %d\n", params.seed);
-	Logger::Instance().Log ("x_size = %d, y_size = %d\n", params.x_size, params.y_size);
-	Logger::Instance().Log ("noise_size = %d\n", params.noise_size);
-	Logger::Instance().Log ("altitude limit = %d\n", params.height_limit);
-	Logger::Instance().Log ("coverage = %d\n", params.coverage);
-	Logger::Instance().Log ("num_mountain_agents = %d\n", params.num_mountain_agents);
-	Logger::Instance().Log ("num_beach_agents = %d\n", params.num_beach_agents);
-	Logger::Instance().Log ("num_smooth_agents = %d\n", params.num_smooth_agents);
-	Logger::Instance().Log ("num_hill_agents = %d\n", params.num_hill_agents);
-	Logger::Instance().Log ("num_river_agents = %d\n", params.num_river_agents);
-	Logger::Instance().Log ("mountain tokens = %d\n", params.mountain_tokens);
-	Logger::Instance().Log ("beach tokens = %d\n", params.beach_tokens);
-	Logger::Instance().Log ("smooth tokens = %d\n", params.smooth_tokens);
-	Logger::Instance().Log ("hill tokens = %d\n", params.hill_tokens);
-	Logger::Instance().Log ("mountain max alt = %d\n", params.mountain_max_alt);
-	Logger::Instance().Log ("mountain variance = %d\n", params.mountain_variance);
-	Logger::Instance().Log ("mountain width = %d\n", params.mountain_width);
-	Logger::Instance().Log ("mountain slope min = %d, slope max = %d\n", params.mountain_slope_min, params.mountain_slope_max);
-	Logger::Instance().Log ("mountain rough prob = %d/100\n", params.mountain_rough_prob);
-	Logger::Instance().Log ("mountain rough var = %d\n", params.mountain_rough_var);
-	Logger::Instance().Log ("foothill freq = %d\n", params.foothill_freq);
-	Logger::Instance().Log ("foothill min length = %d, max length = %d\n", params.foothill_min_length, params.foothill_max_length);
-	Logger::Instance().Log ("hill max alt = %d\n", params.hill_max_alt);
-	Logger::Instance().Log ("hill variance = %d\n", params.hill_variance);
-	Logger::Instance().Log ("action size min = %d, max = %d\n", params.action_size_min, params.action_size_max);
-	Logger::Instance().Log ("minimum river length = %d, initial dropoff = %d, height limit = %d\n",
+	LOG_INFO (LOG_GENERAL, "seed = %d\n", params.seed);
+	LOG_INFO (LOG_GENERAL, "x_size = %d, y_size = %d\n", params.x_size, params.y_size);
+	LOG_INFO (LOG_GENERAL, "noise_size = %d\n", params.noise_size);
+	LOG_INFO (LOG_GENERAL, "altitude limit = %d\n", params.height_limit);
+	LOG_INFO (LOG_GENERAL, "height storage = %s\n", storageName (params.height_storage));
+	if (params.storage_layout == LAYOUT_TILED)
+	{
+		LOG_INFO (LOG_GENERAL, "tiled storage in %s, %d MB resident per image\n",
+			params.scratch_dir.c_str(), params.resident_mb);
+	}
+	else if (params.storage_layout == LAYOUT_SPARSE)
+	{
+		LOG_INFO (LOG_GENERAL, "sparse storage, unwritten tiles are not allocated\n");
+	}
+	if (params.halo_padding != PAD_ZERO)
+	{
+		LOG_INFO (LOG_GENERAL, "heightmap halo %s the edge\n", (params.halo_padding == PAD_CLAMP) ? "repeats" : "mirrors");
+	}
+	if (params.raw_format != RAW_NONE)
+	{
+		LOG_INFO (LOG_GENERAL, "raw heights = %s%s\n", (params.raw_format == RAW_R16) ? "r16" : "r32f",
+			params.raw_header ? " with header" : "");
+	}
+	if (params.lod_levels > 0)
+	{
+		LOG_INFO (LOG_GENERAL, "lod levels = %d\n", params.lod_levels);
+	}
+	LOG_INFO (LOG_GENERAL, "threads = %d, deterministic = %s, lease tile = %d\n",
+		params.threads, boolstring (params.deterministic), params.lease_tile);
+	LOG_INFO (LOG_GENERAL, "seeds = %d, jobs = %d, output prefix = '%s'\n",
+		params.num_seeds, params.jobs, params.output_prefix.c_str());
+	LOG_INFO (LOG_GENERAL, "heap tracking = %s\n", boolstring (params.heap_track));
+	if (! params.trace.empty())
+	{
+		LOG_INFO (LOG_GENERAL, "trace = %s\n", params.trace.c_str());
+	}
+	LOG_INFO (LOG_GENERAL, "coverage = %d\n", params.coverage);
+	LOG_INFO (LOG_GENERAL, "num_mountain_agents = %d\n", params.num_mountain_agents);
+	LOG_INFO (LOG_GENERAL, "num_beach_agents = %d\n", params.num_beach_agents);
+	LOG_INFO (LOG_GENERAL, "num_smooth_agents = %d\n", params.num_smooth_agents);
+	LOG_INFO (LOG_GENERAL, "num_hill_agents = %d\n", params.num_hill_agents);
+	LOG_INFO (LOG_GENERAL, "num_river_agents = %d\n", params.num_river_agents);
+	LOG_INFO (LOG_GENERAL, "mountain tokens = %d\n", params.mountain_tokens);
+	LOG_INFO (LOG_GENERAL, "beach tokens = %d\n", params.beach_tokens);
+	LOG_INFO (LOG_GENERAL, "smooth tokens = %d\n", params.smooth_tokens);
+	LOG_INFO (LOG_GENERAL, "hill tokens = %d\n", params.hill_tokens);
+	LOG_INFO (LOG_GENERAL, "scheduling weights: mountain %d, beach %d, smooth %d, hill %d, river %d\n",
+		params.mountain_weight, params.beach_weight, params.smooth_weight, params.hill_weight, params.river_weight);
+	LOG_INFO (LOG_GENERAL, "mountain max alt = %d\n", params.mountain_max_alt);
+	LOG_INFO (LOG_GENERAL, "mountain variance = %d\n", params.mountain_variance);
+	LOG_INFO (LOG_GENERAL, "mountain width = %d\n", params.mountain_width);
+	LOG_INFO (LOG_GENERAL, "mountain slope min = %d, slope max = %d\n", params.mountain_slope_min, params.mountain_slope_max);
+	LOG_INFO (LOG_GENERAL, "mountain rough prob = %d/100\n", params.mountain_rough_prob);
+	LOG_INFO (LOG_GENERAL, "mountain rough var = %d\n", params.mountain_rough_var);
+	LOG_INFO (LOG_GENERAL, "foothill freq = %d\n", params.foothill_freq);
+	LOG_INFO (LOG_GENERAL, "foothill min length = %d, max length = %d\n", params.foothill_min_length, params.foothill_max_length);
+	LOG_INFO (LOG_GENERAL, "hill max alt = %d\n", params.hill_max_alt);
+	LOG_INFO (LOG_GENERAL, "hill variance = %d\n", params.hill_variance);
+	LOG_INFO (LOG_GENERAL, "action size min = %d, max = %d\n", params.action_size_min, params.action_size_max);
+	LOG_INFO (LOG_GENERAL, "minimum river length = %d, initial dropoff = %d, height limit = %d\n",
 		params.min_river_length, params.river_initialdrop, params.river_heightlimit);
-	Logger::Instance().Log ("river widen freq = %d, initial width = %d, slope = %d\n",
+	LOG_INFO (LOG_GENERAL, "river widen freq = %d, initial width = %d, slope = %d\n",
 		params.river_widen_freq, params.river_initial_width, params.river_slope);
-	Logger::Instance().Log ("river max shore = %d, min mountain = %d, min coast distance to mountain = %d\n",
+	LOG_INFO (LOG_GENERAL, "river max shore = %d, min mountain = %d, min coast distance to mountain = %d\n",
 		params.river_max_shore, params.river_min_mountain, params.river_mountain_coast_dist);
-	Logger::Instance().Log ("beach highland limit = %d, min alt = %d, max alt = %d\n",
+	LOG_INFO (LOG_GENERAL, "beach highland limit = %d, min alt = %d, max alt = %d\n",
 		params.beach_highland_limit, params.beach_min_alt, params.beach_max_alt);
-	Logger::Instance().Log ("beach interior points = %d, interior distance = %d\n",
+	LOG_INFO (LOG_GENERAL, "beach interior points = %d, interior distance = %d\n",
 		params.beach_interior_points, params.beach_interior_distance);
-	Logger::Instance().Log ("beach walk min = %d, walk variance = %d\n",
+	LOG_INFO (LOG_GENERAL, "beach walk min = %d, walk variance = %d\n",
 		params.beach_walk_min, params.beach_walk_variance);
-	Logger::Instance().Log ("smooth num resets = %d\n", params.smooth_num_resets);
+	LOG_INFO (LOG_GENERAL, "smooth num resets = %d\n", params.smooth_num_resets);
 }
 
 int main (int argc, char **argv)
@@ -579,16 +756,11 @@ int main (int argc, char **argv)
 	}
 
     using Clock = std::chrono::high_resolution_clock;
+    int status = 0;
 
     for (int i = 0; i < repeatTimes; ++i)
     {
-#if TRACK_MEMORY == 1
-        usedBytes = 0;
-        usedBytesMax = 0;
-        usedBytesTotal = 0;
-#endif
-        srand(params.seed);
-
+        HeapTrack::Reset();
 #if _WIN32
         system("del /q .\\*.png");
 #else
@@ -596,37 +768,147 @@ int main (int argc, char **argv)
 #endif
 
         auto begin = Clock::now();
-        generate();
+        bool written = generateSeeds();
         auto end = Clock::now();
 
-#if TRACK_MEMORY == 1
-        std::cout << "Time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << " Bytes total: " << usedBytesTotal << " Bytes max: " << usedBytesMax << std::endl;
-#else
-        std::cout << "Time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << std::endl;
-#endif
+        if (HeapTrack::Enabled())
+        {
+            std::cout << "Time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()
+                << " Bytes total: " << HeapTrack::Total().allocated << " Bytes max: " << HeapTrack::Total().peak << std::endl;
+        }
+        else
+        {
+            std::cout << "Time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << std::endl;
+        }
+
+        // the writers only report failures, the process ends here
+        if (! written)
+        {
+            fprintf (stderr, "%s: some maps or their output could not be written, see the logs\n", exe_name.c_str());
+            status = 1;
+            break;
+        }
     }
 
 #if LOGGING
+	Logger::Instance().SetLog (NULL);
 	fclose (logfile);
 #endif
-    return 0;
+    return status;
+}
+
+// ===================================================================
+// generateSeeds -- generate num_seeds maps from consecutive seeds
+//
+// One map is generated here and logs to log.txt.  Several are given a
+// context each, with the seed in their output prefix and a log of their
+// own, and up to 'jobs' of them run at once on the thread pool.
+//
+// Returns false if any map could not be generated or its output written.
+// ===================================================================
+bool generateSeeds ()
+{
+	Params& params = Params::Instance();
+
+	if (params.num_seeds <= 1)
+	{
+		GenerationContext context (params);
+		return generate (context);
+	}
+
+	std::atomic<int> failed (0);
+
+	auto runSeed = [&params, &failed] (int i)
+	{
+		Params seedParams = params;
+		ostringstream prefix;
+		ostringstream name;
+
+		seedParams.seed = params.seed + i;
+		prefix << params.output_prefix << "seed" << seedParams.seed << "_";
+		seedParams.output_prefix = prefix.str();
+
+		if (! name_given)
+		{
+			name << "seed" << seedParams.seed;
+			seedParams.name = name.str();
+		}
+
+		GenerationContext context (seedParams);
+
+		// the seed is skipped, and counted as failed, without a log of its own
+		if (! context.openLog (seedParams.output_prefix + "log.txt"))
+		{
+			failed++;
+			return;
+		}
+
+		{
+			ContextScope scope (&context);
+			logParams ();
+		}
+
+		if (! generate (context))
+		{
+			failed++;
+		}
+	};
+
+	int runners = std::min (params.jobs, params.num_seeds);
+
+	if (runners <= 1)
+	{
+		for (int i = 0; i < params.num_seeds; i++)
+		{
+			runSeed (i);
+		}
+		return failed == 0;
+	}
+
+	ThreadPool& pool = ThreadPool::Instance();
+	std::atomic<int> next (0);
+
+	for (int r = 0; r < runners; r++)
+	{
+		pool.submit ([&params, &next, &runSeed] ()
+		{
+			int i;
+
+			while ((i = next++) < params.num_seeds)
+			{
+				runSeed (i);
+			}
+		});
+	}
+
+	pool.wait ();
+	return failed == 0;
 }
 
-void generate ()
+// ===================================================================
+// generate -- build one map in the given context
+//
+// Returns false if any of its output could not be written.
+// ===================================================================
+bool generate (GenerationContext& context)
 {
+	ContextScope scope (&context);
 	Params& params = Params::Instance();
 
-	Logger::Instance().Log ("starting map generation at %s\n", Executive::Instance().currentTime().c_str());
+	LOG_INFO (LOG_GENERAL, "starting map generation at %s\n", Executive::Instance().currentTime().c_str());
 
-	Map *map = new Map (params.x_size, params.y_size);
+	Map *map = &context.createMask ();
 	map -> SetMode (rgba_8);
 	map -> Set_Coverage (params.coverage);
 
-	Logger::Instance().Log ("generating mask\n");
-	map -> generate_mask ();
-	map->Write("mask.png");
+	LOG_INFO (LOG_GENERAL, "generating mask\n");
+	{
+		PhaseTimer timer ("mask");
+		map -> generate_mask ();
+	}
+	bool written = map->Write((params.output_prefix + "mask.png").c_str());
 
-	Logger::Instance().Log ("running heightmap agents\n");
+	LOG_INFO (LOG_GENERAL, "running heightmap agents\n");
 
 	Executive::Instance().setMask(map);
 
@@ -638,46 +920,46 @@ void generate ()
 
 	int smoothTokens = (int) (sqrt((float) totalVertices) * 3.0);
 
-	for (int i = 0; i < params.num_mountain_agents; i++)
+	// the agents themselves; what they allocate as they run is charged to
+	// them by executeAgent
 	{
-		MountainAgent *agent = new MountainAgent(params.mountain_tokens);
-		agent->setAltitudePreferences(params.mountain_max_alt, params.mountain_variance);
-		Executive::Instance().addAgent(agent);
-	}
+		HeapScope heap (HEAP_AGENTS);
 
-	for (int i = 0; i < params.num_hill_agents; i++)
-	{
-		MountainAgent *agent = new MountainAgent(params.hill_tokens);
-		agent->setAltitudePreferences(params.hill_max_alt, params.hill_variance);
-		Executive::Instance().addAgent(agent);
-	}
+		for (int i = 0; i < params.num_mountain_agents; i++)
+		{
+			MountainAgent *agent = new MountainAgent(params.mountain_tokens);
+			agent->setAltitudePreferences(params.mountain_max_alt, params.mountain_variance);
+			Executive::Instance().addAgent(agent);
+		}
 
-	// the sweeping smoothers
-	for (int i = 0; i < params.y_size; i++)
-	{
-		SmoothAgent *agent = new SmoothAgent(2 * params.x_size);
-		agent->setSweepMode();
-		Point p(0, i);
-		agent->moveTo(p);
-		Executive::Instance().addAgent(agent);
-	}
+		for (int i = 0; i < params.num_hill_agents; i++)
+		{
+			MountainAgent *agent = new MountainAgent(params.hill_tokens);
+			agent->setAltitudePreferences(params.hill_max_alt, params.hill_variance);
+			Executive::Instance().addAgent(agent);
+		}
 
-	for (int i = 0; i < params.num_smooth_agents; i++)
-	{
-		agent = new SmoothAgent(params.smooth_tokens);
+		// the sweeping smoother, two passes over every row
+		agent = new SweepSmoothAgent(2);
 		Executive::Instance().addAgent(agent);
-	}
 
-	for (int i = 0; i < params.num_river_agents; i++)
-	{
-		agent = new RiverAgent(700);
-		Executive::Instance().addAgent(agent);
-	}
+		for (int i = 0; i < params.num_smooth_agents; i++)
+		{
+			agent = new SmoothAgent(params.smooth_tokens);
+			Executive::Instance().addAgent(agent);
+		}
 
-	for (int i = 0; i < params.num_beach_agents; i++)
-	{
-		agent = new ShoreLineAgent (params.beach_tokens);
-		Executive::Instance().addAgent(agent);
+		for (int i = 0; i < params.num_river_agents; i++)
+		{
+			agent = new RiverAgent(700);
+			Executive::Instance().addAgent(agent);
+		}
+
+		for (int i = 0; i < params.num_beach_agents; i++)
+		{
+			agent = new ShoreLineAgent (params.beach_tokens);
+			Executive::Instance().addAgent(agent);
+		}
 	}
 
 //	agent = new ErosionAgent();
@@ -693,23 +975,36 @@ void generate ()
 	//	agent = new HillAgent(len);
 	//	Executive::Instance().addAgent(agent);
 	//}
-	//Logger::Instance().Log ("restarting executive for another phase\n");
+	//LOG_INFO (LOG_GENERAL, "restarting executive for another phase\n");
 	//Executive::Instance().Run();
 	Executive::Instance().PostRun();
 
 //	WaterModel::Instance().setFlowVectors();
 //	WaterModel::Instance().printAllFlows ();
 
-//	Logger::Instance().Log ("generating culture\n");
+//	LOG_INFO (LOG_GENERAL, "generating culture\n");
 //	Culture_Generator *culture = new Culture_Generator ();
 //	culture -> generate ();
 
-	Executive::Instance().writeHeightmap();
+	{
+		PhaseTimer timer ("write");
+		written &= Executive::Instance().writeHeightmap();
+	}
+
+	LOG_INFO (LOG_GENERAL, "finishing map generation at %s\n", Executive::Instance().currentTime().c_str());
 
-	Logger::Instance().Log ("finishing map generation at %s\n", Executive::Instance().currentTime().c_str());
+	if (! params.report.empty())
+	{
+		written &= context.getMetrics().WriteReport (params.output_prefix + params.report);
+	}
+
+	if (context.getTrace() != NULL)
+	{
+		written &= context.getTrace()->Write (params.output_prefix + params.trace);
+	}
 //	culture -> SplitMap ();
 //	delete culture;
 
-	delete map;
+	return written;
 }
 
@@ -3,8 +3,9 @@
 #include "logger.h"
 #include "params.h"
 #include "pointset.h"
+#include "random.h"
 
-Map::Map (uint x, uint y) : Image (x, y)
+Map::Map (uint x, uint y) : Image (x, y, STORAGE_U16, Params::Instance().storage_layout)
 {
 	Params& params = Params::Instance();
 
@@ -68,9 +69,12 @@ void Map::Set (uint x, uint y, unsigned long value)
 void Map::generate_mask ()
 {
 	Action *a;
+	Random stream = Random::Root().stream(STREAM_MASK);
+	RandomScope scope (stream);
+
     int x = GetXSize() / 2;
     int y = GetYSize() / 2;
-    int dir = rand() % 8;
+    int dir = Random::Current().nextInt(8);
     Point seed(x, y);
 	Params& params = Params::Instance();
 
@@ -84,7 +88,7 @@ void Map::generate_mask ()
 	a -> generate ();
 	delete a;
 
-	Logger::Instance().Log ("mask completed\n");
+	LOG_INFO (LOG_MASK, "mask completed\n");
 }
 
 
@@ -121,13 +125,13 @@ bool Map::is_surrounded (unsigned int x, unsigned int y, int level)
         // top edge
         if (debug)
         {
-            Logger::Instance().Log ("  (%d,%d) = %d\n", x - level + i, y-level,
+            LOG_TRACE (LOG_MASK, "  (%d,%d) = %d\n", x - level + i, y-level,
                 Get (x - level + i, y - level));
-            Logger::Instance().Log ("  (%d,%d) = %d\n", x - level + i, y+level,
+            LOG_TRACE (LOG_MASK, "  (%d,%d) = %d\n", x - level + i, y+level,
                 Get (x - level + i, y + level));
-            Logger::Instance().Log ("  (%d,%d) = %d\n", x - level, y-level+i,
+            LOG_TRACE (LOG_MASK, "  (%d,%d) = %d\n", x - level, y-level+i,
                 Get (x-level, y-level+i));
-            Logger::Instance().Log ("  (%d,%d) = %d\n", x + level, y-level+i,
+            LOG_TRACE (LOG_MASK, "  (%d,%d) = %d\n", x + level, y-level+i,
                 Get (x+level, y-level+i));
         }
 
@@ -145,7 +149,7 @@ bool Map::is_surrounded (unsigned int x, unsigned int y, int level)
     }
 
     if (debug)
-        Logger::Instance().Log ("surrounded!\n");
+        LOG_TRACE (LOG_MASK, "surrounded!\n");
 
     return true;
 }
@@ -252,8 +256,8 @@ Map::randomPointOnMask (Point& point)
 
 	while (! found)
 	{
-		int x = rand() % GetXSize();
-		int y = rand() % GetYSize();
+		int x = Random::Current().nextInt(GetXSize());
+		int y = Random::Current().nextInt(GetYSize());
 
 		if (Get(x, y) > 0)
 		{
@@ -346,7 +350,7 @@ void Map::smooth_walk (uint x, uint y, int steps)
         {
             if (count++ == 20)
                 return;
-            switch (rand() % 4)
+            switch (Random::Current().nextInt(4))
             {
                 case 0:
                     if (in_range (x+1, y))
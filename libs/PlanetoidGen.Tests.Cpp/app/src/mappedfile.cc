@@ -0,0 +1,214 @@
+#include "mappedfile.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#define MAPPED_FILE_BUFFERED 1
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile ()
+{
+	base = NULL;
+	length = 0;
+	fd = -1;
+	scratch = false;
+}
+
+MappedFile::~MappedFile ()
+{
+	close ();
+}
+
+// ===================================================================
+// map -- size the open file and map all of it
+// ===================================================================
+bool MappedFile::map ()
+{
+#ifdef MAPPED_FILE_BUFFERED
+	base = new uint8_t[length];
+	memset (base, 0, length);
+	return true;
+#else
+	if (ftruncate (fd, (off_t) length) != 0)
+	{
+		LOG_ERROR (LOG_STORAGE, "MappedFile: cannot size %s to %lu bytes\n", filename.c_str(), (unsigned long) length);
+		::close (fd);
+		fd = -1;
+		return false;
+	}
+
+	// mmap refuses an empty mapping, the file is all there is
+	if (length == 0)
+	{
+		return true;
+	}
+
+	void *p = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		LOG_ERROR (LOG_STORAGE, "MappedFile: cannot map %s\n", filename.c_str());
+		::close (fd);
+		fd = -1;
+		return false;
+	}
+
+	base = (uint8_t *) p;
+	return true;
+#endif
+}
+
+// ===================================================================
+// create -- make (or truncate) the file, size it and map it
+// ===================================================================
+bool MappedFile::create (const char *name, size_t bytes)
+{
+	close ();
+
+	filename = name;
+	length = bytes;
+	scratch = false;
+
+#ifndef MAPPED_FILE_BUFFERED
+	fd = open (name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		LOG_ERROR (LOG_STORAGE, "MappedFile: cannot create %s\n", name);
+		return false;
+	}
+#endif
+
+	return map ();
+}
+
+// ===================================================================
+// createScratch -- map a temporary file in directory
+//
+// The file is unlinked as soon as it is open, so it never outlives us.
+// Untouched parts of it take no disk space on filesystems with holes.
+// ===================================================================
+bool MappedFile::createScratch (const char *directory, size_t bytes)
+{
+	close ();
+
+	filename = std::string (directory) + "/mapgen-scratch-XXXXXX";
+	length = bytes;
+	scratch = true;
+
+#ifndef MAPPED_FILE_BUFFERED
+	std::vector<char> name (filename.begin(), filename.end());
+	name.push_back (0);
+
+	fd = mkstemp (name.data());
+	if (fd < 0)
+	{
+		LOG_ERROR (LOG_STORAGE, "MappedFile: cannot create a scratch file in %s\n", directory);
+		return false;
+	}
+
+	filename = name.data();
+	unlink (filename.c_str());
+#endif
+
+	return map ();
+}
+
+// ===================================================================
+// willNeed -- ask for a range to be read in ahead of use
+// ===================================================================
+void MappedFile::willNeed (size_t offset, size_t bytes)
+{
+#ifndef MAPPED_FILE_BUFFERED
+	if (base != NULL)
+	{
+		madvise (base + offset, bytes, MADV_WILLNEED);
+	}
+#endif
+}
+
+// ===================================================================
+// release -- start writing a range back and drop it from memory
+//
+// The mapping is shared, so the contents stay in the file and are read
+// back in on the next access.
+// ===================================================================
+void MappedFile::release (size_t offset, size_t bytes)
+{
+#ifndef MAPPED_FILE_BUFFERED
+	if (base != NULL)
+	{
+		msync (base + offset, bytes, MS_ASYNC);
+		madvise (base + offset, bytes, MADV_DONTNEED);
+	}
+#endif
+}
+
+// ===================================================================
+// zero -- clear the whole file, without touching every page
+// ===================================================================
+bool MappedFile::zero ()
+{
+#ifdef MAPPED_FILE_BUFFERED
+	if (base != NULL)
+	{
+		memset (base, 0, length);
+	}
+	return true;
+#else
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	if (base != NULL)
+	{
+		madvise (base, length, MADV_DONTNEED);
+	}
+
+	return (ftruncate (fd, 0) == 0) && (ftruncate (fd, (off_t) length) == 0);
+#endif
+}
+
+// ===================================================================
+// close -- unmap the file, the data is on its way to disk
+// ===================================================================
+bool MappedFile::close ()
+{
+	bool ok = true;
+
+#ifdef MAPPED_FILE_BUFFERED
+	if ((base != NULL) && ! scratch)
+	{
+		FILE *f = fopen (filename.c_str(), "wb");
+		ok = (f != NULL) && (fwrite (base, 1, length, f) == length);
+		if ((f != NULL) && (fclose (f) != 0))
+		{
+			ok = false;
+		}
+	}
+
+	delete [] base;
+#else
+	if (base != NULL)
+	{
+		ok = (munmap (base, length) == 0);
+	}
+
+	if (fd >= 0)
+	{
+		ok = (::close (fd) == 0) && ok;
+	}
+#endif
+
+	base = NULL;
+	length = 0;
+	fd = -1;
+
+	return ok;
+}
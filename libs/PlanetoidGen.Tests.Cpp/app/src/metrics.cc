@@ -0,0 +1,237 @@
+#include "metrics.h"
+#include "generationcontext.h"
+#include "logger.h"
+#include "params.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *counter_names[NUM_COUNTERS] =
+{
+	"cells_written", "fixed_lookups", "agent_steps", "bytes_written", "files_written"
+};
+
+Metrics::Metrics ()
+{
+	reset ();
+}
+
+std::unique_ptr<Metrics> Metrics::_instance;
+Metrics& Metrics::Instance ()
+{
+	GenerationContext *context = GenerationContext::Current();
+
+	if (context != NULL)
+	{
+		return context->getMetrics();
+	}
+
+	if (_instance.get() == NULL)
+	{
+		_instance.reset (new Metrics);
+	}
+
+	return *_instance;
+}
+
+unsigned int Metrics::nextShard ()
+{
+	static std::atomic<unsigned int> next (0);
+	return next++ % SHARDS;
+}
+
+void Metrics::reset ()
+{
+	for (unsigned int s = 0; s < SHARDS; s++)
+	{
+		for (int c = 0; c < NUM_COUNTERS; c++)
+		{
+			shards[s].counts[c] = 0;
+		}
+	}
+
+	std::lock_guard<std::mutex> guard (lock);
+	phases.clear ();
+	started = std::chrono::steady_clock::now();
+}
+
+uint64_t Metrics::total (Counter c)
+{
+	uint64_t sum = 0;
+
+	for (unsigned int s = 0; s < SHARDS; s++)
+	{
+		sum += shards[s].counts[c].load (std::memory_order_relaxed);
+	}
+
+	return sum;
+}
+
+// ===================================================================
+// find -- a phase by name, created the first time it is seen
+//
+// The caller holds the lock.
+// ===================================================================
+Metrics::Phase& Metrics::find (const char *phase)
+{
+	for (Phase& p : phases)
+	{
+		if (p.name.compare (phase) == 0)
+		{
+			return p;
+		}
+	}
+
+	phases.emplace_back (phase);
+	return phases.back();
+}
+
+void Metrics::addTime (const char *phase, uint64_t nanoseconds)
+{
+	std::lock_guard<std::mutex> guard (lock);
+	Phase& p = find (phase);
+
+	p.nanoseconds += nanoseconds;
+	p.calls++;
+}
+
+HeapCounters& Metrics::heapPhase (const char *phase)
+{
+	std::lock_guard<std::mutex> guard (lock);
+	return find (phase).heap;
+}
+
+double Metrics::elapsed ()
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now() - started).count();
+}
+
+const char *Metrics::CounterName (Counter c)
+{
+	return counter_names[c];
+}
+
+static const char *layoutName (StorageLayout l)
+{
+	switch (l)
+	{
+	case LAYOUT_TILED:
+		return "tiled";
+	case LAYOUT_SPARSE:
+		return "sparse";
+	default:
+		return "dense";
+	}
+}
+
+static const char *typeName (StorageType t)
+{
+	switch (t)
+	{
+	case STORAGE_U16:
+		return "u16";
+	case STORAGE_F32:
+		return "f32";
+	default:
+		return "u32";
+	}
+}
+
+// a phase has no live bytes of its own, only the process's peak
+static void writeHeap (FILE *f, HeapCounters& c, bool live)
+{
+	fprintf (f, "{\"allocated_bytes\": %llu, \"allocations\": %llu, ",
+		(unsigned long long) c.allocated.load(), (unsigned long long) c.allocations.load());
+	if (live)
+	{
+		fprintf (f, "\"live_bytes\": %lld, ", (long long) c.live.load());
+	}
+	fprintf (f, "\"peak_live_bytes\": %lld}", (long long) c.peak.load());
+}
+
+// ===================================================================
+// WriteReport -- one JSON object describing the run so far
+//
+// Phases nest by name: "run.mountain" is the mountain agents' share of
+// "run", summed over every thread they ran on.  With heap tracking on,
+// each phase and subsystem has its allocation counts as well.
+// ===================================================================
+bool Metrics::WriteReport (const std::string& filename)
+{
+	Params& params = Params::Instance();
+	bool heap = HeapTrack::Enabled();
+	FILE *f = fopen (filename.c_str(), "w");
+
+	if (f == NULL)
+	{
+		LOG_ERROR (LOG_GENERAL, "cannot write report %s\n", filename.c_str());
+		return false;
+	}
+
+	std::string name;
+	for (char c : params.name)
+	{
+		if ((c == '"') || (c == '\\'))
+			name += '\\';
+		name += c;
+	}
+
+	fprintf (f, "{\n");
+	fprintf (f, "  \"name\": \"%s\",\n", name.c_str());
+	fprintf (f, "  \"seed\": %ld,\n", params.seed);
+	fprintf (f, "  \"x_size\": %d,\n", params.x_size);
+	fprintf (f, "  \"y_size\": %d,\n", params.y_size);
+	fprintf (f, "  \"threads\": %d,\n", params.threads);
+	fprintf (f, "  \"deterministic\": %s,\n", params.deterministic ? "true" : "false");
+	fprintf (f, "  \"storage\": \"%s\",\n", layoutName (params.storage_layout));
+	fprintf (f, "  \"height_storage\": \"%s\",\n", typeName (params.height_storage));
+	fprintf (f, "  \"agents\": {\"mountain\": %d, \"hill\": %d, \"smooth\": %d, \"beach\": %d, \"river\": %d},\n",
+		params.num_mountain_agents, params.num_hill_agents, params.num_smooth_agents,
+		params.num_beach_agents, params.num_river_agents);
+	fprintf (f, "  \"seconds\": %.6f,\n", elapsed ());
+
+	{
+		std::lock_guard<std::mutex> guard (lock);
+
+		fprintf (f, "  \"phases\": [\n");
+		for (size_t i = 0; i < phases.size(); i++)
+		{
+			fprintf (f, "    {\"name\": \"%s\", \"seconds\": %.6f, \"calls\": %ld",
+				phases[i].name.c_str(), phases[i].nanoseconds * 1e-9, phases[i].calls);
+			if (heap)
+			{
+				fprintf (f, ", \"heap\": ");
+				writeHeap (f, phases[i].heap, false);
+			}
+			fprintf (f, "}%s\n", (i + 1 < phases.size()) ? "," : "");
+		}
+		fprintf (f, "  ],\n");
+	}
+
+	fprintf (f, "  \"counters\": {\n");
+	for (int c = 0; c < NUM_COUNTERS; c++)
+	{
+		fprintf (f, "    \"%s\": %llu%s\n", counter_names[c], (unsigned long long) total ((Counter) c),
+			(c + 1 < NUM_COUNTERS) ? "," : "");
+	}
+	fprintf (f, "  }%s\n", heap ? "," : "");
+
+	if (heap)
+	{
+		fprintf (f, "  \"heap\": {\n");
+		fprintf (f, "    \"total\": ");
+		writeHeap (f, HeapTrack::Total(), true);
+		fprintf (f, ",\n    \"subsystems\": {\n");
+		for (int s = 0; s < HEAP_SUBSYSTEMS; s++)
+		{
+			fprintf (f, "      \"%s\": ", HeapTrack::SubsystemName ((HeapSubsystem) s));
+			writeHeap (f, HeapTrack::Subsystem ((HeapSubsystem) s), true);
+			fprintf (f, "%s\n", (s + 1 < HEAP_SUBSYSTEMS) ? "," : "");
+		}
+		fprintf (f, "    }\n");
+		fprintf (f, "  }\n");
+	}
+
+	fprintf (f, "}\n");
+
+	return fclose (f) == 0;
+}
@@ -0,0 +1,61 @@
+#include "pagequeue.h"
+#include "threadpool.h"
+#include "logger.h"
+
+PageQueue::PageQueue (int _limit)
+{
+	inFlight = 0;
+	failed = 0;
+	limit = (_limit > 0) ? _limit : PAGES_PER_THREAD * ThreadPool::Instance().size();
+}
+
+PageQueue::~PageQueue ()
+{
+	finish ();
+}
+
+// ===================================================================
+// add -- queue one page, once there is room for it
+//
+// With no pool workers, or from a worker, the page is written before
+// add returns.
+// ===================================================================
+void PageQueue::add (std::function<bool()> page)
+{
+	{
+		std::unique_lock<std::mutex> guard (lock);
+		slot.wait (guard, [this] {return inFlight < limit;});
+		inFlight++;
+	}
+
+	ThreadPool::Instance().submit ([this, page] ()
+	{
+		bool written = page ();
+
+		// notify under the lock, finish() may return and destroy us as soon as it is released
+		std::lock_guard<std::mutex> guard (lock);
+		inFlight--;
+		failed += written ? 0 : 1;
+		slot.notify_all ();
+	});
+}
+
+// ===================================================================
+// finish -- wait until every queued page has been written
+//
+// Returns false if any of them failed, and starts the count again.
+// ===================================================================
+bool PageQueue::finish ()
+{
+	std::unique_lock<std::mutex> guard (lock);
+	slot.wait (guard, [this] {return inFlight == 0;});
+
+	if (failed > 0)
+	{
+		LOG_ERROR (LOG_STORAGE, "%d page(s) could not be written\n", failed);
+		failed = 0;
+		return false;
+	}
+
+	return true;
+}
@@ -1,4 +1,5 @@
 #include "params.h"
+#include "generationcontext.h"
 
 Params::Params ()
 {
@@ -28,6 +29,12 @@ Params::Params ()
 	smooth_tokens = 0;
 	hill_tokens = 0;
 
+	mountain_weight = 1;
+	beach_weight = 1;
+	smooth_weight = 1;
+	hill_weight = 1;
+	river_weight = 1;
+
 	// mountain agent params
 	mountain_max_alt = 20000;
 	mountain_variance = 5000;
@@ -74,10 +81,42 @@ Params::Params ()
 	smooth_num_resets = 1;
 
 	format = FORMAT_PNG;
+	height_storage = STORAGE_U32;
+	storage_layout = LAYOUT_DENSE;
+	scratch_dir = ".";
+	resident_mb = 0;
+	halo_padding = PAD_ZERO;
+	write_coast_distance = false;
+	raw_format = RAW_NONE;
+	raw_header = false;
+	lod_levels = 0;
+	log_level = LOG_LEVEL_INFO;
+	log_categories = (1u << LOG_CATEGORIES) - 1;
+
+	threads = 1;
+	deterministic = false;
+	lease_tile = 32;
+
+	jobs = 1;
+	num_seeds = 1;
+	heap_track = false;
 }
 
+std::unique_ptr<Params> Params::_instance;
+
+// ===================================================================
+// Instance -- the bound context's parameters, or the process-wide set
+// parsed from the command line
+// ===================================================================
 Params& Params::Instance()
 {
+	GenerationContext *context = GenerationContext::Current();
+
+	if (context != NULL)
+	{
+		return context->getParams();
+	}
+
 	if (_instance.get() == NULL)
 	{
 		_instance.reset (new Params);
@@ -0,0 +1,344 @@
+#include "pngwriter.h"
+#include "threadpool.h"
+#include "logger.h"
+#include "metrics.h"
+#include "heaptrack.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <zlib.h>
+
+PngWriter::PngWriter (PngFormat f, unsigned int w, unsigned int h)
+{
+	format = f;
+	width = w;
+	height = h;
+
+	switch (format)
+	{
+	case PNG_GREY8:
+		bpp = 1;
+		break;
+	case PNG_GREY16:
+		bpp = 2;
+		break;
+	default:
+		bpp = 4;
+		break;
+	}
+
+	rowBytes = (size_t) width * bpp;
+	bandRows = (unsigned int) std::max ((size_t) 1, BAND_BYTES / (rowBytes + 1));
+}
+
+// ===================================================================
+// Encoder -- the buffers and deflate state one thread compresses with
+//
+// Each thread keeps its own, so writing page after page only allocates
+// when a band is larger than any seen before.  deflateReset gives the
+// same output as a freshly initialised stream.
+// ===================================================================
+struct Encoder
+{
+	std::vector<uint8_t> prior;
+	std::vector<uint8_t> row;
+	std::vector<uint8_t> trial;
+	std::vector<uint8_t> filtered;
+
+	z_stream z;
+	bool ready;
+
+	Encoder ()
+	{
+		memset (&z, 0, sizeof (z));
+		ready = false;
+	}
+
+	~Encoder ()
+	{
+		if (ready)
+		{
+			deflateEnd (&z);
+		}
+	}
+};
+
+static thread_local Encoder encoder;
+
+static void put32 (uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t) (v >> 24);
+	p[1] = (uint8_t) (v >> 16);
+	p[2] = (uint8_t) (v >> 8);
+	p[3] = (uint8_t) v;
+}
+
+void PngWriter::writeChunk (FILE *f, const char *type, const uint8_t *data, size_t length)
+{
+	uint8_t header[8];
+
+	put32 (header, (uint32_t) length);
+	memcpy (header + 4, type, 4);
+
+	uLong crc = crc32 (0, (const Bytef *) type, 4);
+	if (length > 0)
+	{
+		crc = crc32 (crc, data, (uInt) length);
+	}
+
+	uint8_t trailer[4];
+	put32 (trailer, (uint32_t) crc);
+
+	fwrite (header, 1, 8, f);
+	if (length > 0)
+	{
+		fwrite (data, 1, length, f);
+	}
+	fwrite (trailer, 1, 4, f);
+}
+
+static inline uint8_t paeth (int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs (p - a);
+	int pb = abs (p - b);
+	int pc = abs (p - c);
+
+	return (uint8_t) (((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c));
+}
+
+// ===================================================================
+// filterRow -- pick the PNG filter giving the smallest sum of residuals
+//
+// The usual heuristic: each of the five filters is tried and the one whose
+// output bytes, taken as signed, are closest to zero is kept.  out holds
+// the filter byte followed by rowBytes of filtered data; trial is scratch
+// space for one row.
+// ===================================================================
+void PngWriter::filterRow (const uint8_t *row, const uint8_t *prior, uint8_t *trial, uint8_t *out)
+{
+	size_t n = rowBytes;
+	size_t lead = std::min ((size_t) bpp, n);
+	long best = -1;
+
+	for (int filter = 0; filter < 5; filter++)
+	{
+		// the first pixel has nothing to its left
+		for (size_t i = 0; i < lead; i++)
+		{
+			int b = prior[i];
+			int predict = (filter == 2) || (filter == 4) ? b : ((filter == 3) ? (b >> 1) : 0);
+
+			trial[i] = (uint8_t) (row[i] - predict);
+		}
+
+		switch (filter)
+		{
+		case 0:
+			memcpy (trial + lead, row + lead, n - lead);
+			break;
+		case 1:
+			for (size_t i = lead; i < n; i++)
+				trial[i] = (uint8_t) (row[i] - row[i - bpp]);
+			break;
+		case 2:
+			for (size_t i = lead; i < n; i++)
+				trial[i] = (uint8_t) (row[i] - prior[i]);
+			break;
+		case 3:
+			for (size_t i = lead; i < n; i++)
+				trial[i] = (uint8_t) (row[i] - ((row[i - bpp] + prior[i]) >> 1));
+			break;
+		default:
+			for (size_t i = lead; i < n; i++)
+				trial[i] = (uint8_t) (row[i] - paeth (row[i - bpp], prior[i], prior[i - bpp]));
+			break;
+		}
+
+		long sum = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			sum += abs ((int8_t) trial[i]);
+		}
+
+		if ((best < 0) || (sum < best))
+		{
+			best = sum;
+			out[0] = (uint8_t) filter;
+			memcpy (out + 1, trial, n);
+		}
+	}
+}
+
+// ===================================================================
+// compressBand -- filter and deflate one band of rows
+//
+// The band re-reads the row above it, which the filters predict from.
+// Returns false, having logged why, if zlib fails.
+// ===================================================================
+bool PngWriter::compressBand (RowSource& source, unsigned int band, bool last, Band& out)
+{
+	unsigned int y1 = band * bandRows;
+	unsigned int y2 = std::min (y1 + bandRows, height);
+
+	std::vector<uint8_t>& prior = encoder.prior;
+	std::vector<uint8_t>& row = encoder.row;
+	std::vector<uint8_t>& filtered = encoder.filtered;
+
+	prior.assign (rowBytes, 0);
+	row.resize (rowBytes);
+	encoder.trial.resize (rowBytes);
+	filtered.resize ((size_t) (y2 - y1) * (rowBytes + 1));
+
+	if (y1 > 0)
+	{
+		source (y1 - 1, prior.data());
+	}
+
+	for (unsigned int y = y1; y < y2; y++)
+	{
+		source (y, row.data());
+		filterRow (row.data(), prior.data(), encoder.trial.data(), &filtered[(size_t) (y - y1) * (rowBytes + 1)]);
+		prior.swap (row);
+	}
+
+	out.length = filtered.size();
+	out.adler = (uint32_t) adler32 (adler32 (0, NULL, 0), filtered.data(), (uInt) filtered.size());
+
+	z_stream& z = encoder.z;
+
+	// raw deflate, the zlib header and checksum are written around the bands
+	if (encoder.ready)
+	{
+		deflateReset (&z);
+	}
+	else if (deflateInit2 (&z, LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK)
+	{
+		encoder.ready = true;
+	}
+	else
+	{
+		LOG_ERROR (LOG_STORAGE, "PngWriter: cannot initialise deflate\n");
+		return false;
+	}
+
+	out.data.resize (deflateBound (&z, (uLong) filtered.size()) + 16);
+
+	z.next_in = filtered.data();
+	z.avail_in = (uInt) filtered.size();
+	z.next_out = out.data.data();
+	z.avail_out = (uInt) out.data.size();
+
+	int result = deflate (&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+	if ((result != (last ? Z_STREAM_END : Z_OK)) || (z.avail_in != 0))
+	{
+		LOG_ERROR (LOG_STORAGE, "PngWriter: deflate failed (%d)\n", result);
+		return false;
+	}
+
+	out.data.resize (out.data.size() - z.avail_out);
+	return true;
+}
+
+// ===================================================================
+// write -- encode the image to filename
+// ===================================================================
+bool PngWriter::write (const char *filename, RowSource source)
+{
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	HeapScope heap (HEAP_WRITER);
+
+	if ((width == 0) || (height == 0))
+	{
+		LOG_WARN (LOG_STORAGE, "PngWriter: %s would be empty, not written\n", filename);
+		return false;
+	}
+
+	FILE *f = fopen (filename, "wb");
+	if (f == NULL)
+	{
+		LOG_ERROR (LOG_STORAGE, "PngWriter: cannot open %s\n", filename);
+		return false;
+	}
+
+	fwrite (signature, 1, 8, f);
+
+	uint8_t ihdr[13];
+	put32 (ihdr, width);
+	put32 (ihdr + 4, height);
+	ihdr[8] = (format == PNG_GREY16) ? 16 : 8;			// bit depth
+	ihdr[9] = (format == PNG_RGBA8) ? 6 : 0;			// colour type
+	ihdr[10] = 0;										// deflate
+	ihdr[11] = 0;										// adaptive filtering
+	ihdr[12] = 0;										// not interlaced
+	writeChunk (f, "IHDR", ihdr, sizeof (ihdr));
+
+	// zlib header: deflate with a 32K window, default compression
+	const uint8_t zheader[2] = {0x78, 0x9c};
+	writeChunk (f, "IDAT", zheader, 2);
+
+	ThreadPool& pool = ThreadPool::Instance();
+	unsigned int bands = (height + bandRows - 1) / bandRows;
+	unsigned int window = std::max (1, 2 * pool.size());
+
+	// compressed bands waiting to be written, kept between images like the encoder
+	static thread_local std::vector<Band> kept;
+	kept.resize (std::max ((size_t) window, kept.size()));
+
+	// the bands are compressed on other threads, which must see this thread's set
+	std::vector<Band>& pending = kept;
+	uLong adler = adler32 (0, NULL, 0);
+	std::atomic<bool> failed (false);
+
+	for (unsigned int first = 0; first < bands; first += window)
+	{
+		unsigned int count = std::min (window, bands - first);
+
+		pool.parallelFor (count, [this, &source, &pending, &failed, first, bands] (int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				unsigned int band = first + i;
+
+				if (! compressBand (source, band, band == bands - 1, pending[i]))
+				{
+					failed = true;
+				}
+			}
+		});
+
+		if (failed)
+		{
+			fclose (f);
+			return false;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Band& band = pending[i];
+
+			writeChunk (f, "IDAT", band.data.data(), band.data.size());
+			adler = adler32_combine (adler, band.adler, (z_off_t) band.length);
+		}
+	}
+
+	uint8_t checksum[4];
+	put32 (checksum, (uint32_t) adler);
+	writeChunk (f, "IDAT", checksum, 4);
+	writeChunk (f, "IEND", NULL, 0);
+
+	bool ok = (ferror (f) == 0);
+	long bytes = ftell (f);
+
+	if (fclose (f) != 0)
+	{
+		ok = false;
+	}
+
+	Metrics& metrics = Metrics::Instance();
+	metrics.count (COUNT_BYTES_WRITTEN, (bytes > 0) ? bytes : 0);
+	metrics.count (COUNT_FILES_WRITTEN);
+
+	return ok;
+}
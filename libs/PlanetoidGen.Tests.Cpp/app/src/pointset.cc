@@ -1,47 +1,241 @@
-#include <algorithm> 
+#include <algorithm>
+#include <stdlib.h>
 #include "pointset.h"
+#include "heaptrack.h"
 #include "logger.h"
 #include "params.h"
+#include "random.h"
 
 PointSet::PointSet ()
 {
 	Params& params = Params::Instance();
 
-	impl_iter = points.begin();
-	x_dim = params.x_size;
-	y_dim = params.y_size;
+	x_dim = 0;
+	y_dim = 0;
+	have_slots = false;
+	ordered = false;
+	order_valid = false;
+	impl_iter = 0;
+
+	setSize (params.x_size, params.y_size);
 }
 
 PointSet::PointSet(int x_size, int y_size)
 {
-	impl_iter = points.begin();
+	x_dim = 0;
+	y_dim = 0;
+	have_slots = false;
+	ordered = false;
+	order_valid = false;
+	impl_iter = 0;
+
+	setSize (x_size, y_size);
+}
+
+PointSet::~PointSet ()
+{
+}
+
+// ==========================================================
+// setSize -- change the dimensions of the grid the set covers
+//
+// Existing members which still fit on the new grid are kept.
+// ==========================================================
+void PointSet::setSize (int x_size, int y_size)
+{
+	if ((x_size == x_dim) && (y_size == y_dim))
+	{
+		return;
+	}
+
+	HeapScope heap (HEAP_POINTSET);
+	std::vector<int> members;
+	members.swap (dense);
+
 	x_dim = x_size;
 	y_dim = y_size;
+	reset ();
+
+	for (unsigned int i = 0; i < members.size(); i++)
+	{
+		int coord = members[i];
+
+		if ((coord >= 0) && (coord < x_dim * y_dim))
+		{
+			mark (coord, true);
+			dense.push_back (coord);
+		}
+	}
 }
 
-PointSet::~PointSet ()
+// ==========================================================
+// reset -- drop all members and size the page tables
+// ==========================================================
+void PointSet::reset ()
 {
+	long cells = (long) x_dim * y_dim;
+	long num_pages = (cells + PAGE_CELLS - 1) / PAGE_CELLS;
+
+	if (num_pages < 0)
+	{
+		num_pages = 0;
+	}
+
+	HeapScope heap (HEAP_POINTSET);
+	dense.clear ();
+	bits.clear ();
+	bits.resize (num_pages);
+	slots.clear ();
+	have_slots = false;
+	order.clear ();
+	order_valid = false;
+	impl_iter = 0;
 }
 
+void PointSet::clear ()
+{
+	reset ();
+}
 
 // ==========================================================
-// in_set:  determine if a point is in the set
+// setOrdered -- iterate in coordinate (row-major) order
 // ==========================================================
-bool PointSet::in_set (int x, int y)
+void PointSet::setOrdered (bool b)
+{
+	ordered = b;
+	order_valid = false;
+}
+
+// ==========================================================
+// coordOf -- the cell id for a point, or -1 if it is off the grid
+//
+// Coordinates are combined exactly as they always have been, so a
+// point just off the left edge aliases the end of the previous row.
+// ==========================================================
+int PointSet::coordOf (int x, int y)
 {
 	int coord = y * x_dim + x;
 
-	if (points.find(coord) != points.end())
+	if ((coord < 0) || (coord >= x_dim * y_dim))
 	{
-		return true;
+		return -1;
 	}
-	else
+
+	return coord;
+}
+
+bool PointSet::test (int coord)
+{
+	std::vector<uint64_t>& page = bits[coord >> PAGE_SHIFT];
+
+	if (page.empty())
 	{
 		return false;
 	}
 
+	int bit = coord & (PAGE_CELLS - 1);
+	return (page[bit >> 6] >> (bit & 63)) & 1;
+}
 
-	return false;
+void PointSet::mark (int coord, bool value)
+{
+	std::vector<uint64_t>& page = bits[coord >> PAGE_SHIFT];
+
+	if (page.empty())
+	{
+		if (! value)
+		{
+			return;
+		}
+
+		page.resize (PAGE_WORDS, 0);
+	}
+
+	int bit = coord & (PAGE_CELLS - 1);
+	uint64_t mask = (uint64_t) 1 << (bit & 63);
+
+	if (value)
+		page[bit >> 6] |= mask;
+	else
+		page[bit >> 6] &= ~mask;
+}
+
+// ==========================================================
+// slot index -- where each member lives in the dense vector
+// ==========================================================
+void PointSet::buildSlots ()
+{
+	HeapScope heap (HEAP_POINTSET);
+
+	slots.clear ();
+	slots.resize (bits.size());
+	have_slots = true;
+
+	for (unsigned int i = 0; i < dense.size(); i++)
+	{
+		setSlot (dense[i], i);
+	}
+}
+
+void PointSet::setSlot (int coord, int pos)
+{
+	std::vector<int>& page = slots[coord >> PAGE_SHIFT];
+
+	if (page.empty())
+	{
+		page.resize (PAGE_CELLS, -1);
+	}
+
+	page[coord & (PAGE_CELLS - 1)] = pos;
+}
+
+int PointSet::getSlot (int coord)
+{
+	std::vector<int>& page = slots[coord >> PAGE_SHIFT];
+
+	if (page.empty())
+	{
+		return -1;
+	}
+
+	return page[coord & (PAGE_CELLS - 1)];
+}
+
+// ==========================================================
+// sequence -- the members in iteration order
+// ==========================================================
+std::vector<int>& PointSet::sequence ()
+{
+	if (! ordered)
+	{
+		return dense;
+	}
+
+	if (! order_valid)
+	{
+		HeapScope heap (HEAP_POINTSET);
+
+		order = dense;
+		std::sort (order.begin(), order.end());
+		order_valid = true;
+	}
+
+	return order;
+}
+
+// ==========================================================
+// in_set:  determine if a point is in the set
+// ==========================================================
+bool PointSet::in_set (int x, int y)
+{
+	int coord = coordOf (x, y);
+
+	if (coord < 0)
+	{
+		return false;
+	}
+
+	return test (coord);
 }
 
 // ==========================================================
@@ -60,56 +254,37 @@ bool PointSet::in_set (Point& p)
 // ==========================================================
 bool PointSet::random_member (Point& point)
 {
-	if (points.size() == 0)
+	if (dense.size() == 0)
 		return false;
 
-	int pos = rand() % points.size();
-
-	IntegerSet::iterator i = points.begin();
-	std::advance(i, pos);
-
-	int coord = *i;
-	point.x = coord % x_dim;
-	point.y = coord / x_dim;
+	int pos = Random::Current().nextInt(dense.size());
 
+	pointOf (dense[pos], point);
 	return true;
 }
 
 // ==========================================================
-// random_member -- return a random point in the set
-//
-// New storage is allocated and ownership transferred to the caller,
-// the internal set ownership is retained.
+// member -- return the point at a position in iteration order
 // ==========================================================
 bool PointSet::member (int pos, Point& point)
 {
-	if (pos >= (int) points.size())
+	if ((pos < 0) || (pos >= (int) dense.size()))
 		return false;
 
-	IntegerSet::iterator i = points.begin();
-	std::advance(i, pos);
-
-	int coord = *i;
-	point.x = coord % x_dim;
-	point.y = coord / x_dim;
-
+	pointOf (sequence()[pos], point);
 	return true;
 }
 
 bool PointSet::position(int pos)
 {
-	IntegerSet::iterator i = points.begin();
-	std::advance(i, pos);
-
-	if (i != points.end())
-	{
-		impl_iter = i;
-		return true;
-	}
-	else
+	if ((pos < 0) || (pos >= (int) dense.size()))
 	{
 		return false;
 	}
+
+	sequence ();
+	impl_iter = pos;
+	return true;
 }
 
 // ==========================================================
@@ -117,11 +292,24 @@ bool PointSet::position(int pos)
 // ==========================================================
 void PointSet::insert (int x, int y)
 {
-	if (! in_set (x, y))
+	int coord = coordOf (x, y);
+
+	if ((coord < 0) || test (coord))
+	{
+		return;
+	}
+
+	HeapScope heap (HEAP_POINTSET);
+
+	mark (coord, true);
+	dense.push_back (coord);
+
+	if (have_slots)
 	{
-		int coord = y * x_dim + x;
-		points.insert (coord);
+		setSlot (coord, dense.size() - 1);
 	}
+
+	order_valid = false;
 }
 
 // ==========================================================
@@ -134,38 +322,57 @@ void PointSet::insert (Point& p)
 
 // ==========================================================
 // remove -- remove a point from the set
+//
+// The last member is moved into the vacated slot.
 // ==========================================================
 void PointSet::remove (int x, int y)
 {
-	int coord = y * x_dim + x;
+	int coord = coordOf (x, y);
+
+	if ((coord < 0) || ! test (coord))
+	{
+		return;
+	}
 
-	if (points.find(coord) != points.end())
+	if (! have_slots)
 	{
-		points.erase (coord);
+		buildSlots ();
 	}
+
+	int pos = getSlot (coord);
+	int last = dense.back();
+
+	dense[pos] = last;
+	setSlot (last, pos);
+	dense.pop_back ();
+
+	setSlot (coord, -1);
+	mark (coord, false);
+
+	order_valid = false;
 }
 
 void PointSet::Reset_Iterator ()
 {
-	impl_iter = points.begin ();
+	sequence ();
+	impl_iter = 0;
 }
 
 bool PointSet::Iterate_Next (Point& next)
 {
-	if (impl_iter == points.end())
+	if (x_dim == 0)
 	{
 		return false;
 	}
 
-	if (x_dim == 0)
+	std::vector<int>& members = sequence ();
+
+	if (impl_iter >= members.size())
 	{
 		return false;
 	}
 
-	int coord = *impl_iter;
-
-	next.x = coord % x_dim;
-	next.y = coord / x_dim;
+	pointOf (members[impl_iter], next);
 
 	++impl_iter;
 	return true;
@@ -173,28 +380,27 @@ bool PointSet::Iterate_Next (Point& next)
 
 bool PointSet::is_empty ()
 {
-	return (points.size() == 0);
+	return (dense.size() == 0);
 }
 
 void PointSet::printSet ()
 {
-	IntegerSet::iterator iter;
+	std::vector<int> members (dense);
+	std::sort (members.begin(), members.end());
 
-	for (iter = points.begin(); iter != points.end(); ++iter)
+	for (unsigned int i = 0; i < members.size(); i++)
 	{
 		Point p;
-		pointOf (*iter, p);
+		pointOf (members[i], p);
 
-		Logger::Instance().Log (" (%d,%d) ", p.x, p.y);
+		LOG_TRACE (LOG_GENERAL, " (%d,%d) ", p.x, p.y);
 	}
 
-	Logger::Instance().Log ("\n");
+	LOG_DEBUG (LOG_GENERAL, "\n");
 }
 
 void PointSet::pointOf(int id, Point& p)
 {
-	Params& params = Params::Instance();
-
-	p.x = id % params.x_size;
-	p.y = id / params.x_size;
-}
\ No newline at end of file
+	p.x = id % x_dim;
+	p.y = id / x_dim;
+}
@@ -0,0 +1,321 @@
+#include "pyramid.h"
+#include "pagequeue.h"
+#include "threadpool.h"
+#include "logger.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+// ===================================================================
+// mode -- the most common of n values, the earliest of them on a tie
+// ===================================================================
+static uint32_t mode (const uint32_t *values, int n)
+{
+	uint32_t best = values[0];
+	int bestCount = 0;
+
+	for (int a = 0; a < n; a++)
+	{
+		int count = 0;
+		for (int b = 0; b < n; b++)
+		{
+			count += (values[b] == values[a]) ? 1 : 0;
+		}
+
+		if (count > bestCount)
+		{
+			best = values[a];
+			bestCount = count;
+		}
+	}
+
+	return best;
+}
+
+Pyramid::Pyramid (Image& _heights, Image& _index, int _levels) : heights (_heights), index (_index)
+{
+	levels = std::max (0, std::min (_levels, (int) MAX_LEVELS));
+	tiles_x = (heights.GetXSize() + TILE - 1) / TILE;
+	tiles_y = (heights.GetYSize() + TILE - 1) / TILE;
+
+	uint size_x = heights.GetXSize();
+	uint size_y = heights.GetYSize();
+
+	for (int level = 1; level <= levels; level++)
+	{
+		uint x = (size_x + (1u << level) - 1) >> level;
+		uint y = (size_y + (1u << level) - 1) >> level;
+
+		Image *images[3];
+		for (int i = 0; i < 3; i++)
+		{
+			images[i] = new Image (x, y, heights.GetStorage(), heights.GetLayout());
+			images[i] -> SetMode (heights.GetMode());
+			images[i] -> SetOrigin (heights.GetOrigin());
+			images[i] -> SetFormat (heights.GetFormat());
+		}
+
+		average.push_back (images[0]);
+		minimum.push_back (images[1]);
+		maximum.push_back (images[2]);
+
+		Index *textures = new Index (x, y);
+		textures -> SetMode (index.GetMode());
+		textures -> SetOrigin (index.GetOrigin());
+		textures -> SetFormat (index.GetFormat());
+		modal.push_back (textures);
+	}
+}
+
+Pyramid::~Pyramid ()
+{
+	for (int i = 0; i < levels; i++)
+	{
+		delete average[i];
+		delete minimum[i];
+		delete maximum[i];
+		delete modal[i];
+	}
+}
+
+// ===================================================================
+// reduce -- halve a w x h grid of cells, rounding up
+// ===================================================================
+void Pyramid::reduce (const vector<Summary>& cells, const vector<uint32_t>& modes, uint w, uint h,
+	vector<Summary>& out, vector<uint32_t>& outModes)
+{
+	uint nw = (w + 1) / 2;
+	uint nh = (h + 1) / 2;
+
+	out.resize ((size_t) nw * nh);
+	outModes.resize ((size_t) nw * nh);
+
+	for (uint j = 0; j < nh; j++)
+	{
+		for (uint i = 0; i < nw; i++)
+		{
+			Summary& s = out[(size_t) j * nw + i];
+			uint32_t textures[4] = {0, 0, 0, 0};
+			int n = 0;
+
+			s.sum = 0;
+			s.count = 0;
+			s.lowest = UINT32_MAX;
+			s.highest = 0;
+
+			for (uint y = 2 * j; y < std::min (2 * j + 2, h); y++)
+			{
+				for (uint x = 2 * i; x < std::min (2 * i + 2, w); x++)
+				{
+					const Summary& child = cells[(size_t) y * w + x];
+
+					s.sum += child.sum;
+					s.count += child.count;
+					s.lowest = std::min (s.lowest, child.lowest);
+					s.highest = std::max (s.highest, child.highest);
+					textures[n++] = modes[(size_t) y * w + x];
+				}
+			}
+
+			outModes[(size_t) j * nw + i] = mode (textures, n);
+		}
+	}
+}
+
+// ===================================================================
+// store -- copy a w x h grid of cells into a level, from (gx,gy)
+// ===================================================================
+void Pyramid::store (int level, uint gx, uint gy, uint w, uint h, const Summary *cells, const uint32_t *modes)
+{
+	Image& avg = *average[level - 1];
+	Image& lo = *minimum[level - 1];
+	Image& hi = *maximum[level - 1];
+	Index& tex = *modal[level - 1];
+
+	for (uint j = 0; j < h; j++)
+	{
+		for (uint i = 0; i < w; i++)
+		{
+			const Summary& s = cells[(size_t) j * w + i];
+
+			avg.Set (gx + i, gy + j, (unsigned long) ((s.sum + s.count / 2) / s.count));
+			lo.Set (gx + i, gy + j, s.lowest);
+			hi.Set (gx + i, gy + j, s.highest);
+			tex.Set (gx + i, gy + j, modes[(size_t) j * w + i]);
+		}
+	}
+}
+
+// ===================================================================
+// buildTile -- reduce one block of the map through the levels
+//
+// A block's cells at level n start at its corner >> n, since TILE is a
+// multiple of 2^n up to TILE_LEVELS.  Heights are summarised from the map
+// cells themselves, so the average is the exact mean of everything a cell
+// covers even where a block runs off the edge.
+// ===================================================================
+void Pyramid::buildTile (int tx, int ty)
+{
+	uint x0 = (uint) tx * TILE;
+	uint y0 = (uint) ty * TILE;
+	uint w = std::min ((uint) TILE, heights.GetXSize() - x0);
+	uint h = std::min ((uint) TILE, heights.GetYSize() - y0);
+
+	thread_local vector<Summary> cells, reduced;
+	thread_local vector<uint32_t> modes, reducedModes;
+	thread_local vector<uint32_t> rows;
+
+	// level 1, straight from the map
+	uint lw = (w + 1) / 2;
+	uint lh = (h + 1) / 2;
+
+	cells.resize ((size_t) lw * lh);
+	modes.resize ((size_t) lw * lh);
+	rows.resize ((size_t) w * 4);
+
+	uint32_t *upper = &rows[0];
+	uint32_t *lower = &rows[w];
+	uint32_t *indexUpper = &rows[2 * w];
+	uint32_t *indexLower = &rows[3 * w];
+
+	for (uint j = 0; j < lh; j++)
+	{
+		bool pair = (2 * j + 1 < h);
+
+		heights.GetRow (y0 + 2 * j, x0, w, upper);
+		index.GetRow (y0 + 2 * j, x0, w, indexUpper);
+		if (pair)
+		{
+			heights.GetRow (y0 + 2 * j + 1, x0, w, lower);
+			index.GetRow (y0 + 2 * j + 1, x0, w, indexLower);
+		}
+
+		for (uint i = 0; i < lw; i++)
+		{
+			uint32_t values[4] = {0, 0, 0, 0};
+			uint32_t textures[4] = {0, 0, 0, 0};
+			int n = 0;
+
+			for (uint dy = 0; dy < (pair ? 2u : 1u); dy++)
+			{
+				for (uint x = 2 * i; x < std::min (2 * i + 2, w); x++)
+				{
+					values[n] = dy ? lower[x] : upper[x];
+					textures[n] = dy ? indexLower[x] : indexUpper[x];
+					n++;
+				}
+			}
+
+			Summary& s = cells[(size_t) j * lw + i];
+			s.sum = 0;
+			s.count = n;
+			s.lowest = values[0];
+			s.highest = values[0];
+			for (int k = 0; k < n; k++)
+			{
+				s.sum += values[k];
+				s.lowest = std::min (s.lowest, values[k]);
+				s.highest = std::max (s.highest, values[k]);
+			}
+
+			modes[(size_t) j * lw + i] = mode (textures, n);
+		}
+	}
+
+	int last = std::min (levels, (int) TILE_LEVELS);
+
+	for (int level = 1; level <= last; level++)
+	{
+		if (level > 1)
+		{
+			reduce (cells, modes, lw, lh, reduced, reducedModes);
+			cells.swap (reduced);
+			modes.swap (reducedModes);
+			lw = (lw + 1) / 2;
+			lh = (lh + 1) / 2;
+		}
+
+		store (level, x0 >> level, y0 >> level, lw, lh, cells.data(), modes.data());
+	}
+
+	// the block is a single cell now, the levels above are built from it
+	if (levels > TILE_LEVELS)
+	{
+		top[(size_t) ty * tiles_x + tx] = cells[0];
+		topModes[(size_t) ty * tiles_x + tx] = modes[0];
+	}
+}
+
+// ===================================================================
+// build -- fill in every level
+// ===================================================================
+void Pyramid::build ()
+{
+	if (levels <= 0)
+	{
+		return;
+	}
+
+	LOG_INFO (LOG_STORAGE, "building %d level pyramid in %d x %d blocks\n", levels, tiles_x, tiles_y);
+
+	if (levels > TILE_LEVELS)
+	{
+		top.resize ((size_t) tiles_x * tiles_y);
+		topModes.resize ((size_t) tiles_x * tiles_y);
+	}
+
+	ThreadPool::Instance().parallelFor (tiles_x * tiles_y, [this] (int begin, int end)
+	{
+		for (int t = begin; t < end; t++)
+		{
+			buildTile (t % tiles_x, t / tiles_x);
+		}
+	});
+
+	vector<Summary> reduced;
+	vector<uint32_t> reducedModes;
+	uint w = tiles_x;
+	uint h = tiles_y;
+
+	for (int level = TILE_LEVELS + 1; level <= levels; level++)
+	{
+		reduce (top, topModes, w, h, reduced, reducedModes);
+		top.swap (reduced);
+		topModes.swap (reducedModes);
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+
+		store (level, 0, 0, w, h, top.data(), topModes.data());
+	}
+}
+
+// ===================================================================
+// split -- queue the pages of every level
+//
+// Each level has the map's pages, with the same numbers, each covering
+// the same ground as its map page; see Image::PageBounds.
+// ===================================================================
+void Pyramid::split (int page_size, PageQueue& pages)
+{
+	string heightBase = heights.GetName();
+	string indexBase = index.GetName();
+	int num_x_pages = (heights.GetXSize() + page_size - 1) / page_size;
+	int num_y_pages = (heights.GetYSize() + page_size - 1) / page_size;
+
+	for (int level = 1; level <= levels; level++)
+	{
+		ostringstream tag;
+		tag << "L" << level << ".";
+
+		average[level - 1] -> SetName (heightBase + tag.str());
+		minimum[level - 1] -> SetName (heightBase + tag.str() + "Min.");
+		maximum[level - 1] -> SetName (heightBase + tag.str() + "Max.");
+		modal[level - 1] -> SetName (indexBase + tag.str());
+
+		average[level - 1] -> SplitLevel (page_size, level, num_x_pages, num_y_pages, pages);
+		minimum[level - 1] -> SplitLevel (page_size, level, num_x_pages, num_y_pages, pages);
+		maximum[level - 1] -> SplitLevel (page_size, level, num_x_pages, num_y_pages, pages);
+		modal[level - 1] -> SplitLevel (page_size, level, num_x_pages, num_y_pages, pages);
+	}
+}
@@ -0,0 +1,88 @@
+#include "random.h"
+#include "generationcontext.h"
+
+static const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+static Random root;
+static thread_local Random *current = nullptr;
+
+Random::Random (uint64_t seed)
+{
+	key = mix (seed + GOLDEN_GAMMA);
+	counter = 0;
+}
+
+// ===================================================================
+// mix -- the SplitMix64 finalizer
+// ===================================================================
+uint64_t Random::mix (uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+uint64_t Random::next64 ()
+{
+	counter++;
+	return mix (key + counter * GOLDEN_GAMMA);
+}
+
+// ===================================================================
+// split -- a new independent stream, keyed by the next value of this one
+// ===================================================================
+Random Random::split ()
+{
+	return Random (next64 ());
+}
+
+// ===================================================================
+// stream -- a new stream identified by id, without advancing this one
+//
+// The same id always gives the same stream, whatever has been drawn so far.
+// ===================================================================
+Random Random::stream (uint64_t id) const
+{
+	return Random (key ^ mix (id * GOLDEN_GAMMA + 1));
+}
+
+void Random::Seed (uint64_t seed)
+{
+	root = Random (seed);
+	current = nullptr;
+}
+
+// ===================================================================
+// Root -- the bound context's root stream, or the process-wide one
+// ===================================================================
+Random& Random::Root ()
+{
+	GenerationContext *context = GenerationContext::Current();
+
+	if (context != NULL)
+	{
+		return context->getRoot();
+	}
+
+	return root;
+}
+
+Random& Random::Current ()
+{
+	if (current == nullptr)
+	{
+		return Root ();
+	}
+
+	return *current;
+}
+
+// ===================================================================
+// Install -- make a stream current on this thread, returning the old one
+// ===================================================================
+Random *Random::Install (Random *r)
+{
+	Random *previous = current;
+	current = r;
+	return previous;
+}
@@ -0,0 +1,138 @@
+#include "scheduler.h"
+#include "logger.h"
+#include <stdlib.h>
+
+Scheduler::Scheduler ()
+{
+	for (int i = 0; i < NUM_AGENT_TYPES; i++)
+	{
+		weight[i] = 1;
+	}
+
+	total = 0;
+	released = false;
+}
+
+// ===================================================================
+// setWeight -- relative likelihood of picking an agent of a given type
+// ===================================================================
+void Scheduler::setWeight (AgentType type, int w)
+{
+	if (w < 1)
+	{
+		LOG_ERROR (LOG_GENERAL, "Scheduler::setWeight: weight %d must be at least 1\n", w);
+		exit (1);
+	}
+
+	total += (long) (w - weight[type]) * pool[type].size();
+	weight[type] = w;
+}
+
+// ===================================================================
+// add -- make an agent runnable
+//
+// Agents already in the pool are left where they are.
+// ===================================================================
+void Scheduler::add (Agent *a)
+{
+	if (a->getSlot() >= 0)
+	{
+		return;
+	}
+
+	AgentList& agents = pool[a->getType()];
+
+	a->setSlot (agents.size());
+	agents.push_back (a);
+
+	total += weight[a->getType()];
+}
+
+// ===================================================================
+// defer -- hold an agent back until the deferred phase is released
+// ===================================================================
+void Scheduler::defer (Agent *a)
+{
+	deferred.push_back (a);
+}
+
+// ===================================================================
+// remove -- take an agent out of the pool
+//
+// The last agent of the same type is moved into the vacated slot.
+// ===================================================================
+void Scheduler::remove (Agent *a)
+{
+	int slot = a->getSlot();
+
+	if (slot < 0)
+	{
+		return;
+	}
+
+	AgentList& agents = pool[a->getType()];
+	Agent *last = agents.back();
+
+	agents[slot] = last;
+	last->setSlot (slot);
+	agents.pop_back ();
+
+	a->setSlot (-1);
+	total -= weight[a->getType()];
+}
+
+// ===================================================================
+// pick -- choose a runnable agent at random, NULL if there are none
+// ===================================================================
+Agent *Scheduler::pick (Random& rng)
+{
+	if (total == 0)
+	{
+		return NULL;
+	}
+
+	long r = (long) (rng.next64() % (uint64_t) total);
+
+	for (int i = 0; i < NUM_AGENT_TYPES; i++)
+	{
+		long span = (long) weight[i] * pool[i].size();
+
+		if (r < span)
+		{
+			return pool[i][r / weight[i]];
+		}
+
+		r -= span;
+	}
+
+	return NULL;
+}
+
+// ===================================================================
+// release -- make every deferred agent runnable
+// ===================================================================
+void Scheduler::release ()
+{
+	for (unsigned int i = 0; i < deferred.size(); i++)
+	{
+		Agent *a = deferred[i];
+
+		a->setRunnable (true);
+		add (a);
+	}
+
+	deferred.clear ();
+	released = true;
+}
+
+long Scheduler::size ()
+{
+	long n = 0;
+
+	for (int i = 0; i < NUM_AGENT_TYPES; i++)
+	{
+		n += pool[i].size();
+	}
+
+	return n;
+}
@@ -0,0 +1,202 @@
+#include "smoothkernel.h"
+#include "threadpool.h"
+#include "metrics.h"
+#include <algorithm>
+
+SmoothKernel::SmoothKernel (Image& m, CellFlags& f)
+	: map (m), flags (f)
+{
+	x_size = map.GetXSize();
+	y_size = map.GetYSize();
+
+	highest = INT32_MIN;
+	lowest = INT32_MAX;
+}
+
+// a cell off the map: the halo's copy, or 0 beyond it
+int32_t SmoothKernel::offMap (int x, int y)
+{
+	unsigned long value = map.Get (x, y);
+
+	return (value > INT32_MAX) ? INT32_MAX : (int32_t) value;
+}
+
+void SmoothKernel::merge (int32_t hi, int32_t lo)
+{
+	std::lock_guard<std::mutex> guard (rangeLock);
+
+	highest = std::max (highest, hi);
+	lowest = std::min (lowest, lo);
+}
+
+// ===================================================================
+// sweepChunk -- smooth columns [x1, x2) of row y
+//
+// Reads the two cells either side of the chunk in this row, and the chunk
+// columns of the two rows above and below.  The range of the values left
+// in the chunk is folded into hi and lo.
+//
+// Cells off the map are read from the halo, as agent stencils read them,
+// and are 0 beyond it.  If all of that lies in unwritten tiles of a sparse
+// map holding one value c, every cell smooths to (4c + 8c) / 12 = c and the
+// chunk is skipped; sparse maps have no halo, so near the edges that only
+// holds for c = 0.
+// ===================================================================
+void SmoothKernel::sweepChunk (int y, int x1, int x2, int32_t& hi, int32_t& lo)
+{
+	const int PAD = 2;
+	int n = x2 - x1;
+
+	unsigned long value;
+	if (map.Uniform (x1 - PAD, y - PAD, x2 - 1 + PAD, y + PAD, value) && (value <= INT32_MAX))
+	{
+		bool inside = (x1 >= PAD) && (y >= PAD) && (x2 + PAD <= x_size) && (y + PAD < y_size);
+
+		if (inside || (value == 0))
+		{
+			hi = std::max (hi, (int32_t) value);
+			lo = std::min (lo, (int32_t) value);
+			return;
+		}
+	}
+
+	int32_t centre[CHUNK + 2 * PAD];
+	int32_t above1[CHUNK], above2[CHUNK];
+	int32_t below1[CHUNK], below2[CHUNK];
+	int64_t partial[CHUNK];
+
+	// the padded centre row, with whatever the halo holds off the map
+	int first = std::max (x1 - PAD, 0);
+	int last = std::min (x2 + PAD, x_size);
+
+	for (int x = x1 - PAD; x < first; x++)
+		centre[x - (x1 - PAD)] = offMap (x, y);
+	for (int x = last; x < x2 + PAD; x++)
+		centre[x - (x1 - PAD)] = offMap (x, y);
+	map.GetRow (y, first, last - first, centre + (first - (x1 - PAD)));
+
+	int32_t *rows[4] = {above2, above1, below1, below2};
+	for (int r = 0; r < 4; r++)
+	{
+		int yy = y - 2 + r + (r >= 2);
+
+		if ((yy >= 0) && (yy < y_size))
+			map.GetRow (yy, x1, n, rows[r]);
+		else if (map.Halo() == 0)
+			std::fill (rows[r], rows[r] + n, 0);
+		else
+			for (int i = 0; i < n; i++)
+				rows[r][i] = offMap (x1 + i, yy);
+	}
+
+	// everything but the two western neighbours, which are smoothed as we go
+	const int32_t *c = centre + PAD;
+	for (int i = 0; i < n; i++)
+	{
+		partial[i] = 4 * (int64_t) c[i] + c[i + 1] + c[i + 2]
+			+ above1[i] + above2[i] + below1[i] + below2[i];
+	}
+
+	const uint8_t *skip = flags.row (y) + x1;
+	int32_t *out = centre + PAD;
+
+	HaloPadding padding = map.Padding();
+
+	for (int i = 0; i < n; i++)
+	{
+		int x = x1 + i;
+
+		// by the last cell, a mirrored halo shows the two cells just
+		// smoothed rather than the values read for the chunk
+		if ((padding == PAD_MIRROR) && (x == x_size - 1))
+		{
+			int32_t east2 = (map.Halo() >= 2) ? out[i - 2] : 0;
+			partial[i] += ((int64_t) out[i - 1] - c[i + 1]) + ((int64_t) east2 - c[i + 2]);
+		}
+
+		if (! (skip[i] & SKIP))
+		{
+			out[i] = (int32_t) ((partial[i] + out[i - 1] + out[i - 2]) / 12);
+		}
+
+		// and a clamped one follows the first cell, which the next sees
+		// as its second western neighbour
+		if ((padding == PAD_CLAMP) && (x == 0))
+		{
+			out[i - 1] = out[i];
+		}
+	}
+
+	map.SetRow (y, x1, n, out);
+	Metrics::Instance().count (COUNT_CELLS_WRITTEN, n);
+
+	for (int i = 0; i < n; i++)
+	{
+		hi = std::max (hi, out[i]);
+		lo = std::min (lo, out[i]);
+	}
+}
+
+void SmoothKernel::sweepRows (int y1, int y2)
+{
+	int32_t hi = highest;
+	int32_t lo = lowest;
+
+	for (int y = std::max (y1, 0); y < std::min (y2, y_size); y++)
+	{
+		for (int x = 0; x < x_size; x += CHUNK)
+		{
+			sweepChunk (y, x, std::min (x + CHUNK, x_size), hi, lo);
+		}
+	}
+
+	merge (hi, lo);
+}
+
+// ===================================================================
+// sweepRowsParallel -- wavefront version of sweepRows
+//
+// Chunk (row, col) needs (row, col-1) and the rows above it at col to be
+// done, and must come before (row, col+1) and the rows below it at col.
+// Every chunk on the diagonal row + col = d satisfies that once diagonal
+// d-1 is complete, so the diagonals run in turn with their chunks in
+// parallel, and the result is identical to sweepRows.
+// ===================================================================
+void SmoothKernel::sweepRowsParallel (int y1, int y2)
+{
+	ThreadPool& pool = ThreadPool::Instance();
+
+	y1 = std::max (y1, 0);
+	y2 = std::min (y2, y_size);
+
+	int rows = y2 - y1;
+	int cols = (x_size + CHUNK - 1) / CHUNK;
+
+	if ((pool.size() == 1) || (rows <= 0) || (cols == 1))
+	{
+		sweepRows (y1, y2);
+		return;
+	}
+
+	for (int d = 0; d < rows + cols - 1; d++)
+	{
+		int first = std::max (0, d - cols + 1);		// first row on the diagonal
+		int last = std::min (d, rows - 1);
+
+		pool.parallelFor (last - first + 1, [this, d, first, y1] (int begin, int end)
+		{
+			int32_t hi = INT32_MIN;
+			int32_t lo = INT32_MAX;
+
+			for (int i = begin; i < end; i++)
+			{
+				int row = first + i;
+				int x = (d - row) * CHUNK;
+
+				sweepChunk (y1 + row, x, std::min (x + CHUNK, x_size), hi, lo);
+			}
+
+			merge (hi, lo);
+		});
+	}
+}
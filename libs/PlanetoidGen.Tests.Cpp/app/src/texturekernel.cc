@@ -0,0 +1,216 @@
+#include "texturekernel.h"
+#include "threadpool.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstdlib>
+
+TextureKernel::TextureKernel (Image& h, Index& i, CellFlags& f)
+	: heights (h), index (i), flags (f)
+{
+	x_size = heights.GetXSize();
+	y_size = heights.GetYSize();
+	tiles_x = (x_size + ImageBuffer::TILE - 1) / ImageBuffer::TILE;
+}
+
+// ===================================================================
+// pack -- the Index value SetPrimary and SetSecondary would leave for
+// a texture at full alpha
+// ===================================================================
+uint32_t TextureKernel::pack (int texture)
+{
+	uint32_t t = (uint32_t) texture & 0xff;
+
+	return (t << 24) | (0xff << 16) | (t << 8) | 0xff;
+}
+
+// a cell off the map: the halo's copy, or 0 beyond it
+int32_t TextureKernel::offMap (int x, int y)
+{
+	unsigned long value = heights.Get (x, y);
+
+	return (value > INT32_MAX) ? INT32_MAX : (int32_t) value;
+}
+
+// ===================================================================
+// classifyChunk -- texture columns [x1, x2) of row y
+// ===================================================================
+void TextureKernel::classifyChunk (int y, int x1, int x2, const TextureRule& rule)
+{
+	const int PAD = 1;
+	int n = x2 - x1;
+
+	// row y and its neighbours, with a one cell halo, read from the image's
+	// own halo off the map
+	int32_t rows[3][CHUNK + 2 * PAD];
+	int32_t slope[CHUNK];
+
+	int lo = std::max (x1 - PAD, 0);
+	int hi = std::min (x2 + PAD, x_size);
+
+	for (int r = 0; r < 3; r++)
+	{
+		int yy = y - 1 + r;
+
+		if ((yy >= 0) && (yy < y_size))
+		{
+			for (int x = x1 - PAD; x < lo; x++)
+				rows[r][x - (x1 - PAD)] = offMap (x, yy);
+			for (int x = hi; x < x2 + PAD; x++)
+				rows[r][x - (x1 - PAD)] = offMap (x, yy);
+			heights.GetRow (yy, lo, hi - lo, rows[r] + (lo - (x1 - PAD)));
+		}
+		else if (heights.Halo() == 0)
+		{
+			std::fill (rows[r], rows[r] + n + 2 * PAD, 0);
+		}
+		else
+		{
+			for (int i = 0; i < n + 2 * PAD; i++)
+				rows[r][i] = offMap (x1 - PAD + i, yy);
+		}
+	}
+
+	const int32_t *up = rows[0];
+	const int32_t *mid = rows[1];
+	const int32_t *down = rows[2];
+
+	for (int i = 0; i < n; i++)
+	{
+		int32_t h = mid[i + 1];
+		int32_t g = std::abs (h - mid[i]);
+
+		g = std::max (g, std::abs (h - mid[i + 2]));
+		g = std::max (g, std::abs (h - up[i]));
+		g = std::max (g, std::abs (h - up[i + 1]));
+		g = std::max (g, std::abs (h - up[i + 2]));
+		g = std::max (g, std::abs (h - down[i]));
+		g = std::max (g, std::abs (h - down[i + 1]));
+		g = std::max (g, std::abs (h - down[i + 2]));
+
+		slope[i] = g;
+	}
+
+	const uint8_t *cell = flags.row (y) + x1;
+	uint32_t out[CHUNK];
+
+	index.GetRow (y, x1, n, out);
+
+	for (int i = 0; i < n; i++)
+	{
+		uint32_t t = choose (mid[i + 1], slope[i], rule);
+
+		out[i] = (cell[i] & CELL_FIXED) ? out[i] : t;
+	}
+
+	index.SetRow (y, x1, n, out);
+	Metrics::Instance().count (COUNT_CELLS_WRITTEN, n);
+}
+
+// ===================================================================
+// ringIs -- do the cells just outside [x1,x2) x [y1,y2) all hold value?
+// ===================================================================
+bool TextureKernel::ringIs (int x1, int y1, int x2, int y2, unsigned long value)
+{
+	for (int x = x1 - 1; x <= x2; x++)
+	{
+		if ((heights.Get (x, y1 - 1) != value) || (heights.Get (x, y2) != value))
+			return false;
+	}
+
+	for (int y = y1; y < y2; y++)
+	{
+		if ((heights.Get (x1 - 1, y) != value) || (heights.Get (x2, y) != value))
+			return false;
+	}
+
+	return true;
+}
+
+// ===================================================================
+// fillTiles -- give whole index tiles in rows [y1, y2) their texture
+// where nothing varies
+//
+// The heights under the tile must be an unwritten tile of one value, and
+// the one cell halo around it (read as Get reads it) must match, with no fixed
+// cells in the tile; the slope is then 0 everywhere.
+// ===================================================================
+void TextureKernel::fillTiles (int y1, int y2, const TextureRule& rule)
+{
+	const int TILE = ImageBuffer::TILE;
+
+	filled.clear ();
+	if ((heights.GetLayout() != LAYOUT_SPARSE) || (index.GetLayout() != LAYOUT_SPARSE))
+	{
+		return;
+	}
+
+	int tiles_y = (y_size + TILE - 1) / TILE;
+	filled.assign ((size_t) tiles_x * tiles_y, false);
+
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			int left = tx * TILE;
+			int top = ty * TILE;
+			int right = std::min (left + TILE, x_size);
+			int bottom = std::min (top + TILE, y_size);
+
+			if ((top < y1) || (bottom > y2))
+				continue;
+
+			unsigned long h;
+			if (! heights.ConstantTile (tx, ty, h) || (h > INT32_MAX) || ! ringIs (left, top, right, bottom, h))
+				continue;
+
+			if (flags.anyInRect (left, top, right, bottom, CELL_FIXED))
+				continue;
+
+			index.FillTile (tx, ty, choose ((int32_t) h, 0, rule));
+			Metrics::Instance().count (COUNT_CELLS_WRITTEN, (uint64_t) (right - left) * (bottom - top));
+			filled[(size_t) ty * tiles_x + tx] = true;
+		}
+	}
+}
+
+void TextureKernel::classifyRows (int y1, int y2, const TextureRule& rule)
+{
+	fillTiles (y1, y2, rule);
+
+	for (int y = std::max (y1, 0); y < std::min (y2, y_size); y++)
+	{
+		for (int x = 0; x < x_size; x += CHUNK)
+		{
+			if (! isFilled (y, x))
+			{
+				classifyChunk (y, x, std::min (x + CHUNK, x_size), rule);
+			}
+		}
+	}
+}
+
+// ===================================================================
+// classifyParallel -- texture the whole map across the thread pool
+//
+// Heights are only read, so the tiles are independent.
+// ===================================================================
+void TextureKernel::classifyParallel (const TextureRule& rule)
+{
+	int cols = (x_size + CHUNK - 1) / CHUNK;
+	int tiles = cols * y_size;
+
+	fillTiles (0, y_size, rule);
+
+	ThreadPool::Instance().parallelFor (tiles, [this, cols, &rule] (int begin, int end)
+	{
+		for (int t = begin; t < end; t++)
+		{
+			int x = (t % cols) * CHUNK;
+
+			if (! isFilled (t / cols, x))
+			{
+				classifyChunk (t / cols, x, std::min (x + CHUNK, x_size), rule);
+			}
+		}
+	});
+}
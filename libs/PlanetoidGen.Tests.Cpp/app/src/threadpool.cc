@@ -0,0 +1,157 @@
+#include "threadpool.h"
+#include "params.h"
+#include "generationcontext.h"
+#include "heaptrack.h"
+#include <algorithm>
+
+std::unique_ptr<ThreadPool> ThreadPool::_instance;
+
+// set on pool threads, so work queued from inside a task runs inline
+// rather than waiting on the pool it is occupying
+static thread_local bool onWorker = false;
+
+ThreadPool& ThreadPool::Instance ()
+{
+	if (_instance.get() == NULL)
+	{
+		Params& params = Params::Instance();
+
+		// enough workers for every concurrent map, or for one map's agents
+		_instance.reset (new ThreadPool (std::max (params.threads, params.jobs)));
+	}
+
+	return *_instance;
+}
+
+ThreadPool::ThreadPool (int threads)
+{
+	outstanding = 0;
+	stopping = false;
+
+	if (threads > 1)
+	{
+		for (int i = 0; i < threads; i++)
+		{
+			workers.emplace_back (&ThreadPool::workerLoop, this);
+		}
+	}
+}
+
+ThreadPool::~ThreadPool ()
+{
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		stopping = true;
+	}
+
+	wake.notify_all ();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+	{
+		workers[i].join ();
+	}
+}
+
+void ThreadPool::workerLoop ()
+{
+	onWorker = true;
+
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> guard (lock);
+			wake.wait (guard, [this] {return stopping || ! tasks.empty();});
+
+			if (tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move (tasks.front());
+			tasks.pop_front ();
+		}
+
+		task ();
+
+		{
+			std::lock_guard<std::mutex> guard (lock);
+			if (--outstanding == 0)
+			{
+				idle.notify_all ();
+			}
+		}
+	}
+}
+
+bool ThreadPool::onPoolThread ()
+{
+	return onWorker;
+}
+
+// ===================================================================
+// submit -- queue a task, or run it now if there are no workers or we are one
+//
+// Queued tasks run with the caller's generation context, heap subsystem
+// and heap phase bound.
+// ===================================================================
+void ThreadPool::submit (std::function<void()> task)
+{
+	if (workers.empty() || onWorker)
+	{
+		task ();
+		return;
+	}
+
+	GenerationContext *context = GenerationContext::Current();
+	HeapSubsystem subsystem = HeapTrack::Current();
+	HeapCounters *phase = HeapTrack::CurrentPhase();
+
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		tasks.push_back ([context, subsystem, phase, task] ()
+		{
+			ContextScope scope (context);
+			HeapScope heap (subsystem);
+			HeapPhaseScope heapPhase (phase);
+			task ();
+		});
+		outstanding++;
+	}
+
+	wake.notify_one ();
+}
+
+// ===================================================================
+// wait -- block until every submitted task has finished
+// ===================================================================
+void ThreadPool::wait ()
+{
+	std::unique_lock<std::mutex> guard (lock);
+	idle.wait (guard, [this] {return outstanding == 0;});
+}
+
+void ThreadPool::parallelFor (int n, std::function<void(int, int)> body)
+{
+	int chunks = onWorker ? 1 : std::min (n, size());
+
+	if (chunks <= 1)
+	{
+		if (n > 0)
+		{
+			body (0, n);
+		}
+		return;
+	}
+
+	for (int i = 0; i < chunks; i++)
+	{
+		int begin = (int) ((long) n * i / chunks);
+		int end = (int) ((long) n * (i + 1) / chunks);
+
+		submit ([=] {body (begin, end);});
+	}
+
+	wait ();
+}
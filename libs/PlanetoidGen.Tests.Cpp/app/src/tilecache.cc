@@ -0,0 +1,132 @@
+#include "tilecache.h"
+
+TileCache::TileCache ()
+{
+	tileBytes = 0;
+	tiles = 0;
+	resident = 0;
+	limit = 0;
+	hand = 0;
+	faults = 0;
+	evictions = 0;
+}
+
+TileCache::~TileCache ()
+{
+	release ();
+}
+
+// ===================================================================
+// create -- map a scratch file holding tiles of tileBytes each
+// ===================================================================
+bool TileCache::create (size_t _tiles, size_t _tileBytes, size_t _limit, const char *directory)
+{
+	release ();
+
+	if (! file.createScratch (directory, _tiles * _tileBytes))
+	{
+		return false;
+	}
+
+	tiles = _tiles;
+	tileBytes = _tileBytes;
+	limit = _limit;
+
+	state.reset (new std::atomic<uint8_t>[tiles]);
+	for (size_t i = 0; i < tiles; i++)
+	{
+		state[i] = TILE_ABSENT;
+	}
+
+	return true;
+}
+
+void TileCache::release ()
+{
+	file.close ();
+	state.reset ();
+
+	tiles = 0;
+	resident = 0;
+	hand = 0;
+	faults = 0;
+	evictions = 0;
+}
+
+// ===================================================================
+// clear -- zero every tile, none are resident afterwards
+// ===================================================================
+void TileCache::clear ()
+{
+	std::lock_guard<std::mutex> guard (lock);
+
+	file.zero ();
+
+	for (size_t i = 0; i < tiles; i++)
+	{
+		state[i] = TILE_ABSENT;
+	}
+	resident = 0;
+}
+
+// ===================================================================
+// fault -- a tile not in recent use is being accessed
+// ===================================================================
+void TileCache::fault (size_t tile)
+{
+	std::lock_guard<std::mutex> guard (lock);
+
+	uint8_t previous = state[tile].exchange (TILE_REFERENCED);
+
+	if (previous == TILE_ABSENT)
+	{
+		resident++;
+		faults++;
+
+		if ((limit > 0) && (resident > limit))
+		{
+			evict ();
+		}
+	}
+}
+
+// ===================================================================
+// evict -- run the clock until the resident tiles are within the limit
+//
+// A tile used since the hand last passed it gets another turn.  The tile
+// which faulted is marked as used, so it is not the one dropped.
+// ===================================================================
+void TileCache::evict ()
+{
+	while (resident > limit)
+	{
+		uint8_t s = state[hand].load (std::memory_order_relaxed);
+
+		if (s == TILE_REFERENCED)
+		{
+			state[hand] = TILE_RESIDENT;
+		}
+		else if (s == TILE_RESIDENT)
+		{
+			state[hand] = TILE_ABSENT;
+			file.release (hand * tileBytes, tileBytes);
+			resident--;
+			evictions++;
+		}
+
+		hand = (hand + 1) % tiles;
+	}
+}
+
+// ===================================================================
+// prefetch -- read a tile in ahead of use, and count it as used
+// ===================================================================
+void TileCache::prefetch (size_t tile)
+{
+	if (state[tile].load (std::memory_order_relaxed) == TILE_ABSENT)
+	{
+		file.willNeed (tile * tileBytes, tileBytes);
+	}
+
+	touch (tile);
+}
@@ -0,0 +1,103 @@
+#include "tilelease.h"
+#include <algorithm>
+
+TileLeases::TileLeases ()
+{
+	tile_size = 1;
+	x_tiles = 0;
+	y_tiles = 0;
+}
+
+void TileLeases::allocate (int x_size, int y_size, int tile)
+{
+	tile_size = std::max (tile, 1);
+	x_tiles = (x_size + tile_size - 1) / tile_size;
+	y_tiles = (y_size + tile_size - 1) / tile_size;
+
+	held.assign ((size_t) x_tiles * y_tiles, 0);
+}
+
+// ===================================================================
+// tileRange -- the tiles covered by a box of cells, clipped to the map
+//
+// Returns false if the box misses the map entirely.
+// ===================================================================
+bool TileLeases::tileRange (Rect& r, int& tx1, int& ty1, int& tx2, int& ty2)
+{
+	int x1 = std::max (r.x1, 0);
+	int y1 = std::max (r.y1, 0);
+	int x2 = r.x2;
+	int y2 = r.y2;
+
+	tx1 = x1 / tile_size;
+	ty1 = y1 / tile_size;
+	tx2 = std::min (x2 / tile_size, x_tiles - 1);
+	ty2 = std::min (y2 / tile_size, y_tiles - 1);
+
+	return (x2 >= x1) && (y2 >= y1) && (tx1 <= tx2) && (ty1 <= ty2);
+}
+
+// ===================================================================
+// acquire -- lease every tile under the box, or none if any is taken
+// ===================================================================
+bool TileLeases::acquire (Rect& r)
+{
+	int tx1, ty1, tx2, ty2;
+
+	if (! tileRange (r, tx1, ty1, tx2, ty2))
+	{
+		return true;
+	}
+
+	for (int ty = ty1; ty <= ty2; ty++)
+	{
+		for (int tx = tx1; tx <= tx2; tx++)
+		{
+			if (held[(size_t) ty * x_tiles + tx])
+			{
+				return false;
+			}
+		}
+	}
+
+	for (int ty = ty1; ty <= ty2; ty++)
+	{
+		for (int tx = tx1; tx <= tx2; tx++)
+		{
+			held[(size_t) ty * x_tiles + tx] = 1;
+		}
+	}
+
+	return true;
+}
+
+void TileLeases::release (Rect& r)
+{
+	int tx1, ty1, tx2, ty2;
+
+	if (! tileRange (r, tx1, ty1, tx2, ty2))
+	{
+		return;
+	}
+
+	for (int ty = ty1; ty <= ty2; ty++)
+	{
+		for (int tx = tx1; tx <= tx2; tx++)
+		{
+			held[(size_t) ty * x_tiles + tx] = 0;
+		}
+	}
+}
+
+bool TileLeases::anyHeld ()
+{
+	for (size_t i = 0; i < held.size(); i++)
+	{
+		if (held[i])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
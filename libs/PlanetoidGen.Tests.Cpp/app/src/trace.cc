@@ -0,0 +1,139 @@
+#include "trace.h"
+#include "generationcontext.h"
+#include "logger.h"
+#include <stdio.h>
+#include <atomic>
+#include <set>
+
+Trace::Trace ()
+{
+	started = std::chrono::steady_clock::now();
+	events.reserve (4096);
+}
+
+Trace *Trace::Current ()
+{
+	GenerationContext *context = GenerationContext::Current();
+
+	return (context != NULL) ? context->getTrace() : NULL;
+}
+
+// small and stable per thread, rather than the system's thread ids
+int Trace::threadId ()
+{
+	static std::atomic<int> next (0);
+	static thread_local int id = next++;
+
+	return id;
+}
+
+uint64_t Trace::now ()
+{
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - started);
+	return (uint64_t) ns.count();
+}
+
+void Trace::span (const char *category, const std::string& name, uint64_t start, uint64_t end,
+	const std::string& args)
+{
+	int thread = threadId ();
+	std::lock_guard<std::mutex> guard (lock);
+
+	events.push_back ({'X', category, name, start, end - start, thread, args});
+}
+
+void Trace::instant (const char *category, const std::string& name, const std::string& args)
+{
+	uint64_t at = now ();
+	int thread = threadId ();
+	std::lock_guard<std::mutex> guard (lock);
+
+	events.push_back ({'i', category, name, at, 0, thread, args});
+}
+
+std::string Trace::Quote (const std::string& s)
+{
+	std::string quoted = "\"";
+
+	for (char c : s)
+	{
+		if ((c == '"') || (c == '\\'))
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if ((unsigned char) c < 0x20)
+		{
+			char escape[8];
+			snprintf (escape, sizeof (escape), "\\u%04x", c);
+			quoted += escape;
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+
+	return quoted + "\"";
+}
+
+// ===================================================================
+// Write -- the trace as a Chrome trace-event JSON object
+//
+// Timestamps are microseconds, as the format wants, with nanoseconds
+// kept as the fraction.  Each thread used gets a name record first.
+// ===================================================================
+bool Trace::Write (const std::string& filename)
+{
+	FILE *f = fopen (filename.c_str(), "w");
+
+	if (f == NULL)
+	{
+		LOG_ERROR (LOG_GENERAL, "cannot write trace %s\n", filename.c_str());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard (lock);
+	std::set<int> threads;
+
+	for (Event& e : events)
+	{
+		threads.insert (e.thread);
+	}
+
+	fprintf (f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf (f, "{\"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"name\": \"process_name\", \"args\": {\"name\": %s}}",
+		Quote (Params::Instance().name).c_str());
+
+	for (int t : threads)
+	{
+		fprintf (f, ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", \"args\": {\"name\": \"thread %d\"}}",
+			t, t);
+	}
+
+	for (Event& e : events)
+	{
+		fprintf (f, ",\n{\"ph\": \"%c\", \"cat\": \"%s\", \"name\": %s, \"pid\": 1, \"tid\": %d, \"ts\": %.3f",
+			e.phase, e.category, Quote (e.name).c_str(), e.thread, e.start * 1e-3);
+
+		if (e.phase == 'X')
+		{
+			fprintf (f, ", \"dur\": %.3f", e.duration * 1e-3);
+		}
+		else
+		{
+			fprintf (f, ", \"s\": \"t\"");
+		}
+
+		if (! e.args.empty())
+		{
+			fprintf (f, ", \"args\": {%s}", e.args.c_str());
+		}
+		fprintf (f, "}");
+	}
+
+	fprintf (f, "\n]}\n");
+
+	LOG_INFO (LOG_GENERAL, "wrote %lu trace events to %s\n", (unsigned long) events.size(), filename.c_str());
+	return fclose (f) == 0;
+}
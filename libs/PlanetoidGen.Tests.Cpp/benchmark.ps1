@@ -1 +0,0 @@
-Measure-Command {start-process benchmark_internal.bat -Wait}
\ No newline at end of file
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Run the whole map generator over a matrix of map sizes, agent counts
+and thread counts, and compare the results with a stored baseline.
+
+Each run records its wall time, its peak resident set size and the phase
+times from the run report (-report).  With --baseline, any phase, wall
+time or peak RSS that grew past the threshold is listed and the script
+exits with status 1.
+
+    ./benchmark.py --sizes 256,512 --save baseline.json
+    ./benchmark.py --sizes 256,512 --baseline baseline.json
+
+Baselines are only comparable on the machine and build that made them.
+Needs os.wait4 for the peak RSS, so Linux or another Unix.
+"""
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+# the agent mix of the old benchmark_internal.bat; the agents axis
+# multiplies the counts, the token budgets stay as they are
+BASE_AGENTS = {
+    "mountain": (4, 32),
+    "beach": (8, 64),
+    "smooth": (4, 16),
+    "hill": (4, 32),
+}
+
+DEFAULT_APP = os.path.join(os.path.dirname(os.path.abspath(__file__)), "build", "app", "app")
+DEFAULT_SIZES = "256,512,1024,2048,4096,8192"
+DEFAULT_AGENTS = "1,4"
+DEFAULT_THREADS = "1,%d" % (os.cpu_count() or 1)
+
+
+def int_list(text):
+    return [int(v) for v in text.split(",") if v]
+
+
+def run_key(size, agents, threads):
+    return "%dx%d/agents%d/threads%d" % (size, size, agents, threads)
+
+
+def app_args(size, agents, threads, seed, report):
+    args = ["-rep", "1", "-seed", str(seed), "-x", str(size), "-y", str(size),
+            "-threads", str(threads), "-log_level", "warn", "-report", report]
+
+    for kind, (count, tokens) in BASE_AGENTS.items():
+        args += ["-num_%s_agents" % kind, str(count * agents),
+                 "-%s_tokens" % kind, str(tokens)]
+
+    return args
+
+
+def run_once(app, size, agents, threads, seed, timeout):
+    """One run of the app in a scratch directory.
+
+    Returns the wall time in seconds, the peak RSS in KB and the phase
+    times in seconds from the app's report.
+    """
+    with tempfile.TemporaryDirectory(prefix="mapgen_bench_") as work:
+        os.mkdir(os.path.join(work, "split"))
+        report = os.path.join(work, "report.json")
+        command = [app] + app_args(size, agents, threads, seed, report)
+
+        with open(os.path.join(work, "stderr.txt"), "w+") as errors:
+            start = time.perf_counter()
+            proc = subprocess.Popen(command, cwd=work, stdout=subprocess.DEVNULL, stderr=errors)
+
+            # wait4 rather than wait, for this child's own resource usage
+            killer = threading.Timer(timeout, proc.kill)
+            killer.start()
+            _, status, usage = os.wait4(proc.pid, 0)
+            wall = time.perf_counter() - start
+            killer.cancel()
+            proc.returncode = os.waitstatus_to_exitcode(status)
+
+            if proc.returncode != 0:
+                errors.seek(0)
+                raise RuntimeError("%s\nexit status %d after %.1f s\n%s" % (
+                    " ".join(command), proc.returncode, wall, errors.read()))
+
+        with open(report) as f:
+            data = json.load(f)
+
+    phases = {p["name"]: p["seconds"] for p in data["phases"]}
+    return wall, usage.ru_maxrss, phases
+
+
+def measure(app, size, agents, threads, seed, repeat, timeout):
+    """The median of repeat runs of one configuration."""
+    walls, rss, phases = [], [], {}
+
+    for _ in range(repeat):
+        wall, peak, times = run_once(app, size, agents, threads, seed, timeout)
+        walls.append(wall)
+        rss.append(peak)
+        for name, seconds in times.items():
+            phases.setdefault(name, []).append(seconds)
+
+    return {
+        "size": size,
+        "agents": agents,
+        "threads": threads,
+        "wall_seconds": statistics.median(walls),
+        "peak_rss_kb": int(statistics.median(rss)),
+        "phases": {name: statistics.median(v) for name, v in phases.items()},
+    }
+
+
+def metrics(run):
+    """(name, value, unit) for everything compared against a baseline."""
+    yield "wall", run["wall_seconds"], "s"
+    yield "peak_rss", run["peak_rss_kb"] / 1024.0, "MB"
+    for name, seconds in run["phases"].items():
+        yield "phase " + name, seconds, "s"
+
+
+def compare(baseline, current, threshold, min_seconds, min_mb):
+    """Lines describing every metric that regressed, and the matrix
+    entries missing from the baseline."""
+    regressions, unmatched = [], []
+
+    for key, run in current.items():
+        base = baseline.get(key)
+        if base is None:
+            unmatched.append(key)
+            continue
+
+        old = {name: value for name, value, _ in metrics(base)}
+        for name, value, unit in metrics(run):
+            if name not in old:
+                continue
+
+            floor = min_mb if unit == "MB" else min_seconds
+            grown = value - old[name]
+            if grown > floor and grown > threshold * old[name]:
+                change = (100.0 * grown / old[name]) if old[name] > 0 else float("inf")
+                regressions.append("%-36s %-24s %10.3f %10.3f %s  %+.1f%%" % (
+                    key, name, old[name], value, unit, change))
+
+    return regressions, unmatched
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--app", default=DEFAULT_APP, help="the map generator (default %(default)s)")
+    parser.add_argument("--sizes", default=DEFAULT_SIZES, help="map sides, comma separated")
+    parser.add_argument("--agents", default=DEFAULT_AGENTS,
+                        help="multiples of the base agent counts, comma separated")
+    parser.add_argument("--threads", default=DEFAULT_THREADS, help="thread counts, comma separated")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--repeat", type=int, default=3, help="runs per entry; the median is kept")
+    parser.add_argument("--timeout", type=int, default=3600, help="seconds allowed per run")
+    parser.add_argument("--save", help="write the results here, to use as a baseline")
+    parser.add_argument("--baseline", help="compare with results saved earlier")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative growth counted as a regression (default %(default)s)")
+    parser.add_argument("--min-seconds", type=float, default=0.05,
+                        help="ignore time differences smaller than this")
+    parser.add_argument("--min-mb", type=float, default=8,
+                        help="ignore peak RSS differences smaller than this")
+    args = parser.parse_args()
+
+    # the runs happen in scratch directories
+    args.app = os.path.abspath(args.app)
+    if not os.access(args.app, os.X_OK):
+        sys.exit("no map generator at %s; build it or pass --app" % args.app)
+
+    results = {}
+    print("%-36s %10s %10s" % ("run", "wall s", "peak MB"))
+    for size in int_list(args.sizes):
+        for agents in int_list(args.agents):
+            for threads in int_list(args.threads):
+                key = run_key(size, agents, threads)
+                try:
+                    run = measure(args.app, size, agents, threads, args.seed, args.repeat, args.timeout)
+                except RuntimeError as e:
+                    sys.exit("%s failed: %s" % (key, e))
+                results[key] = run
+                print("%-36s %10.3f %10.1f" % (key, run["wall_seconds"], run["peak_rss_kb"] / 1024.0))
+                sys.stdout.flush()
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"runs": results}, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["runs"]
+
+        regressions, unmatched = compare(baseline, results, args.threshold, args.min_seconds, args.min_mb)
+        for key in unmatched:
+            print("not in the baseline: %s" % key)
+
+        if regressions:
+            print("\n%d regression(s) past %.0f%%:" % (len(regressions), 100 * args.threshold))
+            print("%-36s %-24s %10s %10s" % ("run", "metric", "baseline", "now"))
+            for line in regressions:
+                print(line)
+            return 1
+
+        print("\nno regressions against %s" % args.baseline)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())